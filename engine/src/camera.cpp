@@ -91,6 +91,10 @@ void Camera::update_vectors() {
     m_up = glm::normalize(glm::cross(m_right, m_front));
 }
 
+void Camera::set_aspect_ratio(f32 aspect_ratio) {
+    m_aspect_ratio = aspect_ratio;
+}
+
 glm::mat4 Camera::get_view_matrix() const {
     return glm::lookAt(m_position, m_position + m_front, m_up);
 }
@@ -99,6 +103,23 @@ glm::mat4 Camera::get_projection_matrix() const {
     return glm::perspective(glm::radians(m_fov), m_aspect_ratio, m_near, m_far);
 }
 
+Frustum Camera::get_frustum() const {
+    return Frustum::from_matrix(get_projection_matrix() * get_view_matrix());
+}
+
+Ray Camera::get_ray(f32 x, f32 y, f32 width, f32 height) const {
+    const auto ndc = glm::vec2(2.0f * x / width - 1.0f, 1.0f - 2.0f * y / height);
+    const auto inverse = glm::inverse(get_projection_matrix() * get_view_matrix());
+
+    auto target = inverse * glm::vec4(ndc.x, ndc.y, 1.0f, 1.0f);
+    target /= target.w;
+
+    Ray ray;
+    ray.origin = m_position;
+    ray.direction = glm::normalize(glm::vec3(target) - m_position);
+    return ray;
+}
+
 void Camera::render_debug_menu() {
     ImGui::DragFloat("Speed", &m_speed, 0.1f, 0.1f, 100.0f);
 }
@@ -3,6 +3,7 @@
 #include <memory> 
 #include <glm/glm/glm.hpp>
 #include <defines.hpp>
+#include <scene/bounds.hpp>
 
 class KAPI Camera {
 public:
@@ -16,10 +17,16 @@ public:
     void rotate(f32 x_offset, f32 y_offset, f32 delta_time);
 
     void set_position(const glm::vec3& position);
+    void set_aspect_ratio(f32 aspect_ratio);
     glm::vec3 get_position() const;
 
     glm::mat4 get_view_matrix() const;
     glm::mat4 get_projection_matrix() const;
+    f32 get_near_plane() const { return m_near; }
+    f32 get_far_plane() const { return m_far; }
+    Frustum get_frustum() const;
+    // world space ray through a pixel, origin top left as reported by glfw
+    Ray get_ray(f32 x, f32 y, f32 width, f32 height) const;
 
     void render_debug_menu();
 
@@ -4,6 +4,7 @@
 #include <renderer/resources/resources.hpp>
 #include <Windows.h>
 #include <iostream>
+#include <random>
 #include "glad/glad.h"
 #include <glfw/glfw3.h>
 #include <imgui/imgui.h>
@@ -19,11 +20,13 @@
 #include <assimp/postprocess.h>
 
 #include "renderer/resources/gl_errors.hpp"
+#include "renderer/resources/gl_state.hpp"
 #include "renderer/mesh.hpp"
 #include "renderer/model.hpp"
 #include "renderer/resources/buffer.hpp"
 #include <utils.hpp>
 #include "renderer/geometry.hpp"
+#include <jobs.hpp>
 
 std::unique_ptr<Engine> g_engine;
 
@@ -110,6 +113,8 @@ void Engine::add_logic(const std::string& dll_name)
 
 b8 Engine::init()
 {
+	JobSystem::init();
+
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -175,6 +180,8 @@ b8 Engine::init()
 	}
 #endif
 
+	GlState::init();
+
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
 	ImGuiIO& io = ImGui::GetIO();
@@ -193,47 +200,22 @@ b8 Engine::init()
 	m_camera = Camera::create((f32)_desc->width / (f32)_desc->height, 45.0f, 0.01f, 10000.0f);
 	m_camera->set_position(glm::vec3(0.0f, 1.0f, 3.0f));
 
-	// create screen framebuffer
-	{
-		TextureSpecification tspec = {};
-		tspec.internalFormat = GL_RGBA16F;
-		tspec.width = _desc->width;
-		tspec.height = _desc->height;
-		//tspec.slot = 0;
-		auto texture = Texture::create(tspec);
-
-		tspec.slot = 1;
-		auto bloomTexture = Texture::create(tspec);
-
-		FramebufferSpecification spec = {};
-		spec.clear_color = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
-		spec.depth_stencil = true;
-		spec.width = _desc->width;
-		spec.height = _desc->height;
-		spec.color_attachements = { texture, bloomTexture };
-		m_screen = Framebuffer::create(spec);
-	}
-
-	// model
-	auto model = Model::create("floor");
-	model->get_root()->m_transform = utils::create_transform(glm::vec3(0.0f, -2.0f, 0.0f), glm::vec3(0.0f), glm::vec3(0.01f)) * model->get_root()->m_transform;
-
-	auto sculpture = Model::create("damaged_helmet");
-	sculpture->get_root()->m_transform = utils::create_transform(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f), glm::vec3(1.0f)) * sculpture->get_root()->m_transform;
-
-	m_models.push_back(model);
-	m_models.push_back(sculpture);
+	// scene
+	m_scene = std::make_unique<Scene>();
+	m_scene->spawn_model("floor", utils::create_transform(glm::vec3(0.0f, -2.0f, 0.0f), glm::vec3(0.0f), glm::vec3(0.01f)));
+	m_scene->spawn_model("damaged_helmet", utils::create_transform(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f), glm::vec3(1.0f)));
 
 	// opengl settings
-	glEnable(GL_MULTISAMPLE);
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LESS);
+	auto state = GlState::get();
+	state->enable(GL_MULTISAMPLE);
+	state->enable(GL_CULL_FACE);
+	state->cull_face(GL_BACK);
+	state->enable(GL_DEPTH_TEST);
+	state->depth_func(GL_LESS);
 
 	// blending
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	state->enable(GL_BLEND);
+	state->blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	//return _logic->on_init();
 	return true;
@@ -257,10 +239,12 @@ void Engine::run()
 
 		glfwGetCurrentContext();
 
+		// waits until the gpu released the uniform ring region of this frame
+		m_renderer->begin_frame();
 		update();
 
 		{
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			GlState::get()->bind_framebuffer(GL_FRAMEBUFFER, 0);
 			glViewport(0, 0, _desc->width, _desc->height);
 			glClearColor(0.4f, 0.0f, 0.2f, 1.0f);
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
@@ -270,16 +254,13 @@ void Engine::run()
 			ImGui::NewFrame();
 		}
 
-		m_screen->begin_pass();
+		// renders the scene through the frame graph, ending with the tone mapped quad on screen
 		render();
 
-		// back to rendering to screen
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		// imgui draws on top of the scene
+		GlState::get()->bind_framebuffer(GL_FRAMEBUFFER, 0);
 		glViewport(0, 0, _desc->width, _desc->height);
 
-		// render quad to screen
-		m_renderer->render_screen_framebuffer(m_screen, _desc->width, _desc->height);
-
 		// end frame
 		{
 			ImGui::Render();
@@ -290,7 +271,11 @@ void Engine::run()
 			ImGui::RenderPlatformWindowsDefault();
 			glfwMakeContextCurrent(backup);
 
+			// imgui draws with its own state and other contexts
+			GlState::get()->invalidate();
+
 			glfwSwapBuffers(glfwGetCurrentContext());
+			m_renderer->end_frame();
 		}
 
 		// clear just-pressed keys (do it before poll new events to avoid clearing keys that were pressed in the same frame)
@@ -304,6 +289,7 @@ void Engine::run()
 	}
 
 	//_logic->on_shutdown();
+	JobSystem::shutdown();
 }
 
 b8 Engine::update()
@@ -339,6 +325,17 @@ b8 Engine::update()
 		else glfwSetInputMode(_window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
 	}
 
+	// resolve world matrices and bounds once, every pass reads the cached results
+	m_scene->update();
+
+	m_scene->update_visibility(m_camera->get_position());
+
+	// pick the entity under the cursor, ignored while the mouse drives the camera or imgui
+	if (mouse_keys[GLFW_MOUSE_BUTTON_LEFT].pressed && !m_mouse_locked && !ImGui::GetIO().WantCaptureMouse) {
+		const auto ray = m_camera->get_ray(mouse_pos.x, mouse_pos.y, (f32)_desc->width, (f32)_desc->height);
+		m_selected = m_scene->raycast(ray);
+	}
+
 	// update matrices
 	m_renderer->update_view(
 		m_camera->get_view_matrix(),
@@ -390,56 +387,259 @@ b8 Engine::render()
 
 	//_logic->on_render();
 
-	// shadow map pass
 	auto sm_pass = m_renderer->get_shadow_map_pass();
-	sm_pass->render_debug_menu();
-	sm_pass->start();
+	sm_pass->update(m_camera->get_view_matrix(), m_camera->get_projection_matrix(), m_camera->get_near_plane(), m_camera->get_far_plane(), m_scene->get_bounds(), m_scene->get_transforms().get_static_revision());
+	auto& virtual_shadows = sm_pass->get_virtual();
+	virtual_shadows.update(sm_pass->get_light_view(), m_camera->get_position(), m_scene->get_bounds(), *m_scene);
+
+	// light to cluster assignment runs on the workers while the draws below are gathered and recorded
+	auto& local_shadows = sm_pass->get_local();
+	auto& clusters = m_renderer->get_light_clusters();
+	clusters.set_camera(m_camera->get_view_matrix(), m_camera->get_projection_matrix(), m_camera->get_near_plane(), m_camera->get_far_plane());
 	{
-		for (const auto& model : m_models) 
-			sm_pass->render(model, glm::mat4(1.0f));
+		std::vector<LightData> lights;
+		// keeps the shadow of a light across frames
+		std::vector<u64> ids;
+		auto& transforms = m_scene->get_transforms();
+		m_scene->get_world().each<Transform, PointLight>([&](Entity entity, Transform& transform, PointLight& light) {
+			LightData data{};
+			data.position_range = glm::vec4(glm::vec3(transforms.get_world(transform.node)[3]), light.radius);
+			data.color_type = glm::vec4(light.color * light.intensity, (f32)LIGHT_POINT);
+			lights.push_back(data);
+			ids.push_back(((u64)entity.generation << 32) | entity.index);
+		});
+		m_scene->get_world().each<Transform, SpotLight>([&](Entity entity, Transform& transform, SpotLight& light) {
+			const auto& world = transforms.get_world(transform.node);
+			LightData data{};
+			data.position_range = glm::vec4(glm::vec3(world[3]), light.radius);
+			data.color_type = glm::vec4(light.color * light.intensity, (f32)LIGHT_SPOT);
+			data.direction_outer = glm::vec4(glm::normalize(-glm::vec3(world[2])), std::cos(glm::radians(light.outer_angle)));
+			data.params.x = std::cos(glm::radians(light.inner_angle));
+			lights.push_back(data);
+			ids.push_back(((u64)entity.generation << 32) | entity.index);
+		});
+		local_shadows.update(lights, ids, m_camera->get_position(), m_camera->get_projection_matrix(), m_camera->get_frustum(), *m_scene);
+		clusters.assign(std::move(lights));
 	}
-	sm_pass->stop();
 
-	glViewport(0, 0, _desc->width, _desc->height);
-	// geometry pass
-	auto& gbuffer = m_renderer->get_gbuffer();
-	gbuffer->start();
-	{
-		for (const auto& model : m_models) 
-			gbuffer->render(model, glm::mat4(1.0f));
+	// gather and cull mesh instances once, each pass below draws its own visible list
+	auto& batcher = m_renderer->get_instance_batcher();
+	std::array<Frustum, VIEW_COUNT> frustums;
+	for (u32 i = 0; i < ShadowMapPass::CASCADES; i++) {
+		frustums[VIEW_SHADOW + i] = sm_pass->get_frustum(i);
+		frustums[VIEW_SHADOW_DYNAMIC + i] = sm_pass->get_dynamic_frustum(i);
 	}
-	gbuffer->stop();
+	frustums[VIEW_SHADOW_VIRTUAL] = virtual_shadows.get_frustum();
+	frustums[VIEW_SHADOW_LOCAL] = local_shadows.get_frustum();
+	frustums[VIEW_CAMERA] = m_camera->get_frustum();
+
+	auto& occlusion = m_renderer->get_occlusion_culler();
+	occlusion.begin(m_camera->get_projection_matrix() * m_camera->get_view_matrix());
+
+	batcher.begin();
+	batcher.set_split_static_casters(sm_pass->is_caching_static());
+	batcher.gather(*m_scene, frustums, m_occlusion_culling ? &occlusion : nullptr);
+	batcher.upload(*m_renderer->get_geometry_pool());
+
+	// record the draws of both passes in parallel, then sort them once
+	auto& gbuffer = m_renderer->get_gbuffer();
+	auto& queue = m_renderer->get_render_queue();
+	const auto& batches = batcher.get_batches();
+	queue.begin();
+	JobSystem::get()->parallel_for((u32)batches.size(), 64, [&](u32 begin, u32 end) {
+		auto& commands = queue.get_buffer();
+		for (u32 i = begin; i < end; i++) {
+			for (u32 cascade = 0; cascade < ShadowMapPass::CASCADES; cascade++) {
+				sm_pass->record(commands, LAYER_SHADOW + cascade, batches[i], VIEW_SHADOW + cascade);
+				sm_pass->record(commands, LAYER_SHADOW_DYNAMIC + cascade, batches[i], VIEW_SHADOW_DYNAMIC + cascade);
+			}
+			sm_pass->record(commands, LAYER_SHADOW_VIRTUAL, batches[i], VIEW_SHADOW_VIRTUAL);
+			sm_pass->record(commands, LAYER_SHADOW_LOCAL, batches[i], VIEW_SHADOW_LOCAL);
+			gbuffer->record(commands, LAYER_GBUFFER, batches[i], VIEW_CAMERA);
+		}
+	});
+	queue.sort();
 
-	// lighting pass
 	auto lighting_pass = m_renderer->get_light_pass();
-	lighting_pass->start();
-	{
+	const auto view_projection = m_camera->get_projection_matrix() * m_camera->get_view_matrix();
+	lighting_pass->set_view_projection(view_projection);
+
+	sm_pass->render_debug_menu();
+
+	// passes only declare what they read and write, the graph orders them, allocates the
+	// transient targets and turns the copies into shared targets where it can
+	auto& graph = m_renderer->get_frame_graph();
+	graph.reset();
+
+	// scene targets are sized for the internal resolution, the screen pass scales it to the window
+	auto timer = m_renderer->get_frame_timer();
+	auto& resolution = m_renderer->get_dynamic_resolution();
+	resolution.update(timer->get_milliseconds());
+
+	// a minimized window reports 0 x 0
+	const auto render_size = resolution.get_render_size((u32)std::max(_desc->width, 1), (u32)std::max(_desc->height, 1));
+	const auto width = render_size.x;
+	const auto height = render_size.y;
+	const auto shadow_map = graph.import("shadow map", sm_pass->get_depth_texture());
+
+	// static casters are only drawn into their cache when it went stale
+	auto static_shadow_map = INVALID_FRAME_RESOURCE;
+	if (sm_pass->is_caching_static()) {
+		static_shadow_map = graph.import("static shadow map", sm_pass->get_static_texture());
+		graph.add_pass("static shadow map", [&](FrameGraph::Builder& builder) {
+			builder.write(static_shadow_map);
+		}, [&](const FrameGraph::Context&) {
+			sm_pass->start();
+			for (u32 i = 0; i < ShadowMapPass::CASCADES; i++) {
+				if (!sm_pass->is_cascade_updated(i) || !sm_pass->is_static_cache_dirty(i))
+					continue;
+
+				sm_pass->begin_static_cascade(i);
+				queue.execute(LAYER_SHADOW + i);
+			}
+			sm_pass->stop();
+		});
+	}
+
+	graph.add_pass("shadow map", [&](FrameGraph::Builder& builder) {
+		if (sm_pass->is_caching_static())
+			builder.read(static_shadow_map);
+		builder.write(shadow_map);
+	}, [&](const FrameGraph::Context&) {
+		sm_pass->start();
+		for (u32 i = 0; i < ShadowMapPass::CASCADES; i++) {
+			if (!sm_pass->is_cascade_updated(i))
+				continue;
+
+			if (sm_pass->begin_cascade(i, batcher.get_instance_count(VIEW_SHADOW_DYNAMIC + i)))
+				queue.execute(sm_pass->get_caster_layer(i));
+		}
+		sm_pass->stop();
+	});
+
+	auto draw_screen_quad = [&] {
 		m_renderer->m_screen_vao->bind();
 		glDrawElements(GL_TRIANGLES, m_renderer->m_screen_ibo->get_count(), GL_UNSIGNED_INT, nullptr);
+	};
+
+	// the cascades are filtered once here, lighting then takes a single fetch per pixel.
+	// the moments are not a graph resource, lighting is declared later and so runs after
+	if (sm_pass->is_filtered()) {
+		graph.add_pass("shadow moments", [&](FrameGraph::Builder& builder) {
+			builder.read(shadow_map);
+			builder.set_side_effect();
+		}, [&](const FrameGraph::Context&) {
+			sm_pass->render_moments(draw_screen_quad);
+		});
 	}
-	lighting_pass->stop();
-
-	// bitblt depth buffer to screen framebuffer
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, gbuffer->m_framebuffer->get_resource_id());
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_screen->get_resource_id());
-	glBlitFramebuffer(0, 0, _desc->width, _desc->height, 0, 0, _desc->width, _desc->height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
-
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, lighting_pass->m_framebuffer->get_resource_id());
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_screen->get_resource_id());
-	glBlitFramebuffer(0, 0, _desc->width, _desc->height, 0, 0, _desc->width, _desc->height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
-
-	// draw skybox
-	auto cube = geometry::get_cube();
-	cube->vao->bind();
-	auto skybox_shader = m_renderer->get_shader("cubemap");
-	skybox_shader->bind();
-	m_renderer->m_ibl->bind_env(0);
-	glDisable(GL_CULL_FACE);
-	glDepthFunc(GL_LEQUAL);
-	glDrawArrays(GL_TRIANGLES, 0, 36);
-	glDepthFunc(GL_LESS);
-	glEnable(GL_CULL_FACE);
-	cube->vao->unbind();
+
+	// pages of the virtual shadow map missing from the pool, the others are kept from earlier frames
+	auto virtual_pool = INVALID_FRAME_RESOURCE;
+	if (virtual_shadows.is_enabled()) {
+		virtual_pool = graph.import("virtual shadow pool", virtual_shadows.get_pool());
+		graph.add_pass("virtual shadow pages", [&](FrameGraph::Builder& builder) {
+			builder.write(virtual_pool);
+		}, [&](const FrameGraph::Context&) {
+			sm_pass->start();
+			for (u32 i = 0; i < virtual_shadows.get_render_count(); i++) {
+				sm_pass->begin_virtual_page(i);
+				queue.execute(LAYER_SHADOW_VIRTUAL);
+			}
+			sm_pass->stop();
+		});
+	}
+
+	// point and spot light faces that moved or saw a caster move, the others are kept from earlier frames
+	const auto local_atlas = graph.import("local shadow atlas", local_shadows.get_texture());
+	graph.add_pass("local shadows", [&](FrameGraph::Builder& builder) {
+		builder.write(local_atlas);
+	}, [&](const FrameGraph::Context&) {
+		sm_pass->start();
+		for (u32 i = 0; i < local_shadows.get_render_count(); i++) {
+			local_shadows.begin_face(i);
+			queue.execute(LAYER_SHADOW_LOCAL);
+		}
+		sm_pass->stop();
+	});
+
+	GBufferTargets targets{};
+	graph.add_pass("gbuffer", [&](FrameGraph::Builder& builder) {
+		targets = gbuffer->declare(builder, width, height);
+	}, [&](const FrameGraph::Context&) {
+		gbuffer->start();
+		queue.execute(LAYER_GBUFFER);
+		gbuffer->stop();
+	});
+
+	// the pages seen this frame are read back and rendered a few frames later
+	if (virtual_shadows.is_enabled()) {
+		graph.add_pass("mark shadow pages", [&](FrameGraph::Builder& builder) {
+			builder.read(targets.depth);
+			builder.set_side_effect();
+		}, [&](const FrameGraph::Context& context) {
+			virtual_shadows.mark_pages(context.get_texture(targets.depth), glm::inverse(view_projection));
+		});
+	}
+
+	RenderTargetDesc hdr_desc{};
+	hdr_desc.width = width;
+	hdr_desc.height = height;
+
+	FrameResource lit = INVALID_FRAME_RESOURCE;
+	graph.add_pass("lighting", [&](FrameGraph::Builder& builder) {
+		GBuffer::read(builder, targets);
+		builder.read(shadow_map);
+		if (virtual_shadows.is_enabled())
+			builder.read(virtual_pool);
+		builder.read(local_atlas);
+		lit = builder.write(builder.create("lit", hdr_desc), true);
+	}, [&](const FrameGraph::Context& context) {
+		GBuffer::bind_textures(context, targets);
+		lighting_pass->start();
+		m_renderer->m_screen_vao->bind();
+		glDrawElements(GL_TRIANGLES, m_renderer->m_screen_ibo->get_count(), GL_UNSIGNED_INT, nullptr);
+		lighting_pass->stop();
+	});
+
+	// the skybox is depth tested against the scene in the hdr target the screen pass reads
+	const auto scene_color = graph.create("scene color", hdr_desc);
+	const auto scene_depth = graph.create("scene depth", graph.get_desc(targets.depth));
+	graph.add_blit("copy depth", targets.depth, scene_depth);
+	graph.add_blit("copy color", lit, scene_color);
+
+	graph.add_pass("skybox", [&](FrameGraph::Builder& builder) {
+		builder.write(scene_color);
+		builder.write(scene_depth);
+	}, [&](const FrameGraph::Context&) {
+		auto state = GlState::get();
+		auto cube = geometry::get_cube();
+		cube->vao->bind();
+		auto skybox_shader = m_renderer->get_shader("cubemap");
+		skybox_shader->bind();
+		m_renderer->m_ibl->bind_env(0);
+		state->disable(GL_CULL_FACE);
+		state->depth_func(GL_LEQUAL);
+		glDrawArrays(GL_TRIANGLES, 0, 36);
+		state->depth_func(GL_LESS);
+		state->enable(GL_CULL_FACE);
+		cube->vao->unbind();
+	});
+
+	graph.add_pass("screen", [&](FrameGraph::Builder& builder) {
+		builder.read(scene_color);
+		builder.set_side_effect();
+	}, [&](const FrameGraph::Context& context) {
+		GlState::get()->bind_framebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, _desc->width, _desc->height);
+		m_renderer->render_screen_framebuffer(context.get_texture(scene_color));
+	});
+
+	graph.compile();
+	timer->begin();
+	graph.execute();
+	timer->end();
+
+	auto state = GlState::get();
 
 	ImGui::Begin("OpenGL PBR + IBL (droon)");
 	{
@@ -447,6 +647,35 @@ b8 Engine::render()
 			m_renderer->render_debug_menu();
 		}
 
+		if (ImGui::CollapsingHeader("Resolution")) {
+			resolution.render_debug_menu();
+		}
+
+		if (ImGui::CollapsingHeader("Lights")) {
+			const auto& stats = clusters.get_stats();
+			ImGui::Text("Lights: %u", stats.lights);
+			ImGui::Text("Cluster indices: %u (%.1f per light), at most %u per cluster", stats.indices, stats.lights ? (f32)stats.indices / stats.lights : 0.0f, stats.max_cluster_lights);
+			local_shadows.render_debug_menu();
+
+			// scatters lights over the scene bounds to test the clustering with
+			static i32 spawn_count = 100;
+			ImGui::SliderInt("Count", &spawn_count, 1, 500);
+			if (ImGui::Button("Spawn point lights")) {
+				static std::mt19937 rng;
+				std::uniform_real_distribution<f32> unit(0.0f, 1.0f);
+				const auto bounds = m_scene->get_bounds();
+				for (i32 i = 0; i < spawn_count; i++) {
+					const auto position = glm::mix(bounds.min, bounds.max, glm::vec3(unit(rng), unit(rng), unit(rng)));
+					const auto color = glm::vec3(unit(rng), unit(rng), unit(rng));
+					m_scene->spawn_point_light(position, color, 5.0f, 3.0f);
+				}
+			}
+		}
+
+		if (ImGui::CollapsingHeader("Frame graph")) {
+			graph.render_debug_menu();
+		}
+
 		if (ImGui::CollapsingHeader("Camera")) {
 			m_camera->render_debug_menu();
 		}
@@ -455,7 +684,40 @@ b8 Engine::render()
 			ImGui::Text("FPS: %.1f", 1.0f / _delta);
 			ImGui::Text("Frametime: %0.01f", _frame_time);
 			ImGui::Text("Triangles: %ld", m_renderer->get_rendered_triangles());
-			m_renderer->reset_rendered_triangles();
+			ImGui::Text("Draw calls: %ld", m_renderer->get_draw_calls());
+			ImGui::Text("State changes: %ld", m_renderer->get_state_changes());
+			ImGui::Text("GL state calls: %ld issued, %ld filtered", state->get_issued_calls(), state->get_filtered_calls());
+			const auto ring = m_renderer->get_uniform_ring();
+			ImGui::Text("Uniform ring: %u / %u bytes, %ld stalls", ring->get_used(), ring->get_frame_size(), ring->get_stall_count());
+			ImGui::Text("Instances: %ld", batcher.get_instance_count(VIEW_CAMERA));
+			ImGui::Text("Draw commands: %ld (%ld multi draws)", queue.get_command_count(), queue.get_batch_count());
+			const auto& materials = m_renderer->get_material_table();
+			ImGui::Text("Materials: %u in %u texture sets, %u texture arrays", materials.get_material_count(), materials.get_set_count(), materials.get_array_count());
+			const auto& camera_stats = batcher.get_culling_stats(VIEW_CAMERA);
+			CullingStats shadow_stats{};
+			for (u32 view = VIEW_SHADOW; view <= VIEW_SHADOW_DYNAMIC_LAST; view++) {
+				shadow_stats.visible += batcher.get_culling_stats(view).visible;
+				shadow_stats.tested += batcher.get_culling_stats(view).tested;
+			}
+			ImGui::Text("Camera: %u visible, %u culled, %u occluded", camera_stats.visible, camera_stats.get_culled(), camera_stats.occluded);
+			ImGui::Text("Occluders: %u (%u triangles)", occlusion.get_stats().occluders, occlusion.get_stats().triangles);
+			ImGui::Checkbox("Occlusion culling", &m_occlusion_culling);
+			ImGui::Text("Shadow cascades: %u visible, %u culled", shadow_stats.visible, shadow_stats.get_culled());
+			ImGui::Text("Entities: %u (%u archetypes)", m_scene->get_world().size(), m_scene->get_world().get_archetype_count());
+			ImGui::Text("Transforms: %u (%u updated)", m_scene->get_transforms().size(), m_scene->get_transforms().get_updated_count());
+			ImGui::Text("BVH: %u nodes, cost %.1f, %u rebuilds", m_scene->get_bvh().get_node_count(), m_scene->get_bvh().get_cost(), m_scene->get_bvh().get_rebuild_count());
+			ImGui::Text("PVS: %u hidden", m_scene->get_pvs_hidden_count());
+			static char pvs_model[256] = "";
+			ImGui::InputText("PVS model", pvs_model, IM_ARRAYSIZE(pvs_model));
+			if (ImGui::Button("Bake PVS") && pvs_model[0]) {
+				Model::create(pvs_model)->bake_pvs();
+			}
+			if (const auto renderer = m_scene->get_world().get<MeshRenderer>(m_selected))
+				ImGui::Text("Selected: %u (%s)", m_selected.index, renderer->mesh->get_name().c_str());
+			else
+				ImGui::Text("Selected: none");
+			m_renderer->reset_render_stats();
+			state->reset_stats();
 
 			ImGui::Checkbox("Deferred", &m_render_deferred);
 
@@ -509,6 +771,10 @@ void Engine::_window_size_callback(GLFWwindow* window, i32 width, i32 height)
 {
 	g_engine->_desc->width = width;
 	g_engine->_desc->height = height;
+
+	// the render targets follow the window size on the next frame, a minimized window reports 0 x 0
+	if (width > 0 && height > 0 && g_engine->m_camera)
+		g_engine->m_camera->set_aspect_ratio((f32)width / (f32)height);
 	//g_engine->_logic->on_resize(width, height);
 }
 
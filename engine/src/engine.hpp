@@ -13,6 +13,7 @@
 #include <renderer/resources/framebuffer.hpp>
 #include <renderer/cubemap.hpp>
 #include <renderer/ibl.hpp>
+#include <scene/scene.hpp>
 
 class Mesh;
 struct GLFWwindow;
@@ -115,14 +116,17 @@ private:
     f64 _frame_time;
 
     bool m_render_deferred = false;
+    bool m_occlusion_culling = true;
 
     std::shared_ptr<Camera> m_camera;
-    std::vector<std::shared_ptr<Model>> m_models;
+    std::unique_ptr<Scene> m_scene;
     std::unique_ptr<Renderer> m_renderer;
-    std::shared_ptr<Framebuffer> m_screen;
 
     std::once_flag m_mouse_init;
     bool m_mouse_locked = false;
+
+    // entity picked with the mouse
+    Entity m_selected = INVALID_ENTITY;
     
     // clear keys
     void clear();
@@ -0,0 +1,176 @@
+#include "jobs.hpp"
+
+#include <cassert>
+
+// index of the queue owned by the current thread, the main thread owns queue 0
+static thread_local u32 t_queue_index = 0;
+
+void JobSystem::init(u32 workers)
+{
+	assert(_instance == nullptr);
+
+	if (workers == 0) {
+		const auto cores = std::thread::hardware_concurrency();
+		workers = cores > 1 ? cores - 1 : 1;
+	}
+
+	_instance = new JobSystem(workers);
+}
+
+void JobSystem::shutdown()
+{
+	delete _instance;
+	_instance = nullptr;
+}
+
+JobSystem::JobSystem(u32 workers)
+{
+	for (u32 i = 0; i < workers + 1; i++) {
+		m_queues.push_back(std::make_unique<Queue>());
+	}
+
+	for (u32 i = 1; i <= workers; i++) {
+		m_threads.emplace_back(&JobSystem::worker_main, this, i);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard lock(m_sleep_mutex);
+		m_running = false;
+	}
+	m_sleep.notify_all();
+
+	for (auto& thread : m_threads) {
+		thread.join();
+	}
+}
+
+u32 JobSystem::get_thread_index()
+{
+	return t_queue_index;
+}
+
+void JobSystem::run(JobFunction function, JobCounter* counter)
+{
+	if (counter)
+		counter->m_value.fetch_add(1, std::memory_order_relaxed);
+
+	push({ std::move(function), counter });
+}
+
+void JobSystem::run_after(JobCounter& dependency, JobFunction function, JobCounter* counter)
+{
+	// counted now so waiting on `counter` also covers the job that has not started yet
+	if (counter)
+		counter->m_value.fetch_add(1, std::memory_order_relaxed);
+
+	{
+		std::lock_guard lock(dependency.m_mutex);
+		if (!dependency.is_done()) {
+			dependency.m_continuations.push_back({ std::move(function), counter });
+			return;
+		}
+	}
+
+	push({ std::move(function), counter });
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+	Job job;
+	while (!counter.is_done()) {
+		if (pop(job))
+			execute(job);
+		else
+			std::this_thread::yield();
+	}
+
+	// the job that finished last may still be releasing the counter mutex
+	std::lock_guard lock(counter.m_mutex);
+}
+
+void JobSystem::push(Job job)
+{
+	auto& queue = *m_queues[t_queue_index];
+	{
+		std::lock_guard lock(queue.mutex);
+		queue.jobs.push_back(std::move(job));
+	}
+
+	m_queued.fetch_add(1, std::memory_order_release);
+	m_sleep.notify_one();
+}
+
+bool JobSystem::pop(Job& job)
+{
+	// own work first, newest job while its data is still in cache
+	{
+		auto& queue = *m_queues[t_queue_index];
+		std::lock_guard lock(queue.mutex);
+		if (!queue.jobs.empty()) {
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+			m_queued.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	// steal the oldest job of another thread, it is the most likely to spawn more work
+	const auto count = (u32)m_queues.size();
+	for (u32 i = 1; i < count; i++) {
+		auto& queue = *m_queues[(t_queue_index + i) % count];
+		std::unique_lock lock(queue.mutex, std::try_to_lock);
+		if (!lock.owns_lock() || queue.jobs.empty())
+			continue;
+
+		job = std::move(queue.jobs.front());
+		queue.jobs.pop_front();
+		m_queued.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	return false;
+}
+
+void JobSystem::execute(Job& job)
+{
+	job.function();
+
+	auto counter = job.counter;
+	if (!counter)
+		return;
+
+	// decremented under the counter mutex: run_after() can not slip a continuation in between,
+	// and wait() locks it once more so the counter outlives this function
+	std::vector<JobCounter::Continuation> continuations;
+	{
+		std::lock_guard lock(counter->m_mutex);
+		if (counter->m_value.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			continuations.swap(counter->m_continuations);
+	}
+
+	for (auto& continuation : continuations) {
+		push({ std::move(continuation.function), continuation.counter });
+	}
+}
+
+void JobSystem::worker_main(u32 index)
+{
+	t_queue_index = index;
+
+	Job job;
+	while (m_running) {
+		if (pop(job)) {
+			execute(job);
+			continue;
+		}
+
+		// try_to_lock steals can miss work, so sleep with a timeout instead of relying on the notify alone
+		std::unique_lock lock(m_sleep_mutex);
+		m_sleep.wait_for(lock, std::chrono::milliseconds(1), [&] {
+			return !m_running || m_queued.load(std::memory_order_acquire) > 0;
+		});
+	}
+}
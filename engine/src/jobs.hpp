@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+#include "defines.hpp"
+
+typedef std::function<void()> JobFunction;
+
+//
+// Counts unfinished jobs. run() increments it, every finished job decrements it and
+// jobs queued with run_after() start once it reaches zero.
+// Only destroy a counter after JobSystem::wait() returned on it.
+//
+class JobCounter {
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool is_done() const { return m_value.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	struct Continuation {
+		JobFunction function;
+		JobCounter* counter;
+	};
+
+	std::atomic<u32> m_value{ 0 };
+	std::mutex m_mutex;
+	std::vector<Continuation> m_continuations;
+};
+
+//
+// Fixed pool of worker threads. Every thread (the main thread included) owns a deque:
+// it pushes and pops its own jobs at the back, idle threads steal from the front of the
+// others. Waiting never blocks a thread that could run jobs, wait() executes queued jobs
+// until the counter it waits for reaches zero.
+//
+class JobSystem {
+public:
+	// starts `workers` threads, defaults to one per core besides the main thread
+	static void init(u32 workers = 0);
+	static void shutdown();
+	static JobSystem* get() { return _instance; }
+
+	~JobSystem();
+
+	void run(JobFunction function, JobCounter* counter = nullptr);
+	// starts `function` once `dependency` reaches zero
+	void run_after(JobCounter& dependency, JobFunction function, JobCounter* counter = nullptr);
+	void wait(JobCounter& counter);
+
+	// calls fn(begin, end) over [0, count) in chunks of at most `grain` and waits for all of them
+	template <class F>
+	void parallel_for(u32 count, u32 grain, F&& fn);
+
+	// worker threads plus the main thread
+	u32 get_thread_count() const { return (u32)m_queues.size(); }
+	// index of the calling thread in [0, get_thread_count()), the main thread is 0
+	static u32 get_thread_index();
+
+private:
+	struct Job {
+		JobFunction function;
+		JobCounter* counter;
+	};
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	explicit JobSystem(u32 workers);
+
+	std::vector<std::unique_ptr<Queue>> m_queues;
+	std::vector<std::thread> m_threads;
+
+	std::atomic<bool> m_running{ true };
+	std::atomic<u32> m_queued{ 0 };
+	std::mutex m_sleep_mutex;
+	std::condition_variable m_sleep;
+
+	void push(Job job);
+	bool pop(Job& job);
+	void execute(Job& job);
+	void worker_main(u32 index);
+
+	static inline JobSystem* _instance = nullptr;
+};
+
+template <class F>
+void JobSystem::parallel_for(u32 count, u32 grain, F&& fn)
+{
+	if (count == 0)
+		return;
+
+	grain = grain ? grain : 1;
+	if (count <= grain) {
+		fn(0u, count);
+		return;
+	}
+
+	JobCounter counter;
+	for (u32 begin = grain; begin < count; begin += grain) {
+		const auto end = begin + grain < count ? begin + grain : count;
+		run([&fn, begin, end] { fn(begin, end); }, &counter);
+	}
+
+	// the calling thread takes the first chunk itself, then helps with the rest
+	fn(0u, grain);
+	wait(counter);
+}
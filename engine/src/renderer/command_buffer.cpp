@@ -0,0 +1,145 @@
+#include "command_buffer.hpp"
+
+#include <array>
+#include <algorithm>
+#include <glad/glad.h>
+
+#include "material.hpp"
+#include "resources/vertex_array.hpp"
+#include "resources/shader_program.hpp"
+#include "resources/buffer.hpp"
+#include <engine.hpp>
+#include <jobs.hpp>
+
+void RenderQueue::begin()
+{
+	m_buffers.resize(JobSystem::get()->get_thread_count());
+	for (auto& buffer : m_buffers)
+		buffer.clear();
+
+	m_sorted.clear();
+}
+
+CommandBuffer& RenderQueue::get_buffer()
+{
+	return m_buffers[JobSystem::get_thread_index()];
+}
+
+void RenderQueue::sort()
+{
+	m_sorted.clear();
+	for (const auto& buffer : m_buffers)
+		m_sorted.insert(m_sorted.end(), buffer.get_commands().begin(), buffer.get_commands().end());
+
+	// lsd radix sort, one byte per pass. stable, so draws with equal keys keep their recording order
+	m_scratch.resize(m_sorted.size());
+	for (u32 shift = 0; shift < 64; shift += 8) {
+		std::array<u64, 256> offsets{};
+		for (const auto& command : m_sorted)
+			offsets[(command.key >> shift) & 0xff]++;
+
+		// every key shares this byte, the pass would not move anything
+		if (offsets[(m_sorted.empty() ? 0 : m_sorted[0].key >> shift) & 0xff] == m_sorted.size())
+			continue;
+
+		u64 sum = 0;
+		for (auto& offset : offsets) {
+			const auto count = offset;
+			offset = sum;
+			sum += count;
+		}
+
+		for (const auto& command : m_sorted)
+			m_scratch[offsets[(command.key >> shift) & 0xff]++] = command;
+
+		m_sorted.swap(m_scratch);
+	}
+
+	upload_indirect();
+}
+
+void RenderQueue::upload_indirect()
+{
+	m_indirect.clear();
+	for (const auto& command : m_sorted)
+		m_indirect.push_back({ command.index_count, command.instance_count, command.first_index, (i32)command.base_vertex, command.first_instance });
+
+	if (m_indirect.empty())
+		return;
+
+	if (!m_indirect_buffer || m_indirect_buffer->get_count() < m_indirect.size()) {
+		BufferSpecification spec{};
+		spec.type = GL_DRAW_INDIRECT_BUFFER;
+		spec.element_size = sizeof(DrawElementsIndirectCommand);
+		spec.count = std::max((u32)m_indirect.size(), m_indirect_buffer ? m_indirect_buffer->get_count() * 2 : 256u);
+		spec.data = nullptr;
+		spec.usage = GL_DYNAMIC_DRAW;
+		m_indirect_buffer = GlBuffer::create(spec);
+	}
+
+	m_indirect_buffer->update(m_indirect.data(), (u32)m_indirect.size());
+}
+
+void RenderQueue::execute(u8 layer)
+{
+	// keys are sorted, the layer is one contiguous range
+	const auto first = std::lower_bound(m_sorted.begin(), m_sorted.end(), (u64)layer << DRAW_KEY_LAYER_SHIFT, [](const DrawCommand& command, u64 key) {
+		return command.key < key;
+	});
+
+	// state left by the previous draw, reset per layer since the pass binds its own state in between
+	ShaderProgram* program = nullptr;
+	u32 texture_set = ~0u;
+	VertexArray* vao = nullptr;
+
+	u64 triangles = 0;
+	m_state_changes = 0;
+
+	auto& materials = g_engine->get_renderer()->get_material_table();
+
+	m_batches = 0;
+	const auto end = std::find_if(first, m_sorted.end(), [layer](const DrawCommand& command) {
+		return (command.key >> DRAW_KEY_LAYER_SHIFT) != layer;
+	});
+	if (first != end)
+		m_indirect_buffer->bind();
+
+	for (auto it = first; it != end; ) {
+		const auto& command = *it;
+
+		if (command.program != program) {
+			program = command.program;
+			program->bind();
+			program->set_bool("instanced", true);
+			m_state_changes += 2;
+		}
+
+		if (command.material->texture_set != texture_set) {
+			texture_set = command.material->texture_set;
+			materials.bind(texture_set);
+			m_state_changes++;
+		}
+
+		if (command.vao != vao) {
+			vao = command.vao;
+			vao->bind();
+			m_state_changes++;
+		}
+
+		// every following draw of the same state goes into the same multi draw, materials
+		// only differ by the index each instance carries into the material buffer
+		auto run_end = it;
+		for (; run_end != end && run_end->program == program && run_end->material->texture_set == texture_set && run_end->vao == vao; ++run_end)
+			triangles += (u64)(run_end->index_count / 3) * run_end->instance_count;
+
+		const auto offset = (u64)(it - m_sorted.begin()) * sizeof(DrawElementsIndirectCommand);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)offset, (GLsizei)(run_end - it), 0);
+
+		m_batches++;
+		it = run_end;
+	}
+
+	g_engine->get_renderer()->inc_render_stats_triangles(triangles);
+	g_engine->get_renderer()->inc_render_stats_draw_calls(m_batches);
+	g_engine->get_renderer()->inc_render_stats_state_changes(m_state_changes);
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include <defines.hpp>
+
+class ShaderProgram;
+class VertexArray;
+class GlBuffer;
+struct PbrMaterial;
+
+// cascades of the sun shadow map, each one culls and draws its casters separately
+static const u32 SHADOW_CASCADES = 4;
+
+// passes recorded into the same queue, replayed in this order
+enum RenderLayer : u8 {
+	// one layer per shadow cascade, LAYER_SHADOW + cascade. with static shadow caching
+	// these hold the static casters and the dynamic layers the moving ones
+	LAYER_SHADOW = 0,
+	LAYER_SHADOW_LAST = LAYER_SHADOW + SHADOW_CASCADES - 1,
+	LAYER_SHADOW_DYNAMIC,
+	LAYER_SHADOW_DYNAMIC_LAST = LAYER_SHADOW_DYNAMIC + SHADOW_CASCADES - 1,
+	// drawn once per virtual shadow page
+	LAYER_SHADOW_VIRTUAL,
+	// drawn once per point or spot light face rendered into the local shadow atlas
+	LAYER_SHADOW_LOCAL,
+	LAYER_GBUFFER,
+	LAYER_COUNT
+};
+
+//
+// One instanced indexed draw, everything the backend needs to replay it without
+// touching the mesh. Plain data so buffers can be filled from any thread and moved by memcpy.
+//
+struct DrawCommand {
+	// layer in the top byte, the rest orders draws inside the layer
+	u64 key;
+
+	ShaderProgram* program;
+	PbrMaterial* material;
+	VertexArray* vao;
+
+	// range in the geometry pool
+	u32 first_index;
+	u32 index_count;
+	u32 base_vertex;
+
+	// range in the pool instance buffer
+	u32 first_instance;
+	u32 instance_count;
+};
+
+// layout read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+	u32 count;
+	u32 instance_count;
+	u32 first_index;
+	i32 base_vertex;
+	u32 base_instance;
+};
+
+//
+// Key layout, most expensive state change first:
+//   63..56  layer
+//   55..46  program
+//   45..32  texture set, the texture arrays bound (see MaterialTable)
+//   31..14  vertex array
+//   13..0   material
+// Material factors are fetched per instance, so only the texture set and the vertex
+// array split a multi draw. Ids wider than their field wrap, which only costs sorting
+// quality, the backend compares the real state before binding.
+//
+static const u32 DRAW_KEY_LAYER_SHIFT = 56;
+static const u32 DRAW_KEY_PROGRAM_SHIFT = 46;
+static const u32 DRAW_KEY_TEXTURES_SHIFT = 32;
+static const u32 DRAW_KEY_VAO_SHIFT = 14;
+
+inline u64 make_draw_key(u8 layer, u32 program, u32 texture_set, u32 material, u32 vao)
+{
+	return ((u64)layer << DRAW_KEY_LAYER_SHIFT)
+		| ((u64)(program & 0x3ff) << DRAW_KEY_PROGRAM_SHIFT)
+		| ((u64)(texture_set & 0x3fff) << DRAW_KEY_TEXTURES_SHIFT)
+		| ((u64)(vao & 0x3ffff) << DRAW_KEY_VAO_SHIFT)
+		| (u64)(material & 0x3fff);
+}
+
+// linear list of commands recorded by a single thread
+class CommandBuffer {
+public:
+	void clear() { m_commands.clear(); }
+	void push(const DrawCommand& command) { m_commands.push_back(command); }
+
+	const std::vector<DrawCommand>& get_commands() const { return m_commands; }
+
+private:
+	std::vector<DrawCommand> m_commands;
+};
+
+//
+// Submission backend. Jobs record into the command buffer of the thread they run on,
+// sort() merges every buffer and radix sorts the commands by key, execute() replays one
+// layer on the GL thread. This is the only place instanced scene draws touch GL state.
+// Every run of commands sharing program, material and vao becomes one
+// glMultiDrawElementsIndirect call.
+//
+class RenderQueue {
+public:
+	// drops last frame's commands, one buffer per job system thread
+	void begin();
+
+	// buffer of the calling thread, only valid between begin() and sort()
+	CommandBuffer& get_buffer();
+
+	// also uploads the indirect commands, call it on the GL thread
+	void sort();
+	// draws every command of `layer` with the currently bound framebuffer
+	void execute(u8 layer);
+
+	u64 get_command_count() const { return m_sorted.size(); }
+	// multi draw calls issued by the last execute()
+	u64 get_batch_count() const { return m_batches; }
+	// binds and uniform updates issued by the last execute(), redundant ones are skipped
+	u64 get_state_changes() const { return m_state_changes; }
+
+private:
+	std::vector<CommandBuffer> m_buffers;
+	std::vector<DrawCommand> m_sorted;
+	std::vector<DrawCommand> m_scratch;
+	u64 m_state_changes = 0;
+	u64 m_batches = 0;
+
+	// one indirect command per sorted draw command, same order
+	std::vector<DrawElementsIndirectCommand> m_indirect;
+	std::shared_ptr<GlBuffer> m_indirect_buffer;
+
+	void upload_indirect();
+};
@@ -1,9 +1,11 @@
 #include "cubemap.hpp"
 
+#include "resources/gl_state.hpp"
+
 Cubemap::Cubemap(const CubemapSpecification& spec)
 {
 	glGenTextures(1, &m_id);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, m_id);
+	GlState::get()->bind_texture(GL_TEXTURE_CUBE_MAP, m_id);
 	for (u32 i = 0; i < 6; i++) {
 		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, spec.internal_format, spec.size, spec.size, 0, spec.data_format, spec.data_type, nullptr);
 	}
@@ -22,23 +24,22 @@ Cubemap::Cubemap(const CubemapSpecification& spec)
 Cubemap::~Cubemap()
 {
 	glDeleteTextures(1, &m_id);
+	GlState::get()->on_texture_deleted(m_id);
 }
 
 void Cubemap::bind()
 {
-	glActiveTexture(GL_TEXTURE0 + m_spec.slot);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, m_id);
+	GlState::get()->bind_texture(m_spec.slot, GL_TEXTURE_CUBE_MAP, m_id);
 }
 
 void Cubemap::bind(u32 slot)
 {
-	glActiveTexture(GL_TEXTURE0 + slot);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, m_id);
+	GlState::get()->bind_texture(slot, GL_TEXTURE_CUBE_MAP, m_id);
 }
 
 void Cubemap::unbind()
 {
-	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	GlState::get()->bind_texture(m_spec.slot, GL_TEXTURE_CUBE_MAP, 0);
 }
 
 void Cubemap::generate_mipmap()
@@ -0,0 +1,128 @@
+#include "culling.hpp"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULLING_WIDTH 8
+#elif defined(_M_X64) || defined(__SSE__)
+#include <xmmintrin.h>
+#define CULLING_WIDTH 4
+#else
+#define CULLING_WIDTH 1
+#endif
+
+void CullingInput::clear()
+{
+	center_x.clear(); center_y.clear(); center_z.clear();
+	extent_x.clear(); extent_y.clear(); extent_z.clear();
+	meshes.clear();
+	transforms.clear();
+}
+
+void CullingInput::add(const AABB& box, Mesh* mesh, TransformHandle transform)
+{
+	const auto center = box.get_center();
+	const auto extents = box.get_extents();
+
+	// padding from a previous finalize() must not be mixed with real entries
+	center_x.resize(size()); center_y.resize(size()); center_z.resize(size());
+	extent_x.resize(size()); extent_y.resize(size()); extent_z.resize(size());
+
+	center_x.push_back(center.x); center_y.push_back(center.y); center_z.push_back(center.z);
+	extent_x.push_back(extents.x); extent_y.push_back(extents.y); extent_z.push_back(extents.z);
+	meshes.push_back(mesh);
+	transforms.push_back(transform);
+}
+
+void CullingInput::finalize()
+{
+	const u32 padded = (size() + CULLING_WIDTH - 1) / CULLING_WIDTH * CULLING_WIDTH;
+	center_x.resize(padded, 0.0f); center_y.resize(padded, 0.0f); center_z.resize(padded, 0.0f);
+	extent_x.resize(padded, 0.0f); extent_y.resize(padded, 0.0f); extent_z.resize(padded, 0.0f);
+}
+
+void cull_frustum(const Frustum& frustum, const CullingInput& input, std::vector<u32>& visible)
+{
+	const u32 count = input.size();
+
+#if CULLING_WIDTH == 8
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+
+	for (u32 i = 0; i < count; i += 8) {
+		const __m256 cx = _mm256_loadu_ps(&input.center_x[i]);
+		const __m256 cy = _mm256_loadu_ps(&input.center_y[i]);
+		const __m256 cz = _mm256_loadu_ps(&input.center_z[i]);
+		const __m256 ex = _mm256_loadu_ps(&input.extent_x[i]);
+		const __m256 ey = _mm256_loadu_ps(&input.extent_y[i]);
+		const __m256 ez = _mm256_loadu_ps(&input.extent_z[i]);
+
+		__m256 outside = zero;
+		for (const auto& plane : frustum.planes) {
+			const __m256 nx = _mm256_set1_ps(plane.x);
+			const __m256 ny = _mm256_set1_ps(plane.y);
+			const __m256 nz = _mm256_set1_ps(plane.z);
+
+			// signed distance of the center plus the box radius projected on the normal
+			__m256 distance = _mm256_add_ps(_mm256_mul_ps(nx, cx), _mm256_set1_ps(plane.w));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(ny, cy));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(nz, cz));
+
+			__m256 radius = _mm256_mul_ps(_mm256_andnot_ps(sign_mask, nx), ex);
+			radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_andnot_ps(sign_mask, ny), ey));
+			radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_andnot_ps(sign_mask, nz), ez));
+
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_LT_OQ));
+		}
+
+		const i32 mask = _mm256_movemask_ps(outside);
+		for (u32 lane = 0; lane < 8 && i + lane < count; lane++) {
+			if (!(mask & (1 << lane)))
+				visible.push_back(i + lane);
+		}
+	}
+#elif CULLING_WIDTH == 4
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 sign_mask = _mm_set1_ps(-0.0f);
+
+	for (u32 i = 0; i < count; i += 4) {
+		const __m128 cx = _mm_loadu_ps(&input.center_x[i]);
+		const __m128 cy = _mm_loadu_ps(&input.center_y[i]);
+		const __m128 cz = _mm_loadu_ps(&input.center_z[i]);
+		const __m128 ex = _mm_loadu_ps(&input.extent_x[i]);
+		const __m128 ey = _mm_loadu_ps(&input.extent_y[i]);
+		const __m128 ez = _mm_loadu_ps(&input.extent_z[i]);
+
+		__m128 outside = zero;
+		for (const auto& plane : frustum.planes) {
+			const __m128 nx = _mm_set1_ps(plane.x);
+			const __m128 ny = _mm_set1_ps(plane.y);
+			const __m128 nz = _mm_set1_ps(plane.z);
+
+			// signed distance of the center plus the box radius projected on the normal
+			__m128 distance = _mm_add_ps(_mm_mul_ps(nx, cx), _mm_set1_ps(plane.w));
+			distance = _mm_add_ps(distance, _mm_mul_ps(ny, cy));
+			distance = _mm_add_ps(distance, _mm_mul_ps(nz, cz));
+
+			__m128 radius = _mm_mul_ps(_mm_andnot_ps(sign_mask, nx), ex);
+			radius = _mm_add_ps(radius, _mm_mul_ps(_mm_andnot_ps(sign_mask, ny), ey));
+			radius = _mm_add_ps(radius, _mm_mul_ps(_mm_andnot_ps(sign_mask, nz), ez));
+
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+		}
+
+		const i32 mask = _mm_movemask_ps(outside);
+		for (u32 lane = 0; lane < 4 && i + lane < count; lane++) {
+			if (!(mask & (1 << lane)))
+				visible.push_back(i + lane);
+		}
+	}
+#else
+	for (u32 i = 0; i < count; i++) {
+		AABB box;
+		box.min = glm::vec3(input.center_x[i] - input.extent_x[i], input.center_y[i] - input.extent_y[i], input.center_z[i] - input.extent_z[i]);
+		box.max = glm::vec3(input.center_x[i] + input.extent_x[i], input.center_y[i] + input.extent_y[i], input.center_z[i] + input.extent_z[i]);
+		if (frustum.intersects(box))
+			visible.push_back(i);
+	}
+#endif
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include <defines.hpp>
+#include <scene/bounds.hpp>
+#include <scene/transform_hierarchy.hpp>
+
+class Mesh;
+
+//
+// World space boxes of every renderable stored as structure of arrays, so the frustum
+// test can load 4 (SSE) or 8 (AVX) boxes per plane with a single instruction.
+// Rebuilt once per frame and shared by every pass that culls.
+//
+struct CullingInput {
+	std::vector<f32> center_x, center_y, center_z;
+	std::vector<f32> extent_x, extent_y, extent_z;
+
+	// what to draw when entry i is visible
+	std::vector<Mesh*> meshes;
+	std::vector<TransformHandle> transforms;
+
+	void clear();
+	void add(const AABB& box, Mesh* mesh, TransformHandle transform);
+	u32 size() const { return (u32)meshes.size(); }
+
+	// pads the box arrays to a multiple of the simd width, call after the last add()
+	void finalize();
+};
+
+// appends the index of every box intersecting the frustum to `visible`
+void cull_frustum(const Frustum& frustum, const CullingInput& input, std::vector<u32>& visible);
+
+struct CullingStats {
+	u32 tested = 0;
+	u32 visible = 0;
+	// hidden by occluders, already excluded from visible
+	u32 occluded = 0;
+
+	u32 get_culled() const { return tested - visible - occluded; }
+};
@@ -0,0 +1,46 @@
+#include "dynamic_resolution.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <imgui/imgui.h>
+
+void DynamicResolution::update(f32 gpu_milliseconds)
+{
+	m_gpu_milliseconds = gpu_milliseconds;
+	if (!m_enabled || gpu_milliseconds <= 0.0f)
+		return;
+
+	if (m_cooldown > 0) {
+		m_cooldown--;
+		return;
+	}
+
+	// gpu time scales roughly with the pixel count, the square of the scale. aim a bit
+	// under the budget so the next spike has room, and only grow with clear headroom
+	auto target = m_scale;
+	if (gpu_milliseconds > m_budget * 0.95f)
+		target = std::min(m_scale * std::sqrt(m_budget * 0.85f / gpu_milliseconds), m_scale - STEP);
+	else if (gpu_milliseconds < m_budget * 0.7f)
+		target = m_scale + STEP;
+
+	target = std::clamp(std::round(target / STEP) * STEP, m_min_scale, m_max_scale);
+	if (target != m_scale) {
+		m_scale = target;
+		m_cooldown = COOLDOWN_FRAMES;
+	}
+}
+
+glm::uvec2 DynamicResolution::get_render_size(u32 width, u32 height) const
+{
+	const auto scale = get_scale();
+	return glm::uvec2(std::max((u32)(width * scale), 1u), std::max((u32)(height * scale), 1u));
+}
+
+void DynamicResolution::render_debug_menu()
+{
+	ImGui::Checkbox("Dynamic resolution", &m_enabled);
+	ImGui::DragFloat("GPU budget (ms)", &m_budget, 0.1f, 1.0f, 100.0f);
+	ImGui::DragFloat("Min scale", &m_min_scale, 0.05f, 0.25f, m_max_scale);
+	ImGui::DragFloat("Max scale", &m_max_scale, 0.05f, m_min_scale, 1.0f);
+	ImGui::Text("GPU frame: %.2f ms, render scale %.2f", m_gpu_milliseconds, get_scale());
+}
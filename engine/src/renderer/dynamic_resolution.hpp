@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glm/glm/glm.hpp>
+#include <defines.hpp>
+
+//
+// Picks the internal render resolution from the measured gpu frame time. Over budget
+// the scale drops right away, under it the scale climbs back slowly, so a load spike
+// costs resolution instead of frame time. The scale moves in STEP increments and
+// changes at most every COOLDOWN_FRAMES, every size is a new set of frame graph
+// targets and a few sizes stay pooled at a time.
+//
+class DynamicResolution {
+public:
+	static constexpr f32 STEP = 0.05f;
+	static const u32 COOLDOWN_FRAMES = 15;
+
+	// feeds the gpu time of the last measured frame
+	void update(f32 gpu_milliseconds);
+
+	// internal resolution for a window of this size, the window size while disabled
+	glm::uvec2 get_render_size(u32 width, u32 height) const;
+
+	bool is_enabled() const { return m_enabled; }
+	f32 get_scale() const { return m_enabled ? m_scale : 1.0f; }
+	f32 get_gpu_milliseconds() const { return m_gpu_milliseconds; }
+
+	void render_debug_menu();
+
+private:
+	bool m_enabled = false;
+	f32 m_budget = 16.0f;
+	f32 m_min_scale = 0.5f;
+	f32 m_max_scale = 1.0f;
+
+	f32 m_scale = 1.0f;
+	f32 m_gpu_milliseconds = 0.0f;
+	u32 m_cooldown = 0;
+};
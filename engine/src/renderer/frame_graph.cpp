@@ -0,0 +1,524 @@
+#include "frame_graph.hpp"
+
+#include <queue>
+#include <algorithm>
+#include <imgui/imgui.h>
+#include "resources/gl_state.hpp"
+
+static u32 bytes_per_pixel(GLenum internal_format)
+{
+	switch (internal_format) {
+	case GL_R8: return 1;
+	case GL_RG8:
+	case GL_R16F: return 2;
+	case GL_RGBA16F:
+	case GL_RG32F:
+	case GL_DEPTH32F_STENCIL8: return 8;
+	case GL_RGBA32F: return 16;
+	}
+
+	// rgba8, rg16, r11g11b10, 24 bit depth with stencil, 32 bit depth
+	return 4;
+}
+
+FrameResource FrameGraph::Builder::create(const std::string& name, const RenderTargetDesc& desc)
+{
+	return m_graph.create(name, desc);
+}
+
+FrameResource FrameGraph::Builder::read(FrameResource resource)
+{
+	m_graph.m_passes[m_pass].reads.push_back(resource);
+	return resource;
+}
+
+FrameResource FrameGraph::Builder::write(FrameResource resource, bool clear)
+{
+	m_graph.m_passes[m_pass].writes.push_back({ resource, clear });
+	return resource;
+}
+
+void FrameGraph::Builder::set_side_effect()
+{
+	m_graph.m_passes[m_pass].side_effect = true;
+}
+
+std::shared_ptr<Texture> FrameGraph::Context::get_texture(FrameResource resource) const
+{
+	return m_graph.m_resources[m_graph.resolve(resource)].texture;
+}
+
+const RenderTargetDesc& FrameGraph::Context::get_desc(FrameResource resource) const
+{
+	return m_graph.get_desc(resource);
+}
+
+void FrameGraph::reset()
+{
+	m_resources.clear();
+	m_passes.clear();
+	m_order.clear();
+	m_compiled = false;
+	m_stats = {};
+}
+
+FrameResource FrameGraph::create(const std::string& name, const RenderTargetDesc& desc)
+{
+	const auto resource = (FrameResource)m_resources.size();
+
+	ResourceNode node{};
+	node.name = name;
+	node.desc = desc;
+	node.alias = resource;
+	m_resources.push_back(std::move(node));
+	return resource;
+}
+
+FrameResource FrameGraph::import(const std::string& name, std::shared_ptr<Texture> texture)
+{
+	const auto& spec = texture->get_spec();
+
+	RenderTargetDesc desc{};
+	desc.width = texture->get_width();
+	desc.height = texture->get_height();
+	desc.internal_format = spec.internalFormat;
+	desc.format = spec.format;
+	desc.type = spec.type;
+	desc.attachment = spec.attachement_target;
+	desc.filter = spec.minFilter;
+
+	const auto resource = create(name, desc);
+	m_resources[resource].imported = texture;
+	m_resources[resource].texture = std::move(texture);
+	return resource;
+}
+
+void FrameGraph::add_pass(const std::string& name, const Setup& setup, const Execute& execute)
+{
+	PassNode pass{};
+	pass.name = name;
+	pass.execute = execute;
+	m_passes.push_back(std::move(pass));
+
+	Builder builder(*this, (u32)m_passes.size() - 1);
+	setup(builder);
+}
+
+void FrameGraph::add_blit(const std::string& name, FrameResource source, FrameResource destination)
+{
+	PassNode pass{};
+	pass.name = name;
+	pass.blit = true;
+	pass.reads.push_back(source);
+	// the copy replaces the whole destination, what was there before is not needed
+	pass.writes.push_back({ destination, true });
+	m_passes.push_back(std::move(pass));
+}
+
+void FrameGraph::compile()
+{
+	sort_passes();
+	remove_blits();
+	cull_passes();
+	compute_lifetimes();
+
+	m_stats.passes = (u32)m_passes.size();
+	m_compiled = true;
+}
+
+FrameResource FrameGraph::resolve(FrameResource resource) const
+{
+	while (m_resources[resource].alias != resource)
+		resource = m_resources[resource].alias;
+
+	return resource;
+}
+
+bool FrameGraph::accessed(u32 pass, FrameResource resource) const
+{
+	const auto& node = m_passes[pass];
+	for (const auto read : node.reads) {
+		if (resolve(read) == resource)
+			return true;
+	}
+
+	for (const auto& write : node.writes) {
+		if (resolve(write.resource) == resource)
+			return true;
+	}
+
+	return false;
+}
+
+void FrameGraph::sort_passes()
+{
+	const auto count = (u32)m_passes.size();
+	std::vector<std::vector<u32>> edges(count);
+	std::vector<u32> incoming(count, 0);
+	auto add_edge = [&](u32 from, u32 to) {
+		if (from == to)
+			return;
+
+		edges[from].push_back(to);
+		incoming[to]++;
+	};
+
+	// writers of each resource in declaration order
+	std::vector<std::vector<u32>> writers(m_resources.size());
+	for (u32 pass = 0; pass < count; pass++) {
+		for (const auto& write : m_passes[pass].writes)
+			writers[write.resource].push_back(pass);
+	}
+
+	for (u32 pass = 0; pass < count; pass++) {
+		// a read sees the last write declared before it, or every write when the reader was declared first
+		for (const auto read : m_passes[pass].reads) {
+			const auto& list = writers[read];
+			const auto last = std::find_if(list.rbegin(), list.rend(), [pass](u32 writer) { return writer < pass; });
+			if (last != list.rend()) {
+				add_edge(*last, pass);
+			} else {
+				for (const auto writer : list)
+					add_edge(writer, pass);
+			}
+		}
+
+		// writes to the same target keep their declaration order and wait for the readers of the previous one
+		for (const auto& write : m_passes[pass].writes) {
+			const auto& list = writers[write.resource];
+			const auto last = std::find_if(list.rbegin(), list.rend(), [pass](u32 writer) { return writer < pass; });
+			if (last == list.rend())
+				continue;
+
+			add_edge(*last, pass);
+			for (u32 reader = *last + 1; reader < pass; reader++) {
+				const auto& reads = m_passes[reader].reads;
+				if (std::find(reads.begin(), reads.end(), write.resource) != reads.end())
+					add_edge(reader, pass);
+			}
+		}
+	}
+
+	// kahn's algorithm, ties go to the pass declared first so independent passes keep their order
+	std::priority_queue<u32, std::vector<u32>, std::greater<u32>> ready;
+	for (u32 pass = 0; pass < count; pass++) {
+		if (incoming[pass] == 0)
+			ready.push(pass);
+	}
+
+	m_order.clear();
+	while (!ready.empty()) {
+		const auto pass = ready.top();
+		ready.pop();
+		m_order.push_back(pass);
+
+		for (const auto next : edges[pass]) {
+			if (--incoming[next] == 0)
+				ready.push(next);
+		}
+	}
+
+	if (m_order.size() != count) {
+		KERROR("Frame graph has a dependency cycle, running passes in declaration order");
+		m_order.resize(count);
+		for (u32 pass = 0; pass < count; pass++)
+			m_order[pass] = pass;
+	}
+}
+
+void FrameGraph::remove_blits()
+{
+	for (u32 position = 0; position < m_order.size(); position++) {
+		auto& pass = m_passes[m_order[position]];
+		if (!pass.blit)
+			continue;
+
+		const auto source = resolve(pass.reads[0]);
+		const auto destination = resolve(pass.writes[0].resource);
+		if (source == destination) {
+			pass.removed = true;
+			m_stats.removed_blits++;
+			continue;
+		}
+
+		auto& src = m_resources[source];
+		auto& dst = m_resources[destination];
+
+		// the producer can only write the destination directly if both are the same kind of
+		// target, and merging them must not be observable: nothing touches the source after
+		// the copy and nothing touches the destination before it
+		bool removable = !(src.imported && dst.imported) && src.desc.matches(dst.desc);
+		for (u32 other = 0; removable && other < m_order.size(); other++) {
+			if (m_passes[m_order[other]].removed)
+				continue;
+			if (other > position && accessed(m_order[other], source))
+				removable = false;
+			if (other < position && accessed(m_order[other], destination))
+				removable = false;
+		}
+
+		if (!removable)
+			continue;
+
+		// the merged target is the imported texture when there is one
+		if (dst.imported)
+			src.alias = destination;
+		else
+			dst.alias = source;
+
+		pass.removed = true;
+		m_stats.removed_blits++;
+	}
+}
+
+void FrameGraph::cull_passes()
+{
+	// walk back from the passes with side effects, a pass survives if a later pass needs what it writes
+	std::vector<bool> needed(m_resources.size(), false);
+	for (auto it = m_order.rbegin(); it != m_order.rend(); ++it) {
+		auto& pass = m_passes[*it];
+		if (pass.removed)
+			continue;
+
+		bool alive = pass.side_effect;
+		for (const auto& write : pass.writes)
+			alive = alive || needed[resolve(write.resource)];
+
+		pass.culled = !alive;
+		if (!alive) {
+			m_stats.culled_passes++;
+			continue;
+		}
+
+		// a cleared target does not depend on earlier writes, a loaded one builds on them
+		for (const auto& write : pass.writes)
+			needed[resolve(write.resource)] = !write.clear;
+
+		for (const auto read : pass.reads)
+			needed[resolve(read)] = true;
+	}
+}
+
+void FrameGraph::compute_lifetimes()
+{
+	for (auto& resource : m_resources) {
+		resource.first_use = ~0u;
+		resource.last_use = 0;
+	}
+
+	for (u32 position = 0; position < m_order.size(); position++) {
+		const auto& pass = m_passes[m_order[position]];
+		if (pass.culled || pass.removed)
+			continue;
+
+		auto use = [&](FrameResource resource) {
+			auto& node = m_resources[resolve(resource)];
+			node.first_use = std::min(node.first_use, position);
+			node.last_use = std::max(node.last_use, position);
+		};
+
+		for (const auto read : pass.reads)
+			use(read);
+		for (const auto& write : pass.writes)
+			use(write.resource);
+	}
+
+	for (u32 resource = 0; resource < m_resources.size(); resource++) {
+		const auto& node = m_resources[resource];
+		if (resolve(resource) == resource && !node.imported && node.first_use != ~0u)
+			m_stats.transient_targets++;
+	}
+}
+
+void FrameGraph::execute()
+{
+	if (!m_compiled)
+		compile();
+
+	m_frame++;
+	for (u32 position = 0; position < m_order.size(); position++) {
+		const auto& pass = m_passes[m_order[position]];
+		if (pass.culled || pass.removed)
+			continue;
+
+		auto for_each_target = [&](auto&& fn) {
+			for (const auto read : pass.reads)
+				fn(m_resources[resolve(read)]);
+			for (const auto& write : pass.writes)
+				fn(m_resources[resolve(write.resource)]);
+		};
+
+		// transient targets get their texture right before the first pass using them
+		for_each_target([&](ResourceNode& node) {
+			if (!node.imported && !node.texture)
+				node.texture = acquire(node.desc);
+		});
+
+		if (pass.blit)
+			run_blit(pass);
+		else
+			run_pass(pass);
+
+		// and give it back after the last one, a later target of the same kind reuses it
+		for_each_target([&](ResourceNode& node) {
+			if (!node.imported && node.last_use == position)
+				release(node.texture);
+		});
+	}
+
+	m_stats.textures = 0;
+	m_stats.texture_bytes = 0;
+	for (const auto& pooled : m_pool) {
+		if (pooled.last_frame != m_frame)
+			continue;
+
+		m_stats.textures++;
+		m_stats.texture_bytes += (u64)pooled.desc.width * pooled.desc.height * bytes_per_pixel(pooled.desc.internal_format);
+	}
+
+	trim_pool();
+}
+
+void FrameGraph::run_pass(const PassNode& pass)
+{
+	std::vector<std::shared_ptr<Texture>> targets;
+	for (const auto& write : pass.writes)
+		targets.push_back(m_resources[resolve(write.resource)].texture);
+
+	if (!targets.empty()) {
+		get_framebuffer(targets)->bind();
+		glViewport(0, 0, targets[0]->get_width(), targets[0]->get_height());
+
+		u32 color = 0;
+		for (u32 i = 0; i < targets.size(); i++) {
+			const auto attachment = targets[i]->get_spec().attachement_target;
+			const bool clear = pass.writes[i].clear;
+
+			if (attachment == GL_COLOR_ATTACHMENT0) {
+				const f32 black[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+				if (clear)
+					glClearBufferfv(GL_COLOR, color, black);
+				color++;
+			} else if (clear && attachment == GL_DEPTH_STENCIL_ATTACHMENT) {
+				glClearBufferfi(GL_DEPTH_STENCIL, 0, 1.0f, 0);
+			} else if (clear) {
+				const f32 depth = 1.0f;
+				glClearBufferfv(GL_DEPTH, 0, &depth);
+			}
+		}
+	}
+
+	pass.execute(Context(*this));
+}
+
+void FrameGraph::run_blit(const PassNode& pass)
+{
+	const auto source = m_resources[resolve(pass.reads[0])].texture;
+	const auto destination = m_resources[resolve(pass.writes[0].resource)].texture;
+
+	GLbitfield mask = GL_COLOR_BUFFER_BIT;
+	switch (source->get_spec().attachement_target) {
+	case GL_DEPTH_ATTACHMENT: mask = GL_DEPTH_BUFFER_BIT; break;
+	case GL_DEPTH_STENCIL_ATTACHMENT: mask = GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT; break;
+	}
+
+	// only color can be filtered, depth copies have to match in size anyway
+	const bool scaled = source->get_width() != destination->get_width() || source->get_height() != destination->get_height();
+	const auto filter = mask == GL_COLOR_BUFFER_BIT && scaled ? GL_LINEAR : GL_NEAREST;
+
+	auto state = GlState::get();
+	state->bind_framebuffer(GL_READ_FRAMEBUFFER, get_framebuffer({ source })->get_resource_id());
+	state->bind_framebuffer(GL_DRAW_FRAMEBUFFER, get_framebuffer({ destination })->get_resource_id());
+	glBlitFramebuffer(0, 0, source->get_width(), source->get_height(), 0, 0, destination->get_width(), destination->get_height(), mask, filter);
+}
+
+std::shared_ptr<Texture> FrameGraph::acquire(const RenderTargetDesc& desc)
+{
+	for (auto& pooled : m_pool) {
+		if (!pooled.in_use && pooled.desc.matches(desc)) {
+			pooled.in_use = true;
+			pooled.last_frame = m_frame;
+			return pooled.texture;
+		}
+	}
+
+	TextureSpecification spec{};
+	spec.width = std::max(desc.width, 1u);
+	spec.height = std::max(desc.height, 1u);
+	spec.internalFormat = desc.internal_format;
+	spec.format = desc.format;
+	spec.type = desc.type;
+	spec.wrapS = GL_CLAMP_TO_EDGE;
+	spec.wrapT = GL_CLAMP_TO_EDGE;
+	spec.minFilter = desc.filter;
+	spec.magFilter = desc.filter;
+	spec.attachement_target = desc.attachment;
+	spec.generateMipmaps = false;
+
+	auto texture = Texture::create(spec);
+	m_pool.push_back({ desc, texture, m_frame, true });
+	return texture;
+}
+
+void FrameGraph::release(const std::shared_ptr<Texture>& texture)
+{
+	for (auto& pooled : m_pool) {
+		if (pooled.texture == texture)
+			pooled.in_use = false;
+	}
+}
+
+void FrameGraph::trim_pool()
+{
+	m_stats.pooled_bytes = 0;
+	std::erase_if(m_pool, [&](const PooledTexture& pooled) {
+		return !pooled.in_use && m_frame - pooled.last_frame > POOL_FRAMES;
+	});
+
+	for (const auto& pooled : m_pool)
+		m_stats.pooled_bytes += (u64)pooled.desc.width * pooled.desc.height * bytes_per_pixel(pooled.desc.internal_format);
+
+	std::erase_if(m_framebuffers, [](const auto& entry) {
+		const auto& textures = entry.second.textures;
+		return std::any_of(textures.begin(), textures.end(), [](const std::weak_ptr<Texture>& texture) { return texture.expired(); });
+	});
+}
+
+Framebuffer* FrameGraph::get_framebuffer(const std::vector<std::shared_ptr<Texture>>& textures)
+{
+	std::vector<u32> key;
+	for (const auto& texture : textures)
+		key.push_back(texture->get_resource_id());
+
+	auto& cached = m_framebuffers[key];
+	bool valid = cached.framebuffer != nullptr;
+	for (u32 i = 0; valid && i < textures.size(); i++)
+		valid = cached.textures[i].lock() == textures[i];
+
+	if (!valid) {
+		FramebufferSpecification spec{};
+		spec.color_attachements = textures;
+		spec.depth_stencil = false;
+		spec.width = textures[0]->get_width();
+		spec.height = textures[0]->get_height();
+		spec.clear_color = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+		cached.textures.assign(textures.begin(), textures.end());
+		cached.framebuffer = Framebuffer::create(spec);
+	}
+
+	return cached.framebuffer.get();
+}
+
+void FrameGraph::render_debug_menu()
+{
+	ImGui::Text("Passes: %u (%u culled, %u blits removed)", m_stats.passes, m_stats.culled_passes, m_stats.removed_blits);
+	ImGui::Text("Transient targets: %u in %u textures (%.1f MB, %.1f MB pooled)", m_stats.transient_targets, m_stats.textures,
+		m_stats.texture_bytes / (1024.0 * 1024.0), m_stats.pooled_bytes / (1024.0 * 1024.0));
+
+	for (const auto index : m_order) {
+		const auto& pass = m_passes[index];
+		const char* status = pass.removed ? " (removed)" : pass.culled ? " (culled)" : "";
+		ImGui::BulletText("%s%s", pass.name.c_str(), status);
+	}
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <glad/glad.h>
+
+#include <defines.hpp>
+#include "resources/texture.hpp"
+#include "resources/framebuffer.hpp"
+
+// handle to a render target declared in the frame graph, only valid for the frame it was declared in
+using FrameResource = u32;
+static const FrameResource INVALID_FRAME_RESOURCE = ~0u;
+
+struct RenderTargetDesc {
+	u32 width = 0;
+	u32 height = 0;
+	GLenum internal_format = GL_RGBA16F;
+	GLenum format = GL_RGBA;
+	GLenum type = GL_FLOAT;
+	// GL_COLOR_ATTACHMENT0, GL_DEPTH_ATTACHMENT or GL_DEPTH_STENCIL_ATTACHMENT
+	GLenum attachment = GL_COLOR_ATTACHMENT0;
+	GLenum filter = GL_LINEAR;
+
+	// targets with equal descriptions can share memory
+	bool matches(const RenderTargetDesc& other) const {
+		return width == other.width && height == other.height && internal_format == other.internal_format
+			&& format == other.format && type == other.type && attachment == other.attachment && filter == other.filter;
+	}
+};
+
+//
+// Per-frame graph of render passes. Passes declare the targets they read and write,
+// the graph orders them by those dependencies, culls passes whose results nobody
+// consumes and backs transient targets with pooled textures: a texture is handed to
+// the next target of the same description as soon as its last reader ran, so targets
+// with disjoint lifetimes share memory. Declared blits are removed when the producer
+// can write the destination directly, by making both names the same texture.
+//
+// Declaration is rebuilt every frame: reset(), add passes, compile(), execute().
+//
+class FrameGraph {
+public:
+	class Builder {
+	public:
+		FrameResource create(const std::string& name, const RenderTargetDesc& desc);
+		FrameResource read(FrameResource resource);
+		// attaches the target to the pass framebuffer, cleared first when `clear` is set
+		FrameResource write(FrameResource resource, bool clear = false);
+		// keeps the pass even if nothing reads what it writes, e.g. drawing to the window
+		void set_side_effect();
+
+	private:
+		friend class FrameGraph;
+		Builder(FrameGraph& graph, u32 pass) : m_graph(graph), m_pass(pass) {}
+
+		FrameGraph& m_graph;
+		u32 m_pass;
+	};
+
+	class Context {
+	public:
+		std::shared_ptr<Texture> get_texture(FrameResource resource) const;
+		const RenderTargetDesc& get_desc(FrameResource resource) const;
+
+	private:
+		friend class FrameGraph;
+		Context(const FrameGraph& graph) : m_graph(graph) {}
+
+		const FrameGraph& m_graph;
+	};
+
+	using Setup = std::function<void(Builder&)>;
+	using Execute = std::function<void(const Context&)>;
+
+	struct Stats {
+		u32 passes = 0;
+		u32 culled_passes = 0;
+		u32 removed_blits = 0;
+		u32 transient_targets = 0;
+		// textures backing the transient targets this frame and their size
+		u32 textures = 0;
+		u64 texture_bytes = 0;
+		u64 pooled_bytes = 0;
+	};
+
+	// frames a pooled texture survives unused, resizing the window leaves the old sizes behind
+	static const u32 POOL_FRAMES = 8;
+
+	void reset();
+
+	FrameResource create(const std::string& name, const RenderTargetDesc& desc);
+	// a persistent texture owned outside the graph, never pooled or aliased with another import
+	FrameResource import(const std::string& name, std::shared_ptr<Texture> texture);
+
+	// `setup` runs immediately, `execute` runs from execute() if the pass survives compile()
+	void add_pass(const std::string& name, const Setup& setup, const Execute& execute);
+	// copies `source` to `destination` with glBlitFramebuffer unless the copy can be removed
+	void add_blit(const std::string& name, FrameResource source, FrameResource destination);
+
+	void compile();
+	void execute();
+
+	const RenderTargetDesc& get_desc(FrameResource resource) const { return m_resources[resolve(resource)].desc; }
+	const Stats& get_stats() const { return m_stats; }
+	void render_debug_menu();
+
+private:
+	struct ResourceNode {
+		std::string name;
+		RenderTargetDesc desc;
+		std::shared_ptr<Texture> imported;
+		// resource this one was merged into by blit removal, itself when not merged
+		FrameResource alias;
+
+		// execution range of the passes using it, transient targets live in between
+		u32 first_use;
+		u32 last_use;
+		std::shared_ptr<Texture> texture;
+	};
+
+	struct Write {
+		FrameResource resource;
+		bool clear;
+	};
+
+	struct PassNode {
+		std::string name;
+		std::vector<FrameResource> reads;
+		std::vector<Write> writes;
+		Execute execute;
+		bool side_effect = false;
+		bool culled = false;
+
+		bool blit = false;
+		bool removed = false;
+	};
+
+	struct PooledTexture {
+		RenderTargetDesc desc;
+		std::shared_ptr<Texture> texture;
+		u64 last_frame;
+		bool in_use;
+	};
+
+	std::vector<ResourceNode> m_resources;
+	std::vector<PassNode> m_passes;
+	// pass indices in execution order
+	std::vector<u32> m_order;
+	bool m_compiled = false;
+
+	struct CachedFramebuffer {
+		// texture names are reused after deletion, the weak references tell a stale entry apart
+		std::vector<std::weak_ptr<Texture>> textures;
+		std::shared_ptr<Framebuffer> framebuffer;
+	};
+
+	std::vector<PooledTexture> m_pool;
+	// framebuffers by attached texture ids
+	std::map<std::vector<u32>, CachedFramebuffer> m_framebuffers;
+	u64 m_frame = 0;
+	Stats m_stats;
+
+	FrameResource resolve(FrameResource resource) const;
+	bool accessed(u32 pass, FrameResource resource) const;
+
+	void sort_passes();
+	void remove_blits();
+	void cull_passes();
+	void compute_lifetimes();
+
+	std::shared_ptr<Texture> acquire(const RenderTargetDesc& desc);
+	void release(const std::shared_ptr<Texture>& texture);
+	void trim_pool();
+	Framebuffer* get_framebuffer(const std::vector<std::shared_ptr<Texture>>& textures);
+
+	void run_blit(const PassNode& pass);
+	void run_pass(const PassNode& pass);
+};
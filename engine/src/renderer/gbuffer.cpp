@@ -2,46 +2,79 @@
 
 #include <engine.hpp>
 #include "model.hpp"
+#include "instancing.hpp"
+#include "command_buffer.hpp"
+#include "light_clusters.hpp"
+#include "resources/gl_state.hpp"
 #include <imgui/imgui.h>
 #include <utils.hpp>
 
-GBuffer::GBuffer(FramebufferSpecification spec) {
-	m_framebuffer = Framebuffer::create(spec);
-	m_outputs.insert(m_outputs.end(), spec.color_attachements.begin(), spec.color_attachements.end());
+GBuffer::GBuffer(std::shared_ptr<ShaderProgram> shader) {
+	m_shader = shader;
 }
 
-std::shared_ptr<Texture> GBuffer::get_albedo() {
-	return std::dynamic_pointer_cast<Texture>(m_outputs.at(0));
+GBufferTargets GBuffer::declare(FrameGraph::Builder& builder, u32 width, u32 height) const {
+	auto target = [&](const std::string& name, GLenum internal_format, GLenum format, GLenum type) {
+		RenderTargetDesc desc{};
+		desc.width = width;
+		desc.height = height;
+		desc.internal_format = internal_format;
+		desc.format = format;
+		desc.type = type;
+		return builder.write(builder.create(name, desc), true);
+	};
+
+	GBufferTargets targets{};
+	targets.albedo = target("albedo", GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE);
+	// octahedral encoded, see gbuffer.frag
+	targets.normals = target("normals", GL_RG16, GL_RG, GL_UNSIGNED_SHORT);
+	// r-ambient occlusion, g-roughness, b-metallic
+	targets.mra = target("mra", GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+	targets.emissive = target("emissive", GL_R11F_G11F_B10F, GL_RGB, GL_FLOAT);
+
+	RenderTargetDesc desc{};
+	desc.width = width;
+	desc.height = height;
+	desc.internal_format = GL_DEPTH24_STENCIL8;
+	desc.format = GL_DEPTH_STENCIL;
+	desc.type = GL_UNSIGNED_INT_24_8;
+	desc.attachment = GL_DEPTH_STENCIL_ATTACHMENT;
+	desc.filter = GL_NEAREST;
+	targets.depth = builder.write(builder.create("depth", desc), true);
+	return targets;
 }
 
-std::shared_ptr<Texture> GBuffer::get_normals() {
-	return std::dynamic_pointer_cast<Texture>(m_outputs.at(1));
+void GBuffer::start() {
+	RenderPass::start();
+	// albedo is written linear and stored srgb
+	GlState::get()->enable(GL_FRAMEBUFFER_SRGB);
 }
 
-std::shared_ptr<Texture> GBuffer::get_mra() {
-	return std::dynamic_pointer_cast<Texture>(m_outputs.at(2));
+void GBuffer::stop() {
+	GlState::get()->disable(GL_FRAMEBUFFER_SRGB);
+	RenderPass::stop();
 }
 
-std::shared_ptr<Texture> GBuffer::get_emissive() {
-	return std::dynamic_pointer_cast<Texture>(m_outputs.at(3));
+void GBuffer::read(FrameGraph::Builder& builder, const GBufferTargets& targets) {
+	builder.read(targets.albedo);
+	builder.read(targets.normals);
+	builder.read(targets.mra);
+	builder.read(targets.emissive);
+	builder.read(targets.depth);
 }
 
-std::shared_ptr<Texture> GBuffer::get_world() {
-	return std::dynamic_pointer_cast<Texture>(m_outputs.at(4));
-
-}
-
-void GBuffer::bind_textures() {
-	get_albedo()->bind();
-	get_normals()->bind();
-	get_mra()->bind();
-	get_emissive()->bind();
-	get_world()->bind();
+void GBuffer::bind_textures(const FrameGraph::Context& context, const GBufferTargets& targets) {
+	context.get_texture(targets.albedo)->bind(0);
+	context.get_texture(targets.normals)->bind(1);
+	context.get_texture(targets.mra)->bind(2);
+	context.get_texture(targets.emissive)->bind(3);
+	context.get_texture(targets.depth)->bind(4);
 }
 
 void RenderPass::start() {
 	m_shader->bind();
-	m_framebuffer->begin_pass();
+	if (m_framebuffer)
+		m_framebuffer->begin_pass();
 
 	for (const auto& bindable : m_dependencies) {
 		bindable->bind();
@@ -54,11 +87,28 @@ void RenderPass::start() {
 
 void RenderPass::stop() {
 	m_shader->unbind();
-	m_framebuffer->unbind();
+	if (m_framebuffer)
+		m_framebuffer->unbind();
 }
 
-void RenderPass::render(const std::shared_ptr<Model>& model, const glm::mat4& transform) {
-	model->render(m_shader, transform);
+void RenderPass::record(CommandBuffer& commands, u8 layer, const InstanceBatch& batch, u32 view) const {
+	const auto count = (u32)batch.transforms[view].size();
+	if (count == 0)
+		return;
+
+	const auto mesh = batch.mesh;
+	DrawCommand command{};
+	const auto material = mesh->get_material();
+	command.key = make_draw_key(layer, m_shader->get_resource_id(), material->texture_set, material->material_index, mesh->get_vao()->get_resource_id());
+	command.program = m_shader.get();
+	command.material = material;
+	command.vao = mesh->get_vao();
+	command.first_index = mesh->get_geometry().first_index;
+	command.index_count = mesh->get_geometry().index_count;
+	command.base_vertex = mesh->get_geometry().base_vertex;
+	command.first_instance = batch.first[view];
+	command.instance_count = count;
+	commands.push(command);
 }
 
 void RenderPass::set_shader(std::shared_ptr<ShaderProgram> shader) {
@@ -78,18 +128,11 @@ void RenderPass::addOutputBindables(std::shared_ptr<Bindable> bindable) {
 }
 
 
-LightingPass::LightingPass(
-	FramebufferSpecification spec,
-	std::shared_ptr<ShaderProgram> shader,
-	std::vector<std::shared_ptr<Bindable>> gbuffer_textures,
-	std::shared_ptr<IBL> ibl, ShadowMapPass* shadow_pass) {
-
-	m_framebuffer = Framebuffer::create(spec);
+LightingPass::LightingPass(std::shared_ptr<ShaderProgram> shader, std::shared_ptr<IBL> ibl, ShadowMapPass* shadow_pass, LightClusters* clusters) {
 	m_shader = shader;
 	m_ibl = ibl;
 	m_shadow_pass = shadow_pass;
-
-	m_dependencies.insert(m_dependencies.begin(), gbuffer_textures.begin(), gbuffer_textures.end());
+	m_clusters = clusters;
 }
 
 void LightingPass::start() {
@@ -97,40 +140,121 @@ void LightingPass::start() {
 
 	m_ibl->bind(5, 6, 7);
 
-	auto light_space = m_shadow_pass->get_light_space();
-	auto shadow_map = m_shadow_pass->get_depth_texture();
+	for (u32 i = 0; i < ShadowMapPass::CASCADES; i++) {
+		const auto light_space = m_shadow_pass->get_light_space(i);
+		m_shader->set_mat4(std::format("cascade_matrices[{}]", i), glm::value_ptr(light_space));
+		m_shader->set_float(std::format("cascade_splits[{}]", i), m_shadow_pass->get_split(i));
+	}
 
-	m_shader->set_mat4("light_space_matrix", glm::value_ptr(light_space));
-	shadow_map->bind(8);
+	m_shader->set_mat4("inverse_view_projection", glm::value_ptr(m_inverse_view_projection));
+	m_shadow_pass->get_depth_texture()->bind(8);
+	m_shadow_pass->bind_moments(*m_shader);
+
+	m_clusters->bind(*m_shader);
+	m_shadow_pass->get_virtual().bind(*m_shader);
+	m_shadow_pass->get_local().bind();
+}
+
+void LightingPass::set_view_projection(const glm::mat4& view_projection) {
+	m_inverse_view_projection = glm::inverse(view_projection);
 }
 
-ShadowMapPass::ShadowMapPass(FramebufferSpecification spec, std::shared_ptr<ShaderProgram> shader) {
+ShadowMapPass::ShadowMapPass(std::shared_ptr<ShaderProgram> shader, std::shared_ptr<ShaderProgram> mark_shader,
+	std::shared_ptr<ShaderProgram> moments_shader, std::shared_ptr<ShaderProgram> blur_shader)
+	: m_moments_shader(moments_shader), m_blur_shader(blur_shader), m_virtual(mark_shader), m_local(shader) {
 	m_shader = shader;
+	apply_resolution(DEFAULT_RESOLUTION);
+}
 
-	// create depth texture
+ShadowMapPass::~ShadowMapPass() {
+	delete_moments_views();
+}
+
+void ShadowMapPass::apply_resolution(u32 resolution) {
+	m_shadow_texture = create_atlas(resolution);
+	m_static_texture = create_atlas(resolution);
+
+	const auto tile = resolution / MOMENTS_DOWNSAMPLE;
+	TextureSpecification tspec{};
+	tspec.internalFormat = GL_RGBA32F;
+	tspec.format = GL_RGBA;
+	tspec.type = GL_FLOAT;
+	tspec.width = tile;
+	tspec.height = tile;
+	tspec.wrapS = GL_CLAMP_TO_EDGE;
+	tspec.wrapT = GL_CLAMP_TO_EDGE;
+	tspec.minFilter = GL_NEAREST;
+	tspec.magFilter = GL_NEAREST;
+	tspec.generateMipmaps = false;
+	m_moments_scratch = Texture::create(tspec);
+
+	FramebufferSpecification fspec{};
+	fspec.color_attachements = { m_moments_scratch };
+	fspec.depth_stencil = false;
+	fspec.width = tile;
+	fspec.height = tile;
+	m_moments_framebuffer = Framebuffer::create(fspec);
+
+	tspec.generateMipmaps = true;
+	TextureArraySpecification aspec{};
+	aspec.width = tile;
+	aspec.height = tile;
+	aspec.levels = TextureArray::level_count(tspec, tile, tile);
+	aspec.internal_format = GL_RGBA32F;
+	aspec.slot = 10;
+	aspec.capacity = CASCADES;
+	delete_moments_views();
+	m_moments = TextureArray::create(aspec);
+	// filtering at the tile edges must not wrap around to the opposite edge
+	m_moments->bind();
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	m_moments->unbind();
+
+	glGenTextures(CASCADES, m_moments_views.data());
+	for (u32 i = 0; i < CASCADES; i++)
+		glTextureView(m_moments_views[i], GL_TEXTURE_2D, m_moments->get_resource_id(), GL_RGBA32F, 0, aspec.levels, i, 1);
+
+	m_resolution = resolution;
+	m_invalidated = true;
+	for (auto& cascade : m_cascades)
+		cascade.moments_dirty = true;
+}
+
+void ShadowMapPass::delete_moments_views() {
+	for (auto& view : m_moments_views) {
+		if (!view)
+			continue;
+
+		glDeleteTextures(1, &view);
+		GlState::get()->on_texture_deleted(view);
+		view = 0;
+	}
+}
+
+std::shared_ptr<Texture> ShadowMapPass::create_atlas(u32 resolution) {
+	// every cascade is a tile of the atlas
 	TextureSpecification tspec{};
 	tspec.internalFormat = GL_DEPTH_COMPONENT;
 	tspec.format = GL_DEPTH_COMPONENT;
 	tspec.type = GL_FLOAT;
-	tspec.width = 12024;
-	tspec.height = 12024;
+	tspec.width = resolution * ATLAS_COLUMNS;
+	tspec.height = resolution * ((CASCADES + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS);
 	tspec.wrapS = GL_CLAMP_TO_BORDER;
 	tspec.wrapT = GL_CLAMP_TO_BORDER;
 	tspec.minFilter = GL_NEAREST;
 	tspec.magFilter = GL_NEAREST;
 	tspec.attachement_target = GL_DEPTH_ATTACHMENT;
-	
-	m_shadow_texture = std::make_shared<Texture>(tspec);
+	tspec.generateMipmaps = false;
+
+	auto texture = std::make_shared<Texture>(tspec);
 
 	// set border
-	m_shadow_texture->bind();
+	texture->bind();
 	float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
 	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-	m_shadow_texture->unbind();
-	
-	spec.color_attachements = { m_shadow_texture };
-	m_framebuffer = Framebuffer::create(spec);
-
+	texture->unbind();
+	return texture;
 }
 
 void ShadowMapPass::set_light_position(const glm::vec3& pos) {
@@ -138,44 +262,278 @@ void ShadowMapPass::set_light_position(const glm::vec3& pos) {
 }
 
 void ShadowMapPass::start() {
+	// the frame graph binds the atlas, cascades clear their own tile as not all of them are redrawn
 	RenderPass::start();
+	GlState::get()->enable(GL_SCISSOR_TEST);
+}
 
-	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-	glClear(GL_DEPTH_BUFFER_BIT);
-	//glCullFace(GL_FRONT);
+void ShadowMapPass::begin_static_cascade(u32 cascade) {
+	const auto x = (i32)((cascade % ATLAS_COLUMNS) * m_resolution);
+	const auto y = (i32)((cascade / ATLAS_COLUMNS) * m_resolution);
+	glViewport(x, y, m_resolution, m_resolution);
+	glScissor(x, y, m_resolution, m_resolution);
 
-	glViewport(0, 0, 12024, 12024);
-	auto light_space = get_light_space();
+	const f32 depth = 1.0f;
+	glClearBufferfv(GL_DEPTH, 0, &depth);
+
+	auto& state = m_cascades[cascade];
+	state.static_light_space = state.light_space;
+	state.static_dirty = false;
+	state.holds_static = false;
 
 	m_shader->bind();
-	m_shader->set_mat4("light_space_matrix", glm::value_ptr(light_space));
+	m_shader->set_mat4("light_space_matrix", glm::value_ptr(state.light_space));
+}
+
+bool ShadowMapPass::begin_cascade(u32 cascade, u64 dynamic_instances) {
+	auto& state = m_cascades[cascade];
+	if (m_cache_static && state.holds_static && dynamic_instances == 0)
+		return false;
+
+	const auto x = (i32)((cascade % ATLAS_COLUMNS) * m_resolution);
+	const auto y = (i32)((cascade / ATLAS_COLUMNS) * m_resolution);
+	glViewport(x, y, m_resolution, m_resolution);
+	glScissor(x, y, m_resolution, m_resolution);
+	state.moments_dirty = true;
+
+	if (m_cache_static) {
+		// moving casters are drawn over the static ones, also erasing where they were last frame
+		glCopyImageSubData(m_static_texture->get_resource_id(), GL_TEXTURE_2D, 0, x, y, 0,
+			m_shadow_texture->get_resource_id(), GL_TEXTURE_2D, 0, x, y, 0, m_resolution, m_resolution, 1);
+		state.holds_static = dynamic_instances == 0;
+		if (state.holds_static)
+			return false;
+	} else {
+		const f32 depth = 1.0f;
+		glClearBufferfv(GL_DEPTH, 0, &depth);
+		state.holds_static = false;
+	}
+
+	m_shader->bind();
+	m_shader->set_mat4("light_space_matrix", glm::value_ptr(state.light_space));
+	return true;
 }
 
 void ShadowMapPass::stop() {
 	RenderPass::stop();
-	glCullFace(GL_BACK);
+	GlState::get()->disable(GL_SCISSOR_TEST);
+	GlState::get()->cull_face(GL_BACK);
 }
 
 std::shared_ptr<Texture> ShadowMapPass::get_depth_texture() {
 	return m_shadow_texture;
 }
 
-glm::mat4 ShadowMapPass::get_light_space() {
-	glm::mat4 proj = glm::ortho(-bounds, bounds, -bounds, bounds, near_plane, far_plane);
-	glm::mat4 view = glm::lookAt(light_position * m_distance, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+void ShadowMapPass::update(const glm::mat4& camera_view, const glm::mat4& camera_projection, f32 camera_near, f32 camera_far, const AABB& scene_bounds, u64 static_revision) {
+	m_frame++;
+	// the textures are only replaced before anything was scheduled against them
+	if (m_resolution != m_resolution_next)
+		apply_resolution(m_resolution_next);
+
+	if (m_cache_static != m_cache_static_next) {
+		m_cache_static = m_cache_static_next;
+		m_invalidated = true;
+	}
+
+	// the moments were not kept up to date while filtering was off
+	if (m_filtered != m_filtered_next) {
+		m_filtered = m_filtered_next;
+		for (auto& cascade : m_cascades)
+			cascade.moments_dirty = true;
+	}
+
+	if (light_position != m_rendered_light_position || static_revision != m_static_revision) {
+		m_rendered_light_position = light_position;
+		m_static_revision = static_revision;
+		m_invalidated = true;
+	}
+
+	for (u32 i = 0; i < CASCADES; i++) {
+		auto& cascade = m_cascades[i];
+		cascade.updated = m_invalidated || !m_staggered || (m_frame + i) % m_intervals[i] == 0;
+		if (m_invalidated)
+			cascade.static_dirty = true;
+	}
+	m_invalidated = false;
+
+	const auto light_view = get_light_view();
+
+	auto scene_ls = AABB::empty();
+	if (!scene_bounds.is_empty()) {
+		for (u32 i = 0; i < 8; i++)
+			scene_ls.grow(glm::vec3(light_view * glm::vec4(scene_bounds.get_corner(i), 1.0f)));
+	}
+
+	const auto distance = glm::min(m_shadow_distance, camera_far);
+	const auto inverse_camera = glm::inverse(camera_projection * camera_view);
+	auto slice_near = camera_near;
+
+	for (u32 i = 0; i < CASCADES; i++) {
+		// practical split scheme
+		const auto t = (f32)(i + 1) / CASCADES;
+		const auto log_split = camera_near * glm::pow(distance / camera_near, t);
+		const auto uniform_split = camera_near + (distance - camera_near) * t;
+		const auto slice_far = glm::mix(uniform_split, log_split, m_split_lambda);
+
+		auto& cascade = m_cascades[i];
+		if (!cascade.updated) {
+			slice_near = slice_far;
+			continue;
+		}
+
+		// corners of the camera frustum slice, through the ndc depth of its planes
+		glm::vec3 corners[8];
+		glm::vec3 center(0.0f);
+		for (u32 plane = 0; plane < 2; plane++) {
+			const auto depth = plane == 0 ? slice_near : slice_far;
+			const auto clip = camera_projection * glm::vec4(0.0f, 0.0f, -depth, 1.0f);
+			const auto ndc_z = clip.z / clip.w;
+			for (u32 corner = 0; corner < 4; corner++) {
+				const auto world = inverse_camera * glm::vec4(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, ndc_z, 1.0f);
+				corners[plane * 4 + corner] = glm::vec3(world) / world.w;
+				center += corners[plane * 4 + corner] / 8.0f;
+			}
+		}
+
+		// a sphere keeps the same size however the camera turns
+		f32 radius = 0.0f;
+		for (const auto& corner : corners)
+			radius = glm::max(radius, glm::length(corner - center));
+		radius = glm::ceil(radius * 16.0f) / 16.0f;
+
+		// move the volume in whole texels so the shadow does not shimmer as the camera moves.
+		// a cached volume is larger than the sphere and moves in steps of many texels, any
+		// position of the step grid still contains the sphere
+		const auto center_ls = glm::vec3(light_view * glm::vec4(center, 1.0f));
+		const auto size = 2.0f * radius * (m_cache_static ? CACHE_MARGIN : 1.0f);
+		const auto texel = size / m_resolution;
+		const auto step = m_cache_static ? glm::max(glm::floor((size * 0.5f - radius) / texel), 1.0f) * texel : texel;
+		const auto origin = glm::floor((glm::vec2(center_ls.x, center_ls.y) - size * 0.5f) / step) * step;
+
+		// receivers end at the back of the sphere, casters start at the scene edge facing the light
+		const auto z_far = -(center_ls.z - radius);
+		const auto z_near = glm::min(scene_ls.is_empty() ? -(center_ls.z + radius) : -scene_ls.max.z, z_far - 0.01f);
+
+		const auto light_projection = glm::ortho(origin.x, origin.x + size, origin.y, origin.y + size, z_near, z_far);
+		cascade.light_space = light_projection * light_view;
+		cascade.split = slice_far;
+		if (cascade.light_space != cascade.static_light_space)
+			cascade.static_dirty = true;
+		slice_near = slice_far;
+	}
+}
+
+void ShadowMapPass::render_moments(const std::function<void()>& draw_quad) {
+	// moments are written as they are, blending would scale them by their last component
+	auto state = GlState::get();
+	state->disable(GL_BLEND);
+	m_moments_framebuffer->bind();
+	const auto tile = (i32)(m_resolution / MOMENTS_DOWNSAMPLE);
+	glViewport(0, 0, tile, tile);
+
+	const auto horizontal = glm::ivec2(1, 0);
+	const auto vertical = glm::ivec2(0, 1);
+	for (u32 i = 0; i < CASCADES; i++) {
+		auto& cascade = m_cascades[i];
+		if (!cascade.moments_dirty)
+			continue;
+
+		// depth tile to moments in the layer
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_moments->get_resource_id(), 0, i);
+		m_moments_shader->bind();
+		m_moments_shader->set_int("downsample", MOMENTS_DOWNSAMPLE);
+		const auto origin = glm::ivec2((i % ATLAS_COLUMNS) * m_resolution, (i / ATLAS_COLUMNS) * m_resolution);
+		m_moments_shader->set_ivec2("tile_origin", glm::value_ptr(origin));
+		m_shadow_texture->bind(0);
+		draw_quad();
+
+		// layer to scratch and back, one blur direction each
+		m_blur_shader->bind();
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_moments_scratch->get_resource_id(), 0);
+		m_blur_shader->set_ivec2("direction", glm::value_ptr(horizontal));
+		state->bind_texture(0, GL_TEXTURE_2D, m_moments_views[i]);
+		draw_quad();
+
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_moments->get_resource_id(), 0, i);
+		m_blur_shader->set_ivec2("direction", glm::value_ptr(vertical));
+		m_moments_scratch->bind(0);
+		draw_quad();
+
+		// only this layer's mips
+		state->bind_texture(0, GL_TEXTURE_2D, m_moments_views[i]);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		cascade.moments_dirty = false;
+	}
+
+	// leave the scratch attached, as the framebuffer was created
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_moments_scratch->get_resource_id(), 0);
+	state->bind_texture(0, GL_TEXTURE_2D, 0);
+	m_blur_shader->unbind();
+	m_moments_framebuffer->unbind();
+	state->enable(GL_BLEND);
+}
+
+void ShadowMapPass::bind_moments(ShaderProgram& shader) {
+	shader.set_bool("filtered_shadows", m_filtered);
+	shader.set_float("light_bleeding", m_light_bleeding);
+	m_moments->bind();
+}
+
+glm::mat4 ShadowMapPass::get_light_view() const {
+	// its orientation never depends on the camera
+	const auto direction = glm::normalize(light_position);
+	const auto up = glm::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	return glm::lookAt(glm::vec3(0.0f), -direction, up);
+}
+
+Frustum ShadowMapPass::get_frustum(u32 cascade) const {
+	auto frustum = Frustum::from_matrix(m_cascades[cascade].light_space);
+
+	// casters between the light and the near plane still throw shadows into the volume
+	frustum.planes[Frustum::NEAR_PLANE] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+	// a plane every box is behind of
+	const auto& state = m_cascades[cascade];
+	if (!state.updated || (m_cache_static && !state.static_dirty))
+		frustum.planes[Frustum::NEAR_PLANE] = glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+	return frustum;
+}
 
-	glm::mat4 light_space = proj * view;
-	return light_space;
+Frustum ShadowMapPass::get_dynamic_frustum(u32 cascade) const {
+	auto frustum = Frustum::from_matrix(m_cascades[cascade].light_space);
+	frustum.planes[Frustum::NEAR_PLANE] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	if (!m_cascades[cascade].updated || !m_cache_static)
+		frustum.planes[Frustum::NEAR_PLANE] = glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+	return frustum;
 }
 
 void ShadowMapPass::render_debug_menu() {
 	ImGui::Begin("ShadowMapPass");
-	ImGui::DragFloat("bounds", &bounds, 0.01f);
-	ImGui::DragFloat("distance", &m_distance, 0.01f);
 	ImGui::DragFloat3("position", glm::value_ptr(light_position), 0.01f);
-	ImGui::DragFloat("near", &near_plane, 0.01f);
-	ImGui::DragFloat("far", &far_plane, 0.01f);
+	ImGui::SliderFloat("split lambda", &m_split_lambda, 0.0f, 1.0f);
+	ImGui::DragFloat("distance", &m_shadow_distance, 0.1f, 1.0f, 1000.0f);
+	ImGui::Checkbox("staggered far cascades", &m_staggered);
+	ImGui::Checkbox("cache static casters", &m_cache_static_next);
+	ImGui::Checkbox("filtered (evsm)", &m_filtered_next);
+	ImGui::SliderFloat("light bleeding reduction", &m_light_bleeding, 0.0f, 0.9f);
+	for (u32 i = 0; i < CASCADES; i++) {
+		const auto& cascade = m_cascades[i];
+		ImGui::Text("cascade %u: until %.2f, %s%s", i, cascade.split, cascade.updated ? "rendered" : "kept",
+			m_cache_static && cascade.holds_static ? ", static only" : "");
+	}
+
+	static const u32 resolutions[] = { 512, 1024, 2048, 4096 };
+	if (ImGui::BeginCombo("resolution", std::to_string(m_resolution_next).c_str())) {
+		for (const auto resolution : resolutions) {
+			if (ImGui::Selectable(std::to_string(resolution).c_str(), resolution == m_resolution_next))
+				set_resolution(resolution);
+		}
+		ImGui::EndCombo();
+	}
 
 	utils::imgui_render_hoverable_image(m_shadow_texture, ImVec2(400.0f, 400.0f));
+
+	ImGui::Separator();
+	m_virtual.render_debug_menu();
 	ImGui::End();
 }
@@ -1,18 +1,29 @@
 #pragma once
 
+#include <array>
 #include "resources/framebuffer.hpp"
 #include "resources/shader_program.hpp"
+#include "resources/texture_array.hpp"
+#include "frame_graph.hpp"
+#include "command_buffer.hpp"
+#include "virtual_shadow_map.hpp"
+#include "local_shadows.hpp"
+#include <scene/bounds.hpp>
 
-class Model;
 class IBL;
+class LightClusters;
+class CommandBuffer;
+struct InstanceBatch;
 
 class RenderPass {
 public:
 	virtual void start();
 	virtual void stop();
-	virtual void render(const std::shared_ptr<Model>& model, const glm::mat4& transform);
+	// records the draw of `view`'s instances of the batch, replayed later by the render queue
+	virtual void record(CommandBuffer& commands, u8 layer, const InstanceBatch& batch, u32 view) const;
 
 	void set_shader(std::shared_ptr<ShaderProgram> shader);
+	// passes scheduled by the frame graph have no framebuffer, the graph binds their targets
 	void set_framebuffer(std::shared_ptr<Framebuffer> framebuffer);
 
 	void addDependencyBindable(std::shared_ptr<Bindable> bindable);
@@ -24,48 +35,192 @@ public:
 	std::shared_ptr<Framebuffer> m_framebuffer;
 };
 
+// targets written by the geometry pass, transient in the frame graph. 20 bytes per pixel
+// with depth: srgb albedo, octahedral normals, mra, r11g11b10 emissive, and world
+// position is reconstructed from depth instead of stored
+struct GBufferTargets {
+	FrameResource albedo;
+	FrameResource normals;
+	FrameResource mra;
+	FrameResource emissive;
+	FrameResource depth;
+};
+
 class GBuffer : public RenderPass {
 public:
-	GBuffer(FramebufferSpecification spec);
+	GBuffer(std::shared_ptr<ShaderProgram> shader);
 
-	std::shared_ptr<Texture> get_albedo();
-	std::shared_ptr<Texture> get_normals();
-	std::shared_ptr<Texture> get_mra();
-	std::shared_ptr<Texture> get_emissive();
-	std::shared_ptr<Texture> get_world();
+	void start() override;
+	void stop() override;
 
-	void bind_textures();
+	// creates the targets of a width x height frame, written and cleared by the pass being set up
+	GBufferTargets declare(FrameGraph::Builder& builder, u32 width, u32 height) const;
+	// declares every target as read by the pass being set up
+	static void read(FrameGraph::Builder& builder, const GBufferTargets& targets);
+	// binds them to the units deferred_lighting.frag samples them from
+	static void bind_textures(const FrameGraph::Context& context, const GBufferTargets& targets);
 };
 
+//
+// Sun shadows as SHADOW_CASCADES cascades in one 2 x 2 atlas. The camera frustum is split
+// with the practical split scheme (a blend of logarithmic and uniform splits), every slice
+// gets a light volume around its bounding sphere whose size does not change as the camera
+// turns and whose origin snaps to whole texels, so the shadow edges stay still.
+// Far cascades can be refreshed every few frames, they keep the matrices they were
+// rendered with until then.
+//
+// With static caching, casters that are not moving are rendered into a second atlas
+// only when their cascade volume, the light or the set of static casters changes.
+// Cascade volumes then move in coarse steps around a larger sphere so they stay put
+// while the camera moves a little. Each frame a cascade with moving casters copies
+// its cached tile and draws only those on top. Without moving casters the tile is
+// left alone.
+//
+// With filtering, every tile whose depth changed is turned into exponential variance
+// moments at 1 / MOMENTS_DOWNSAMPLE of the resolution in its own layer of an array,
+// blurred with a separable gaussian and mipmapped. The lighting pass then takes one
+// trilinear fetch per pixel instead of comparing against the raw depth.
+//
 class ShadowMapPass : public RenderPass {
 public:
-	ShadowMapPass(FramebufferSpecification spec, std::shared_ptr<ShaderProgram> shader);
-
+	static const u32 CASCADES = SHADOW_CASCADES;
+	static const u32 ATLAS_COLUMNS = 2;
+	// per cascade
+	static const u32 DEFAULT_RESOLUTION = 2048;
+	static const u32 MOMENTS_DOWNSAMPLE = 2;
+
+	// `mark_shader` flags the pages of the virtual shadow map, see VirtualShadowMap.
+	// `moments_shader` and `blur_shader` build the filtered moments
+	ShadowMapPass(std::shared_ptr<ShaderProgram> shader, std::shared_ptr<ShaderProgram> mark_shader,
+		std::shared_ptr<ShaderProgram> moments_shader, std::shared_ptr<ShaderProgram> blur_shader);
+	~ShadowMapPass();
+
+	// cascades of resolution², the atlases are recreated by the next update()
+	void set_resolution(u32 resolution) { m_resolution_next = resolution; }
 	void set_light_position(const glm::vec3& pos);
 	void start() override;
 	void stop() override;
 
+	// splits the camera frustum, fits a light volume to every slice and schedules the cascades
+	// rendered this frame. casters are taken from the scene bounds between the light and the slice,
+	// `static_revision` is TransformHierarchy::get_static_revision()
+	void update(const glm::mat4& camera_view, const glm::mat4& camera_projection, f32 camera_near, f32 camera_far, const AABB& scene_bounds, u64 static_revision);
+
+	// clears the cached tile of the cascade, draw its LAYER_SHADOW casters after this
+	void begin_static_cascade(u32 cascade);
+	// prepares the tile of the cascade: cleared for all casters, or the cached static depth for
+	// the moving ones. false when nothing has to be drawn, otherwise draw get_caster_layer()
+	bool begin_cascade(u32 cascade, u64 dynamic_instances);
+	u8 get_caster_layer(u32 cascade) const { return (u8)((m_cache_static ? LAYER_SHADOW_DYNAMIC : LAYER_SHADOW) + cascade); }
+
+	bool is_cascade_updated(u32 cascade) const { return m_cascades[cascade].updated; }
+	bool is_static_cache_dirty(u32 cascade) const { return m_cascades[cascade].static_dirty; }
+	bool is_caching_static() const { return m_cache_static; }
+
+	bool is_filtered() const { return m_filtered; }
+	bool is_moments_dirty(u32 cascade) const { return m_cascades[cascade].moments_dirty; }
+	// builds, blurs and mipmaps the moments of the changed tiles with its own framebuffer,
+	// `draw_quad` draws a screen quad. run it after the depth tiles and before lighting
+	void render_moments(const std::function<void()>& draw_quad);
+	// binds the moments and sets the filtering uniforms of `shader`
+	void bind_moments(ShaderProgram& shader);
+
+	// world to light view, the light looks down -z
+	glm::mat4 get_light_view() const;
+	VirtualShadowMap& get_virtual() { return m_virtual; }
+	// prepares the `index`th page the virtual shadow map renders this frame
+	void begin_virtual_page(u32 index) { m_virtual.begin_page(index, *m_shader); }
+	// shadows of point and spot lights, drawn with the same shader as the cascades
+	LocalShadowAtlas& get_local() { return m_local; }
+
 	std::shared_ptr<Texture> get_depth_texture();
-	glm::mat4 get_light_space();
+	std::shared_ptr<Texture> get_static_texture() { return m_static_texture; }
+	// world to light clip space of the cascade, as it was last rendered
+	glm::mat4 get_light_space(u32 cascade) const { return m_cascades[cascade].light_space; }
+	// view depth at which the cascade ends
+	f32 get_split(u32 cascade) const { return m_cascades[cascade].split; }
+	// light frustum used to cull the cascade casters (the static ones when caching), unbounded
+	// toward the light. rejects everything when none of them has to be drawn this frame
+	Frustum get_frustum(u32 cascade) const;
+	// same for the moving casters, only used when caching
+	Frustum get_dynamic_frustum(u32 cascade) const;
 
 	void render_debug_menu();
 private:
-	float near_plane = 0.010f;
-	float far_plane = 25.0f;
-	float bounds = 13.0f;
-	float m_distance = 6.0f;
-	
+	struct Cascade {
+		glm::mat4 light_space = glm::mat4(1.0f);
+		f32 split = 0.0f;
+		bool updated = false;
+
+		// the cached static tile was rendered with this matrix
+		glm::mat4 static_light_space = glm::mat4(0.0f);
+		bool static_dirty = true;
+		// the shadow tile is an unmodified copy of the cached one
+		bool holds_static = false;
+		// the depth tile changed since its moments were built
+		bool moments_dirty = true;
+	};
+
+	// cascade volumes are this much larger than their slice sphere when caching
+	static constexpr f32 CACHE_MARGIN = 1.25f;
+
+	// 0 splits uniformly, 1 logarithmically
+	f32 m_split_lambda = 0.75f;
+	// shadows end here or at the camera far plane, whichever is closer
+	f32 m_shadow_distance = 50.0f;
+	// far cascades are rendered every `interval` frames
+	bool m_staggered = true;
+	u32 m_intervals[CASCADES] = { 1, 1, 2, 4 };
+
+	std::array<Cascade, CASCADES> m_cascades;
+	u64 m_frame = 0;
+	// everything is rendered again when these change
+	bool m_invalidated = true;
+	glm::vec3 m_rendered_light_position = glm::vec3(0.0f);
+	u64 m_static_revision = 0;
+	bool m_cache_static = true;
+	// the debug menu runs after the casters were recorded, the switch waits for the next update()
+	bool m_cache_static_next = true;
+	bool m_filtered = true;
+	bool m_filtered_next = true;
+	// visibility cut off against light bleeding, 0 keeps the plain chebyshev bound
+	f32 m_light_bleeding = 0.2f;
+
 	glm::vec3 light_position = glm::vec3(1.0f);
+	u32 m_resolution = 0;
+	u32 m_resolution_next = DEFAULT_RESOLUTION;
 	std::shared_ptr<Texture> m_shadow_texture;
+	std::shared_ptr<Texture> m_static_texture;
+	// 4 x 32 bit float moments, one layer per cascade
+	std::shared_ptr<TextureArray> m_moments;
+	// 2D views of the layers, so each one is mipmapped on its own
+	std::array<u32, CASCADES> m_moments_views{};
+	// one tile, holds the horizontal blur
+	std::shared_ptr<Texture> m_moments_scratch;
+	std::shared_ptr<Framebuffer> m_moments_framebuffer;
+	std::shared_ptr<ShaderProgram> m_moments_shader;
+	std::shared_ptr<ShaderProgram> m_blur_shader;
+	VirtualShadowMap m_virtual;
+	LocalShadowAtlas m_local;
+
+	std::shared_ptr<Texture> create_atlas(u32 resolution);
+	// recreates the atlases and renders every cascade again
+	void apply_resolution(u32 resolution);
+	void delete_moments_views();
 };
 
 
 class LightingPass : public RenderPass {
 public:
-	LightingPass(FramebufferSpecification spec, std::shared_ptr<ShaderProgram> shader, std::vector<std::shared_ptr<Bindable>> gbuffer_textures, std::shared_ptr<IBL> ibl, ShadowMapPass* shadow_pass);
+	// point and spot lights come from `clusters`, only the sun is evaluated for every pixel
+	LightingPass(std::shared_ptr<ShaderProgram> shader, std::shared_ptr<IBL> ibl, ShadowMapPass* shadow_pass, LightClusters* clusters);
 
 	void start() override;
+	// camera the gbuffer was rendered from, world positions are rebuilt from its depth
+	void set_view_projection(const glm::mat4& view_projection);
 private:
 	std::shared_ptr<IBL> m_ibl;
+	glm::mat4 m_inverse_view_projection = glm::mat4(1.0f);
 	ShadowMapPass* m_shadow_pass;
+	LightClusters* m_clusters;
 };
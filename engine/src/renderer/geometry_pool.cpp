@@ -0,0 +1,105 @@
+#include "geometry_pool.hpp"
+
+#include <cstddef>
+#include <algorithm>
+#include "resources/gl_state.hpp"
+
+static const u32 INITIAL_VERTICES = 1 << 16;
+static const u32 INITIAL_INDICES = 1 << 18;
+static const u32 INITIAL_INSTANCES = 1024;
+
+static std::shared_ptr<GlBuffer> create_buffer(GLenum type, u32 element_size, u32 count, GLenum usage)
+{
+	BufferSpecification spec{};
+	spec.type = type;
+	spec.element_size = element_size;
+	spec.count = count;
+	spec.data = nullptr;
+	spec.usage = usage;
+	return GlBuffer::create(spec);
+}
+
+GeometryPool::GeometryPool(std::shared_ptr<VertexLayout> layout)
+	: m_layout(std::move(layout))
+{
+	// index buffer writes would land in whatever vao is bound
+	GlState::get()->bind_vertex_array(0);
+
+	m_vertices = create_buffer(GL_ARRAY_BUFFER, m_layout->get_size(), INITIAL_VERTICES, GL_STATIC_DRAW);
+	m_indices = create_buffer(GL_ELEMENT_ARRAY_BUFFER, sizeof(u32), INITIAL_INDICES, GL_STATIC_DRAW);
+	// never empty, non instanced draws still fetch the attribute of instance 0
+	m_instances = create_buffer(GL_ARRAY_BUFFER, sizeof(InstanceData), INITIAL_INSTANCES, GL_DYNAMIC_DRAW);
+	create_vao();
+}
+
+GeometryRange GeometryPool::allocate(const void* vertices, u32 vertex_count, const u32* indices, u32 index_count)
+{
+	GlState::get()->bind_vertex_array(0);
+	reserve(m_vertex_count + vertex_count, m_index_count + index_count);
+
+	GeometryRange range;
+	range.base_vertex = m_vertex_count;
+	range.vertex_count = vertex_count;
+	range.first_index = m_index_count;
+	range.index_count = index_count;
+
+	m_vertices->update(vertices, vertex_count, m_vertex_count);
+	m_indices->update(indices, index_count, m_index_count);
+	m_vertex_count += vertex_count;
+	m_index_count += index_count;
+
+	return range;
+}
+
+void GeometryPool::upload_instances(const std::vector<InstanceData>& instances)
+{
+	if (instances.empty())
+		return;
+
+	if (instances.size() > m_instances->get_count()) {
+		const auto capacity = std::max((u32)instances.size(), m_instances->get_count() * 2);
+		m_instances = create_buffer(GL_ARRAY_BUFFER, sizeof(InstanceData), capacity, GL_DYNAMIC_DRAW);
+		attach_instances();
+	}
+
+	m_instances->update(instances.data(), (u32)instances.size());
+}
+
+void GeometryPool::reserve(u32 vertices, u32 indices)
+{
+	bool grown = false;
+
+	if (vertices > m_vertices->get_count()) {
+		auto buffer = create_buffer(GL_ARRAY_BUFFER, m_layout->get_size(), std::max(vertices, m_vertices->get_count() * 2), GL_STATIC_DRAW);
+		buffer->copy_from(*m_vertices, m_vertex_count);
+		m_vertices = buffer;
+		grown = true;
+	}
+
+	if (indices > m_indices->get_count()) {
+		auto buffer = create_buffer(GL_ELEMENT_ARRAY_BUFFER, sizeof(u32), std::max(indices, m_indices->get_count() * 2), GL_STATIC_DRAW);
+		buffer->copy_from(*m_indices, m_index_count);
+		m_indices = buffer;
+		grown = true;
+	}
+
+	// the vao points at the old buffers
+	if (grown)
+		create_vao();
+}
+
+void GeometryPool::create_vao()
+{
+	VertexArraySpecification spec{};
+	spec.layout = m_layout;
+	spec.vertex_buffer = m_vertices;
+	spec.index_buffer = m_indices;
+	m_vao = VertexArray::create(spec);
+	attach_instances();
+}
+
+void GeometryPool::attach_instances()
+{
+	m_vao->set_instance_buffer(m_instances, INSTANCE_LOCATION);
+	m_vao->set_instance_uint(m_instances, MATERIAL_LOCATION, offsetof(InstanceData, material));
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <glm/glm/glm.hpp>
+
+#include <defines.hpp>
+#include "resources/buffer.hpp"
+#include "resources/vertex_array.hpp"
+#include "resources/vertex_layout.hpp"
+
+// where a mesh lives inside the pool buffers
+struct GeometryRange {
+	u32 base_vertex = 0;
+	u32 vertex_count = 0;
+	u32 first_index = 0;
+	u32 index_count = 0;
+};
+
+// per-instance attributes, the material indexes MaterialTable's material buffer
+struct InstanceData {
+	glm::mat4 model;
+	u32 material;
+	u32 padding[3];
+};
+
+//
+// Shared vertex and index buffers for every mesh of one vertex format. Meshes are
+// appended and keep their range, so any set of them can be drawn with a single vao
+// and one glMultiDrawElementsIndirect. Per-instance model matrices and material
+// indices live in one instance buffer, each draw reads its own part through its base instance.
+//
+class GeometryPool {
+public:
+	// location of the per-instance mat4 attribute, occupies 4 locations
+	static const u32 INSTANCE_LOCATION = 5;
+	// location of the per-instance material index
+	static const u32 MATERIAL_LOCATION = 9;
+
+	static std::unique_ptr<GeometryPool> create(std::shared_ptr<VertexLayout> layout) {
+		return std::make_unique<GeometryPool>(std::move(layout));
+	}
+
+	GeometryPool(std::shared_ptr<VertexLayout> layout);
+
+	// `vertices` must match the pool layout, indices are relative to the mesh's first vertex
+	GeometryRange allocate(const void* vertices, u32 vertex_count, const u32* indices, u32 index_count);
+	void upload_instances(const std::vector<InstanceData>& instances);
+
+	VertexArray* get_vao() const { return m_vao.get(); }
+	u32 get_vertex_count() const { return m_vertex_count; }
+	u32 get_index_count() const { return m_index_count; }
+
+private:
+	std::shared_ptr<VertexLayout> m_layout;
+
+	std::shared_ptr<GlBuffer> m_vertices;
+	std::shared_ptr<GlBuffer> m_indices;
+	std::shared_ptr<GlBuffer> m_instances;
+	std::shared_ptr<VertexArray> m_vao;
+
+	u32 m_vertex_count = 0;
+	u32 m_index_count = 0;
+
+	// grows geometrically by copying into a larger buffer
+	void reserve(u32 vertices, u32 indices);
+	void create_vao();
+	void attach_instances();
+};
@@ -2,6 +2,7 @@
 #include <glm/ext/matrix_transform.hpp>
 #include <engine.hpp>
 #include "geometry.hpp"
+#include "resources/gl_state.hpp"
 
 IBL::IBL(const std::filesystem::path& hdr_path)
 {
@@ -31,15 +32,16 @@ std::shared_ptr<Texture> IBL::get_brdf() const {
 
 void IBL::reload_ibl(const std::string& hdr_name)
 {
-	glDisable(GL_CULL_FACE);
-	glDisable(GL_DEPTH_TEST);
+	auto state = GlState::get();
+	state->disable(GL_CULL_FACE);
+	state->disable(GL_DEPTH_TEST);
 
-	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+	state->enable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 	_initialize_ibl(hdr_name);
 	_initialize_specular_ibl();
 
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+	state->enable(GL_DEPTH_TEST);
+	state->enable(GL_CULL_FACE);
 }
 
 void IBL::_initialize_ibl(const std::string& hdr_name)
@@ -0,0 +1,145 @@
+#include "instancing.hpp"
+
+#include "mesh.hpp"
+#include "geometry_pool.hpp"
+#include <scene/scene.hpp>
+#include <jobs.hpp>
+
+void InstanceBatcher::begin()
+{
+	for (auto& batch : m_batches) {
+		for (auto& transforms : batch.transforms)
+			transforms.clear();
+	}
+
+	m_stats = {};
+}
+
+void InstanceBatcher::gather(Scene& scene, const std::array<Frustum, VIEW_COUNT>& frustums, OcclusionCuller* occlusion)
+{
+	const auto& transforms = scene.get_transforms();
+	auto& world = scene.get_world();
+	const auto total = world.count<Transform, MeshRenderer, Bounds>();
+
+	// views only read the scene and write their own candidate list, so they are culled as jobs
+	JobSystem::get()->parallel_for(VIEW_COUNT, 1, [&](u32 begin, u32 end) {
+		for (u32 view = begin; view < end; view++) {
+			cull_view(scene, view, frustums[view], view == VIEW_CAMERA ? occlusion : nullptr);
+			m_stats[view].tested = total;
+		}
+	});
+
+	for (u32 view = 0; view < VIEW_COUNT; view++) {
+		for (const auto& candidate : m_views[view].candidates) {
+			add(view, candidate.mesh, transforms.get_world(candidate.transform));
+		}
+	}
+}
+
+void InstanceBatcher::cull_view(Scene& scene, u32 view, const Frustum& frustum, OcclusionCuller* occlusion)
+{
+	const auto& transforms = scene.get_transforms();
+	auto& world = scene.get_world();
+	auto& state = m_views[view];
+	state.candidates.clear();
+
+	// the bvh rejects and accepts whole subtrees, boxes in leaves straddling a plane
+	// are collected and tested together with the simd path
+	state.culling_input.clear();
+	scene.get_bvh().query(frustum, [&](u32 index, bool inside) {
+		// the camera cell's pvs rejects before any per entity work
+		if (view == VIEW_CAMERA && !scene.is_potentially_visible(index))
+			return;
+
+		const auto entity = world.get_entity(index);
+		const auto transform = world.get<Transform>(entity);
+
+		// shadow views come first
+		if (m_split_static_casters && view <= VIEW_SHADOW_DYNAMIC_LAST) {
+			const auto is_static = transforms.is_static(transform->node);
+			if (is_static != (view <= VIEW_SHADOW_LAST))
+				return;
+		}
+		const auto renderer = world.get<MeshRenderer>(entity);
+		const auto& bounds = world.get<Bounds>(entity)->world;
+
+		if (inside)
+			state.candidates.push_back({ renderer->mesh, transform->node, bounds });
+		else
+			state.culling_input.add(bounds, renderer->mesh, transform->node);
+	});
+	state.culling_input.finalize();
+
+	state.visible.clear();
+	cull_frustum(frustum, state.culling_input, state.visible);
+	for (const auto index : state.visible) {
+		const auto& input = state.culling_input;
+		const auto center = glm::vec3(input.center_x[index], input.center_y[index], input.center_z[index]);
+		const auto extents = glm::vec3(input.extent_x[index], input.extent_y[index], input.extent_z[index]);
+		state.candidates.push_back({ input.meshes[index], input.transforms[index], { center - extents, center + extents } });
+	}
+
+	u32 occluded = 0;
+	if (occlusion) {
+		// occluders come from what survived the frustum, the culler keeps the largest on screen
+		for (const auto& candidate : state.candidates) {
+			occlusion->add_occluder(candidate.mesh->get_occluder(), transforms.get_world(candidate.transform), candidate.bounds);
+		}
+		occlusion->rasterize();
+
+		// a mesh always passes its own depth test since the nearest point of its box is in front of it
+		std::erase_if(state.candidates, [&](const Candidate& candidate) {
+			return !occlusion->is_visible(candidate.bounds);
+		});
+		occluded = occlusion->get_stats().occluded;
+	}
+
+	m_stats[view].visible = (u32)state.candidates.size();
+	m_stats[view].occluded = occluded;
+}
+
+void InstanceBatcher::add(u32 view, Mesh* mesh, const glm::mat4& transform)
+{
+	auto it = m_lookup.find(mesh);
+	if (it == m_lookup.end()) {
+		it = m_lookup.emplace(mesh, (u32)m_batches.size()).first;
+		m_batches.push_back({ mesh, {}, {} });
+	}
+
+	m_batches[it->second].transforms[view].push_back(transform);
+}
+
+void InstanceBatcher::upload(GeometryPool& pool)
+{
+	m_upload.clear();
+	for (auto& batch : m_batches) {
+		const auto material = batch.mesh->get_material()->material_index;
+		for (u32 view = 0; view < VIEW_COUNT; view++) {
+			batch.first[view] = (u32)m_upload.size();
+			for (const auto& transform : batch.transforms[view])
+				m_upload.push_back({ transform, material, {} });
+		}
+	}
+
+	pool.upload_instances(m_upload);
+}
+
+const std::vector<InstanceBatch>& InstanceBatcher::get_batches() const
+{
+	return m_batches;
+}
+
+u64 InstanceBatcher::get_instance_count(u32 view) const
+{
+	u64 count = 0;
+	for (const auto& batch : m_batches) {
+		count += batch.transforms[view].size();
+	}
+
+	return count;
+}
+
+const CullingStats& InstanceBatcher::get_culling_stats(u32 view) const
+{
+	return m_stats[view];
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <glm/glm/glm.hpp>
+
+#include <defines.hpp>
+#include <scene/bounds.hpp>
+#include "culling.hpp"
+#include "occlusion.hpp"
+#include "geometry_pool.hpp"
+#include "command_buffer.hpp"
+
+class Mesh;
+class Scene;
+
+// every pass that draws a culled subset of the scene gets its own visible list
+enum RenderView : u32 {
+	// one view per shadow cascade, VIEW_SHADOW + cascade. split by set_split_static_casters()
+	VIEW_SHADOW = 0,
+	VIEW_SHADOW_LAST = VIEW_SHADOW + SHADOW_CASCADES - 1,
+	VIEW_SHADOW_DYNAMIC,
+	VIEW_SHADOW_DYNAMIC_LAST = VIEW_SHADOW_DYNAMIC + SHADOW_CASCADES - 1,
+	// pages of the virtual shadow map rendered this frame, every caster
+	VIEW_SHADOW_VIRTUAL,
+	// ranges of the point and spot lights whose shadows are rendered this frame
+	VIEW_SHADOW_LOCAL,
+	VIEW_CAMERA,
+	VIEW_COUNT
+};
+
+// every instance of one mesh drawn this frame (same mesh implies same material)
+struct InstanceBatch {
+	Mesh* mesh;
+	std::array<std::vector<glm::mat4>, VIEW_COUNT> transforms;
+
+	// offset of each view's transforms in the pool instance buffer, set by upload()
+	std::array<u32, VIEW_COUNT> first;
+};
+
+//
+// Gathers mesh instances once per frame so each pass can draw them with a single
+// instanced draw per mesh instead of one draw per copy. Instances are frustum culled
+// per view, every batch and view is a range of the geometry pool's instance buffer.
+//
+class InstanceBatcher {
+public:
+	// forget last frame's instances, batch storage is kept to avoid reallocations
+	void begin();
+
+	// culls every entity with a MeshRenderer, Transform and Bounds against each view frustum
+	// through the scene bvh. when given, camera visible meshes are also tested against `occlusion`,
+	// which must have been begun with the camera view projection.
+	void gather(Scene& scene, const std::array<Frustum, VIEW_COUNT>& frustums, OcclusionCuller* occlusion = nullptr);
+	void add(u32 view, Mesh* mesh, const glm::mat4& transform);
+
+	// when set, the shadow views only keep static casters and the dynamic shadow views the
+	// moving ones (see TransformHierarchy::is_static), otherwise the shadow views keep both
+	void set_split_static_casters(bool split) { m_split_static_casters = split; }
+
+	// writes every batch to the instance buffer of the pool its meshes live in
+	void upload(GeometryPool& pool);
+
+	const std::vector<InstanceBatch>& get_batches() const;
+	u64 get_instance_count(u32 view) const;
+	const CullingStats& get_culling_stats(u32 view) const;
+
+private:
+	std::unordered_map<const Mesh*, u32> m_lookup;
+	std::vector<InstanceBatch> m_batches;
+
+	struct Candidate {
+		Mesh* mesh;
+		TransformHandle transform;
+		AABB bounds;
+	};
+
+	// scratch of one view, views are culled concurrently
+	struct ViewState {
+		CullingInput culling_input;
+		std::vector<u32> visible;
+		std::vector<Candidate> candidates;
+	};
+
+	std::array<ViewState, VIEW_COUNT> m_views;
+	std::array<CullingStats, VIEW_COUNT> m_stats;
+	std::vector<InstanceData> m_upload;
+	bool m_split_static_casters = false;
+
+	void cull_view(Scene& scene, u32 view, const Frustum& frustum, OcclusionCuller* occlusion);
+};
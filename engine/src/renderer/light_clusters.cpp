@@ -0,0 +1,216 @@
+#include "light_clusters.hpp"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "resources/gl_state.hpp"
+
+// grows `buffer` to hold at least `count` elements, contents are rewritten every frame
+static void reserve(std::shared_ptr<GlBuffer>& buffer, u32 element_size, u32 count)
+{
+	if (buffer && buffer->get_count() >= count)
+		return;
+
+	BufferSpecification spec{};
+	spec.type = GL_SHADER_STORAGE_BUFFER;
+	spec.element_size = element_size;
+	spec.count = std::max(count, buffer ? buffer->get_count() * 2 : 64u);
+	spec.data = nullptr;
+	spec.usage = GL_DYNAMIC_DRAW;
+	buffer = GlBuffer::create(spec);
+}
+
+static bool overlaps(const glm::vec3& center, f32 radius, const glm::vec3& min, const glm::vec3& max)
+{
+	const auto closest = glm::clamp(center, min, max);
+	const auto offset = closest - center;
+	return glm::dot(offset, offset) <= radius * radius;
+}
+
+LightClusters::LightClusters()
+	: m_bounds(CLUSTER_COUNT), m_grid(CLUSTER_COUNT), m_upload_grid(CLUSTER_COUNT), m_slice_indices(GRID_Z)
+{
+}
+
+LightClusters::~LightClusters()
+{
+	// slice jobs write into this object
+	if (m_pending)
+		JobSystem::get()->wait(m_counter);
+}
+
+void LightClusters::set_camera(const glm::mat4& view, const glm::mat4& projection, f32 near_plane, f32 far_plane)
+{
+	// the slice jobs of the last assign() read the projection and the cluster boxes
+	if (m_pending)
+		JobSystem::get()->wait(m_counter);
+
+	m_view = view;
+	if (projection == m_projection && near_plane == m_near && far_plane == m_far)
+		return;
+
+	m_projection = projection;
+	m_near = near_plane;
+	m_far = far_plane;
+	build_bounds();
+}
+
+f32 LightClusters::get_slice_depth(u32 slice) const
+{
+	return m_near * std::pow(m_far / m_near, (f32)slice / GRID_Z);
+}
+
+void LightClusters::build_bounds()
+{
+	const auto inverse_projection = glm::inverse(m_projection);
+
+	// tile corners on the near plane, scaled along the eye ray to the slice depths
+	auto unproject = [&](f32 x, f32 y) {
+		const auto point = inverse_projection * glm::vec4(x, y, -1.0f, 1.0f);
+		return glm::vec3(point) / point.w;
+	};
+
+	for (u32 y = 0; y < GRID_Y; y++) {
+		for (u32 x = 0; x < GRID_X; x++) {
+			const auto tile_min = unproject(-1.0f + 2.0f * x / GRID_X, -1.0f + 2.0f * y / GRID_Y);
+			const auto tile_max = unproject(-1.0f + 2.0f * (x + 1) / GRID_X, -1.0f + 2.0f * (y + 1) / GRID_Y);
+
+			for (u32 z = 0; z < GRID_Z; z++) {
+				const f32 depths[] = { get_slice_depth(z), get_slice_depth(z + 1) };
+
+				auto& bounds = m_bounds[x + y * GRID_X + z * GRID_X * GRID_Y];
+				bounds.min = glm::vec3(std::numeric_limits<f32>::max());
+				bounds.max = glm::vec3(-std::numeric_limits<f32>::max());
+				for (const auto depth : depths) {
+					for (const auto& corner : { tile_min, tile_max }) {
+						const auto point = corner * (depth / -corner.z);
+						bounds.min = glm::min(bounds.min, point);
+						bounds.max = glm::max(bounds.max, point);
+					}
+				}
+			}
+		}
+	}
+}
+
+void LightClusters::assign(std::vector<LightData> lights)
+{
+	if (m_pending)
+		JobSystem::get()->wait(m_counter);
+
+	m_lights = std::move(lights);
+	m_view_lights.resize(m_lights.size());
+	for (size_t i = 0; i < m_lights.size(); i++) {
+		const auto& light = m_lights[i];
+		m_view_lights[i].center = glm::vec3(m_view * glm::vec4(glm::vec3(light.position_range), 1.0f));
+		m_view_lights[i].radius = light.position_range.w;
+	}
+
+	m_pending = true;
+	JobSystem::get()->run([this] {
+		JobSystem::get()->parallel_for(GRID_Z, 1, [this](u32 begin, u32 end) {
+			for (u32 slice = begin; slice < end; slice++)
+				assign_slice(slice);
+		});
+	}, &m_counter);
+}
+
+void LightClusters::assign_slice(u32 slice)
+{
+	const auto slice_near = get_slice_depth(slice);
+	const auto slice_far = get_slice_depth(slice + 1);
+	const auto slice_offset = slice * GRID_X * GRID_Y;
+
+	auto& indices = m_slice_indices[slice];
+	indices.clear();
+
+	// collect per tile first, the index lists of a cluster have to be contiguous
+	std::vector<std::vector<u32>> tiles(GRID_X * GRID_Y);
+	for (u32 i = 0; i < (u32)m_view_lights.size(); i++) {
+		const auto& light = m_view_lights[i];
+		const auto depth = -light.center.z;
+		if (depth + light.radius < slice_near || depth - light.radius > slice_far)
+			continue;
+
+		// screen rectangle of the part of the light box inside the slice
+		const f32 depths[] = { std::max(depth - light.radius, slice_near), std::min(depth + light.radius, slice_far) };
+		glm::vec2 ndc_min(1.0f);
+		glm::vec2 ndc_max(-1.0f);
+		for (const auto corner_depth : depths) {
+			for (const auto x : { light.center.x - light.radius, light.center.x + light.radius }) {
+				for (const auto y : { light.center.y - light.radius, light.center.y + light.radius }) {
+					const auto clip = m_projection * glm::vec4(x, y, -corner_depth, 1.0f);
+					const auto ndc = glm::vec2(clip) / clip.w;
+					ndc_min = glm::min(ndc_min, ndc);
+					ndc_max = glm::max(ndc_max, ndc);
+				}
+			}
+		}
+
+		const auto tile_min = glm::clamp(glm::ivec2(glm::floor((ndc_min * 0.5f + 0.5f) * glm::vec2(GRID_X, GRID_Y))), glm::ivec2(0), glm::ivec2(GRID_X - 1, GRID_Y - 1));
+		const auto tile_max = glm::clamp(glm::ivec2(glm::floor((ndc_max * 0.5f + 0.5f) * glm::vec2(GRID_X, GRID_Y))), glm::ivec2(0), glm::ivec2(GRID_X - 1, GRID_Y - 1));
+		for (i32 y = tile_min.y; y <= tile_max.y; y++) {
+			for (i32 x = tile_min.x; x <= tile_max.x; x++) {
+				const auto tile = x + y * GRID_X;
+				const auto& bounds = m_bounds[slice_offset + tile];
+				if (overlaps(light.center, light.radius, bounds.min, bounds.max))
+					tiles[tile].push_back(i);
+			}
+		}
+	}
+
+	for (u32 tile = 0; tile < GRID_X * GRID_Y; tile++) {
+		m_grid[slice_offset + tile] = glm::uvec2((u32)indices.size(), (u32)tiles[tile].size());
+		indices.insert(indices.end(), tiles[tile].begin(), tiles[tile].end());
+	}
+}
+
+void LightClusters::bind(ShaderProgram& shader)
+{
+	if (m_pending) {
+		JobSystem::get()->wait(m_counter);
+		m_pending = false;
+		upload();
+	} else if (!m_grid_buffer) {
+		upload();
+	}
+
+	auto state = GlState::get();
+	state->bind_buffer_range(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING, m_light_buffer->get_id(), 0, m_light_buffer->get_count() * sizeof(LightData));
+	state->bind_buffer_range(GL_SHADER_STORAGE_BUFFER, GRID_BINDING, m_grid_buffer->get_id(), 0, m_grid_buffer->get_count() * sizeof(glm::uvec2));
+	state->bind_buffer_range(GL_SHADER_STORAGE_BUFFER, INDEX_BINDING, m_index_buffer->get_id(), 0, m_index_buffer->get_count() * sizeof(u32));
+
+	// slice = log(depth) * scale + bias, the inverse of get_slice_depth
+	const auto scale = GRID_Z / std::log(m_far / m_near);
+	shader.set_float("cluster_scale", scale);
+	shader.set_float("cluster_bias", -std::log(m_near) * scale);
+}
+
+void LightClusters::upload()
+{
+	m_stats = {};
+	m_stats.lights = (u32)m_lights.size();
+
+	// slice lists were built with local offsets, m_grid keeps them so this can run again
+	m_indices.clear();
+	for (u32 slice = 0; slice < GRID_Z; slice++) {
+		const auto base = (u32)m_indices.size();
+		for (u32 tile = 0; tile < GRID_X * GRID_Y; tile++) {
+			const auto cluster = slice * GRID_X * GRID_Y + tile;
+			m_upload_grid[cluster] = m_grid[cluster] + glm::uvec2(base, 0u);
+			m_stats.max_cluster_lights = std::max(m_stats.max_cluster_lights, m_grid[cluster].y);
+		}
+		m_indices.insert(m_indices.end(), m_slice_indices[slice].begin(), m_slice_indices[slice].end());
+	}
+	m_stats.indices = (u32)m_indices.size();
+
+	reserve(m_light_buffer, sizeof(LightData), (u32)m_lights.size());
+	reserve(m_grid_buffer, sizeof(glm::uvec2), CLUSTER_COUNT);
+	reserve(m_index_buffer, sizeof(u32), (u32)m_indices.size());
+
+	if (!m_lights.empty())
+		m_light_buffer->update(m_lights.data(), (u32)m_lights.size());
+	m_grid_buffer->update(m_upload_grid.data(), CLUSTER_COUNT);
+	if (!m_indices.empty())
+		m_index_buffer->update(m_indices.data(), (u32)m_indices.size());
+}
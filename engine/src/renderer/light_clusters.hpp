@@ -0,0 +1,113 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <glm/glm/glm.hpp>
+
+#include <defines.hpp>
+#include <jobs.hpp>
+#include "resources/buffer.hpp"
+#include "resources/shader_program.hpp"
+
+enum LightType : u32 {
+	LIGHT_POINT = 0,
+	LIGHT_SPOT = 1,
+};
+
+// std430 layout of the Lights buffer in deferred_lighting.frag
+struct LightData {
+	// xyz world position, w range at which the light fades out
+	glm::vec4 position_range = glm::vec4(0.0f);
+	// rgb color times intensity, w LightType
+	glm::vec4 color_type = glm::vec4(0.0f);
+	// xyz direction a spot light points to, w cosine of its outer cone angle
+	glm::vec4 direction_outer = glm::vec4(0.0f, 0.0f, -1.0f, -1.0f);
+	// x cosine of the inner cone angle, y index into the local shadows or -1 (see LocalShadowAtlas)
+	glm::vec4 params = glm::vec4(-1.0f);
+};
+
+struct LightClusterStats {
+	u32 lights = 0;
+	// light indices over all clusters, the shading cost of the lighting pass
+	u32 indices = 0;
+	u32 max_cluster_lights = 0;
+};
+
+//
+// Assigns lights to a GRID_X x GRID_Y x GRID_Z grid of froxels: screen tiles split in
+// depth slices spaced exponentially between the camera planes. Each cluster gets the
+// list of lights whose range overlaps its view space box, so the lighting pass only
+// evaluates lights that can reach its pixel and the cost follows light overlap instead
+// of the light count.
+//
+// Assignment runs on the job system, one job per depth slice. assign() starts it and
+// returns, bind() waits for it and uploads the lights, the cluster grid and the indices.
+//
+class LightClusters {
+public:
+	static const u32 GRID_X = 16;
+	static const u32 GRID_Y = 9;
+	static const u32 GRID_Z = 24;
+	static const u32 CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+
+	static const u32 LIGHT_BINDING = 5;
+	static const u32 GRID_BINDING = 6;
+	static const u32 INDEX_BINDING = 7;
+
+	LightClusters();
+	~LightClusters();
+
+	// the cluster boxes are only rebuilt when the projection changes
+	void set_camera(const glm::mat4& view, const glm::mat4& projection, f32 near_plane, f32 far_plane);
+
+	// starts assigning `lights` to the clusters of the current camera
+	void assign(std::vector<LightData> lights);
+
+	// waits for the assignment, uploads it and sets the slice uniforms of `shader`
+	void bind(ShaderProgram& shader);
+
+	const LightClusterStats& get_stats() const { return m_stats; }
+
+private:
+	struct ClusterBounds {
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	// light range as a view space sphere, depth is positive in front of the camera
+	struct ViewLight {
+		glm::vec3 center;
+		f32 radius;
+	};
+
+	glm::mat4 m_view = glm::mat4(1.0f);
+	glm::mat4 m_projection = glm::mat4(0.0f);
+	f32 m_near = 0.1f;
+	f32 m_far = 100.0f;
+	// view space boxes, x fastest then y then depth slice
+	std::vector<ClusterBounds> m_bounds;
+
+	std::vector<LightData> m_lights;
+	std::vector<ViewLight> m_view_lights;
+
+	// offset into the slice list and light count per cluster, written by the slice jobs
+	std::vector<glm::uvec2> m_grid;
+	// the same with offsets into m_indices, as uploaded
+	std::vector<glm::uvec2> m_upload_grid;
+	std::vector<u32> m_indices;
+	// filled by the slice jobs, concatenated into m_indices once they are done
+	std::vector<std::vector<u32>> m_slice_indices;
+
+	JobCounter m_counter;
+	bool m_pending = false;
+
+	std::shared_ptr<GlBuffer> m_light_buffer;
+	std::shared_ptr<GlBuffer> m_grid_buffer;
+	std::shared_ptr<GlBuffer> m_index_buffer;
+	LightClusterStats m_stats;
+
+	f32 get_slice_depth(u32 slice) const;
+	void build_bounds();
+	void assign_slice(u32 slice);
+	void upload();
+};
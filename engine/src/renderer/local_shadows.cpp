@@ -0,0 +1,414 @@
+#include "local_shadows.hpp"
+
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <imgui/imgui.h>
+#include <utils.hpp>
+
+#include <scene/scene.hpp>
+#include "resources/gl_state.hpp"
+
+// view direction and up vector of every cube face, in the order deferred_lighting.frag picks them
+static const glm::vec3 FACE_DIRECTIONS[] = {
+	glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+	glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+	glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+};
+
+static const glm::vec3 FACE_UPS[] = {
+	glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+	glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+	glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+};
+
+static bool overlaps(const BoundingSphere& a, const BoundingSphere& b)
+{
+	const auto offset = a.center - b.center;
+	const auto radius = a.radius + b.radius;
+	return glm::dot(offset, offset) <= radius * radius;
+}
+
+// the shadow only depends on these, params.y is written by update()
+static bool same_shadow(const LightData& a, const LightData& b)
+{
+	return a.position_range == b.position_range && a.direction_outer == b.direction_outer
+		&& a.color_type.w == b.color_type.w;
+}
+
+// field of view of the shadow frustums of `light`, a little wider than a spot cone so
+// its edge does not sample the border of the slot
+static f32 get_fov(const LightData& light)
+{
+	if (light.color_type.w != (f32)LIGHT_SPOT)
+		return glm::radians(90.0f);
+	return glm::min(2.0f * glm::acos(glm::clamp(light.direction_outer.w, -1.0f, 1.0f)) * 1.05f, glm::radians(170.0f));
+}
+
+LocalShadowAtlas::LocalShadowAtlas(std::shared_ptr<ShaderProgram> shader)
+	: m_shader(shader), m_free(get_level(MIN_SLOT) + 1)
+{
+	m_free[0].push_back(glm::uvec2(0));
+
+	TextureSpecification spec{};
+	spec.internalFormat = GL_DEPTH_COMPONENT;
+	spec.format = GL_DEPTH_COMPONENT;
+	spec.type = GL_FLOAT;
+	spec.width = ATLAS_SIZE;
+	spec.height = ATLAS_SIZE;
+	spec.wrapS = GL_CLAMP_TO_EDGE;
+	spec.wrapT = GL_CLAMP_TO_EDGE;
+	spec.minFilter = GL_NEAREST;
+	spec.magFilter = GL_NEAREST;
+	spec.attachement_target = GL_DEPTH_ATTACHMENT;
+	spec.generateMipmaps = false;
+	m_texture = std::make_shared<Texture>(spec);
+
+	BufferSpecification buffer_spec{};
+	buffer_spec.type = GL_SHADER_STORAGE_BUFFER;
+	buffer_spec.element_size = sizeof(ShadowData);
+	buffer_spec.count = MAX_SHADOWED_LIGHTS;
+	buffer_spec.data = nullptr;
+	buffer_spec.usage = GL_DYNAMIC_DRAW;
+	m_buffer = GlBuffer::create(buffer_spec);
+}
+
+u32 LocalShadowAtlas::get_level(u32 size) const
+{
+	u32 level = 0;
+	while ((ATLAS_SIZE >> level) > size)
+		level++;
+	return level;
+}
+
+bool LocalShadowAtlas::allocate(u32 size, Slot& slot)
+{
+	const auto level = get_level(size);
+
+	// smallest free node that fits, split down to the requested level
+	i32 found = (i32)level;
+	while (found >= 0 && m_free[found].empty())
+		found--;
+	if (found < 0)
+		return false;
+
+	const auto position = m_free[found].back();
+	m_free[found].pop_back();
+	for (u32 l = (u32)found; l < level; l++) {
+		const auto half = ATLAS_SIZE >> (l + 1);
+		m_free[l + 1].push_back(position + glm::uvec2(half, 0));
+		m_free[l + 1].push_back(position + glm::uvec2(0, half));
+		m_free[l + 1].push_back(position + glm::uvec2(half, half));
+	}
+
+	slot.position = position;
+	slot.size = ATLAS_SIZE >> level;
+	return true;
+}
+
+void LocalShadowAtlas::release(const Slot& slot)
+{
+	auto level = get_level(slot.size);
+	auto position = slot.position;
+
+	// merges with the three siblings as long as they are all free
+	while (level > 0) {
+		const auto size = ATLAS_SIZE >> level;
+		const auto parent = position - position % (2 * size);
+		const glm::uvec2 siblings[] = {
+			parent, parent + glm::uvec2(size, 0), parent + glm::uvec2(0, size), parent + glm::uvec2(size, size),
+		};
+
+		auto& free = m_free[level];
+		u32 free_siblings = 0;
+		for (const auto& sibling : siblings) {
+			if (sibling != position && std::find(free.begin(), free.end(), sibling) != free.end())
+				free_siblings++;
+		}
+		if (free_siblings < 3)
+			break;
+
+		free.erase(std::remove_if(free.begin(), free.end(), [&](const glm::uvec2& node) {
+			return std::find(std::begin(siblings), std::end(siblings), node) != std::end(siblings);
+		}), free.end());
+		position = parent;
+		level--;
+	}
+	m_free[level].push_back(position);
+}
+
+bool LocalShadowAtlas::allocate_faces(std::array<Slot, CUBE_FACES>& slots, u32 face_count, u32 largest, u32 smallest)
+{
+	// every face of a light has the same size, so the shader can share its texel size
+	for (auto size = largest; size >= smallest; size /= 2) {
+		u32 face = 0;
+		while (face < face_count && allocate(size, slots[face]))
+			face++;
+		if (face == face_count)
+			return true;
+		for (u32 i = 0; i < face; i++)
+			release(slots[i]);
+	}
+	return false;
+}
+
+u32 LocalShadowAtlas::get_desired_size(f32 screen_height) const
+{
+	const auto target = screen_height / m_full_size_height * MAX_SLOT;
+	u32 size = MIN_SLOT;
+	while (size < MAX_SLOT && (f32)size < target)
+		size *= 2;
+	return size;
+}
+
+void LocalShadowAtlas::build_matrices(ShadowedLight& shadowed) const
+{
+	const auto& light = shadowed.light;
+	const auto position = glm::vec3(light.position_range);
+	const auto range = light.position_range.w;
+	const auto near_plane = glm::max(range * 0.01f, 0.05f);
+
+	if (light.color_type.w == (f32)LIGHT_SPOT) {
+		const auto direction = glm::normalize(glm::vec3(light.direction_outer));
+		const auto up = glm::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		shadowed.matrices[0] = glm::perspective(get_fov(light), 1.0f, near_plane, range) * glm::lookAt(position, position + direction, up);
+		return;
+	}
+
+	const auto projection = glm::perspective(get_fov(light), 1.0f, near_plane, range);
+	for (u32 face = 0; face < CUBE_FACES; face++)
+		shadowed.matrices[face] = projection * glm::lookAt(position, position + FACE_DIRECTIONS[face], FACE_UPS[face]);
+}
+
+void LocalShadowAtlas::update(std::vector<LightData>& lights, const std::vector<u64>& ids, const glm::vec3& eye,
+	const glm::mat4& projection, const Frustum& frustum, Scene& scene)
+{
+	m_render_list.clear();
+	m_shadow_data.clear();
+	m_stats = {};
+
+	// screen height fraction of the range of every visible light, the largest ones get a shadow
+	std::vector<std::pair<f32, u32>> candidates;
+	for (u32 i = 0; i < (u32)lights.size(); i++) {
+		lights[i].params.y = -1.0f;
+		const BoundingSphere sphere{ glm::vec3(lights[i].position_range), lights[i].position_range.w };
+		if (!frustum.intersects(sphere))
+			continue;
+
+		const auto distance = glm::length(sphere.center - eye);
+		const auto height = distance <= sphere.radius ? 1.0f : glm::min(sphere.radius / distance * projection[1][1], 1.0f);
+		if (height >= m_min_height)
+			candidates.push_back({ height, i });
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+	if (candidates.size() > MAX_SHADOWED_LIGHTS)
+		candidates.resize(MAX_SHADOWED_LIGHTS);
+
+	// lights that dropped out or changed kind free their slots, as do those more than one step
+	// larger than needed, so the size does not flip back and forth around a step
+	std::unordered_map<u64, u32> chosen;
+	for (u32 i = 0; i < (u32)candidates.size(); i++)
+		chosen[ids[candidates[i].second]] = i;
+
+	for (auto it = m_lights.begin(); it != m_lights.end();) {
+		auto& shadowed = it->second;
+		const auto found = chosen.find(it->first);
+		bool keep = found != chosen.end();
+		if (keep) {
+			const auto& [height, index] = candidates[found->second];
+			const auto face_count = lights[index].color_type.w == (f32)LIGHT_SPOT ? 1u : CUBE_FACES;
+			keep = face_count == shadowed.face_count && shadowed.slots[0].size <= get_desired_size(height) * 2;
+		}
+
+		if (keep) {
+			++it;
+			continue;
+		}
+		for (u32 face = 0; face < shadowed.face_count; face++)
+			release(shadowed.slots[face]);
+		it = m_lights.erase(it);
+	}
+
+	// in importance order, new lights take a smaller slot when the atlas is too full and
+	// lights more than one step too small only move once a larger slot is free
+	for (const auto& [height, index] : candidates) {
+		const auto id = ids[index];
+		const auto& light = lights[index];
+		const auto desired = get_desired_size(height);
+		auto it = m_lights.find(id);
+		if (it != m_lights.end()) {
+			auto& shadowed = it->second;
+			// faces held back by the budget would be sampled with the new matrices against
+			// depth rendered from the old ones, the light waits for all of them like a new one
+			if (!same_shadow(shadowed.light, light)) {
+				shadowed.light = light;
+				build_matrices(shadowed);
+				shadowed.dirty.fill(true);
+				shadowed.valid = false;
+			}
+
+			const auto size = shadowed.slots[0].size;
+			std::array<Slot, CUBE_FACES> slots;
+			if (size * 2 < desired && allocate_faces(slots, shadowed.face_count, desired, size * 2)) {
+				for (u32 face = 0; face < shadowed.face_count; face++)
+					release(shadowed.slots[face]);
+				shadowed.slots = slots;
+				shadowed.dirty.fill(true);
+				shadowed.valid = false;
+			}
+			continue;
+		}
+
+		ShadowedLight shadowed{};
+		shadowed.id = id;
+		shadowed.light = light;
+		shadowed.face_count = light.color_type.w == (f32)LIGHT_SPOT ? 1u : CUBE_FACES;
+		shadowed.valid = false;
+		if (!allocate_faces(shadowed.slots, shadowed.face_count, desired, MIN_SLOT))
+			continue;
+
+		build_matrices(shadowed);
+		shadowed.dirty.fill(true);
+		m_lights[id] = shadowed;
+	}
+
+	// new transforms may reuse entity indices, every shadow is rendered again
+	auto& transforms = scene.get_transforms();
+	const bool rebuild = transforms.size() != m_transform_count;
+	if (rebuild) {
+		m_transform_count = transforms.size();
+		for (auto& [id, shadowed] : m_lights)
+			shadowed.dirty.fill(true);
+	}
+	invalidate_casters(scene, rebuild);
+
+	// dirty faces of the most important lights first, the rest waits for the next frames
+	for (const auto& [height, index] : candidates) {
+		auto it = m_lights.find(ids[index]);
+		if (it == m_lights.end())
+			continue;
+
+		auto& shadowed = it->second;
+		for (u32 face = 0; face < shadowed.face_count; face++) {
+			if (!shadowed.dirty[face])
+				continue;
+			if (m_render_list.size() >= MAX_RENDERED_FACES) {
+				m_stats.deferred_faces++;
+				continue;
+			}
+			shadowed.dirty[face] = false;
+			m_render_list.push_back({ shadowed.id, face });
+		}
+		// an outdated shadow is still better than none, only a light never rendered is skipped
+		if (std::none_of(shadowed.dirty.begin(), shadowed.dirty.begin() + shadowed.face_count, [](bool dirty) { return dirty; }))
+			shadowed.valid = true;
+		if (!shadowed.valid)
+			continue;
+
+		ShadowData data{};
+		for (u32 face = 0; face < shadowed.face_count; face++) {
+			const auto& slot = shadowed.slots[face];
+			data.faces[face] = shadowed.matrices[face];
+			data.rects[face] = glm::vec4(glm::vec2(slot.position), glm::vec2((f32)slot.size)) / (f32)ATLAS_SIZE;
+		}
+		// all faces share the slot size, a texel spans the frustum width over the slot at unit distance
+		const auto width = 2.0f * glm::tan(get_fov(shadowed.light) * 0.5f);
+		data.params = glm::vec4(width / shadowed.slots[0].size, 0.0f, 0.0f, 0.0f);
+
+		lights[index].params.y = (f32)m_shadow_data.size();
+		m_shadow_data.push_back(data);
+		m_stats.shadowed++;
+		m_stats.used_texels += (u64)shadowed.slots[0].size * shadowed.slots[0].size * shadowed.face_count;
+	}
+	m_stats.rendered_faces = (u32)m_render_list.size();
+}
+
+void LocalShadowAtlas::invalidate_casters(Scene& scene, bool rebuild)
+{
+	auto& transforms = scene.get_transforms();
+	if (!rebuild && transforms.get_updated_count() == 0)
+		return;
+
+	// a caster that moved dirties the faces that saw it before or see it now
+	auto invalidate = [&](const BoundingSphere& sphere) {
+		if (sphere.radius < 0.0f)
+			return;
+		for (auto& [id, shadowed] : m_lights) {
+			const BoundingSphere range{ glm::vec3(shadowed.light.position_range), shadowed.light.position_range.w };
+			if (!overlaps(sphere, range))
+				continue;
+			for (u32 face = 0; face < shadowed.face_count; face++) {
+				if (!shadowed.dirty[face] && Frustum::from_matrix(shadowed.matrices[face]).intersects(sphere))
+					shadowed.dirty[face] = true;
+			}
+		}
+	};
+
+	scene.get_world().each<Transform, Bounds>([&](Entity entity, Transform& transform, Bounds& bounds) {
+		if (transform.node == INVALID_TRANSFORM || (!rebuild && !transforms.has_moved(transform.node)))
+			return;
+
+		if (entity.index >= m_caster_spheres.size())
+			m_caster_spheres.resize(entity.index + 1, BoundingSphere{ glm::vec3(0.0f), -1.0f });
+
+		auto& sphere = m_caster_spheres[entity.index];
+		if (!rebuild)
+			invalidate(sphere);
+		sphere = bounds.world_sphere;
+		if (!rebuild)
+			invalidate(sphere);
+	});
+}
+
+Frustum LocalShadowAtlas::get_frustum() const
+{
+	if (m_render_list.empty()) {
+		Frustum frustum = Frustum::from_matrix(glm::mat4(1.0f));
+		// a plane every box is behind of
+		frustum.planes[Frustum::NEAR_PLANE] = glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+		return frustum;
+	}
+
+	// one box around the range of every rendered light, every face then draws the casters of the union
+	auto box = AABB::empty();
+	for (const auto& [id, face] : m_render_list) {
+		const auto& light = m_lights.at(id).light;
+		const auto center = glm::vec3(light.position_range);
+		box.grow(center - light.position_range.w);
+		box.grow(center + light.position_range.w);
+	}
+	return Frustum::from_matrix(glm::ortho(box.min.x, box.max.x, box.min.y, box.max.y, -box.max.z, -box.min.z));
+}
+
+void LocalShadowAtlas::begin_face(u32 index)
+{
+	const auto& [id, face] = m_render_list[index];
+	const auto& shadowed = m_lights.at(id);
+	const auto& slot = shadowed.slots[face];
+	glViewport((i32)slot.position.x, (i32)slot.position.y, slot.size, slot.size);
+	glScissor((i32)slot.position.x, (i32)slot.position.y, slot.size, slot.size);
+
+	const f32 depth = 1.0f;
+	glClearBufferfv(GL_DEPTH, 0, &depth);
+
+	m_shader->bind();
+	m_shader->set_mat4("light_space_matrix", glm::value_ptr(shadowed.matrices[face]));
+}
+
+void LocalShadowAtlas::bind()
+{
+	if (!m_shadow_data.empty())
+		m_buffer->update(m_shadow_data.data(), (u32)m_shadow_data.size());
+	GlState::get()->bind_buffer_range(GL_SHADER_STORAGE_BUFFER, SHADOW_BINDING, m_buffer->get_id(), 0, MAX_SHADOWED_LIGHTS * sizeof(ShadowData));
+	m_texture->bind(ATLAS_UNIT);
+}
+
+void LocalShadowAtlas::render_debug_menu()
+{
+	ImGui::DragFloat("full size height", &m_full_size_height, 0.01f, 0.05f, 1.0f);
+	ImGui::DragFloat("min shadow height", &m_min_height, 0.001f, 0.0f, 0.5f);
+	ImGui::Text("shadowed lights %u / %u", m_stats.shadowed, MAX_SHADOWED_LIGHTS);
+	ImGui::Text("rendered faces %u, deferred %u", m_stats.rendered_faces, m_stats.deferred_faces);
+	ImGui::Text("atlas use %.1f%%", 100.0f * (f32)m_stats.used_texels / ((f32)ATLAS_SIZE * ATLAS_SIZE));
+	utils::imgui_render_hoverable_image(m_texture, ImVec2(400.0f, 400.0f));
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <glm/glm/glm.hpp>
+
+#include <defines.hpp>
+#include <scene/bounds.hpp>
+#include "light_clusters.hpp"
+#include "resources/buffer.hpp"
+#include "resources/texture.hpp"
+#include "resources/shader_program.hpp"
+
+class Scene;
+
+struct LocalShadowStats {
+	u32 shadowed = 0;
+	u32 rendered_faces = 0;
+	// dirty faces left for the next frames by the per-frame budget
+	u32 deferred_faces = 0;
+	// texels of the atlas in use
+	u64 used_texels = 0;
+};
+
+//
+// Shadows of point and spot lights packed in one depth atlas of ATLAS_SIZE², a fixed
+// budget however many lights the scene has. A spot light takes one slot, a point light
+// a cube of six. Slot sizes follow the size of the light on screen and are handed out
+// by a quadtree (buddy) allocator in power of two steps, the most important lights first.
+//
+// A light keeps its slots and its rendered shadow across frames. It is only rendered
+// again when it moved, its slot size changed or a caster moved inside its range.
+// The chosen lights get their shadow index in LightData::params.y, -1 otherwise.
+//
+class LocalShadowAtlas {
+public:
+	static const u32 ATLAS_SIZE = 4096;
+	static const u32 MIN_SLOT = 128;
+	static const u32 MAX_SLOT = 1024;
+	static const u32 MAX_SHADOWED_LIGHTS = 32;
+	static const u32 MAX_RENDERED_FACES = 24;
+	static const u32 CUBE_FACES = 6;
+
+	static const u32 SHADOW_BINDING = 10;
+	static const u32 ATLAS_UNIT = 11;
+
+	LocalShadowAtlas(std::shared_ptr<ShaderProgram> shader);
+
+	// picks the shadowed lights, (re)allocates their slots and the faces rendered this frame.
+	// `ids` identifies each light across frames, (generation << 32) | index of its entity
+	void update(std::vector<LightData>& lights, const std::vector<u64>& ids, const glm::vec3& eye,
+		const glm::mat4& projection, const Frustum& frustum, Scene& scene);
+
+	// box around the lights rendered this frame, rejects everything when there are none
+	Frustum get_frustum() const;
+	u32 get_render_count() const { return (u32)m_render_list.size(); }
+	// clears the slot of the `index`th face to render, draw the LAYER_SHADOW_LOCAL casters after this
+	void begin_face(u32 index);
+
+	// uploads the shadow matrices and binds them with the atlas for deferred_lighting.frag
+	void bind();
+
+	std::shared_ptr<Texture> get_texture() { return m_texture; }
+	const LocalShadowStats& get_stats() const { return m_stats; }
+	void render_debug_menu();
+
+private:
+	// std430 layout of the LocalShadows buffer in deferred_lighting.frag
+	struct ShadowData {
+		glm::mat4 faces[CUBE_FACES];
+		// atlas uv offset and scale of every face
+		glm::vec4 rects[CUBE_FACES];
+		// x world size of a texel one unit away from the light
+		glm::vec4 params;
+	};
+
+	struct Slot {
+		glm::uvec2 position;
+		u32 size;
+	};
+
+	struct ShadowedLight {
+		u64 id;
+		LightData light;
+		u32 face_count;
+		std::array<Slot, CUBE_FACES> slots;
+		std::array<glm::mat4, CUBE_FACES> matrices;
+		std::array<bool, CUBE_FACES> dirty;
+		// every face was rendered at least once with its current slot and matrices
+		bool valid;
+	};
+
+	std::shared_ptr<ShaderProgram> m_shader;
+	std::shared_ptr<Texture> m_texture;
+	std::shared_ptr<GlBuffer> m_buffer;
+
+	// free quadtree nodes per level, level 0 is the whole atlas
+	std::vector<std::vector<glm::uvec2>> m_free;
+
+	std::unordered_map<u64, ShadowedLight> m_lights;
+	// light id and face of every face rendered this frame
+	std::vector<std::pair<u64, u32>> m_render_list;
+	std::vector<ShadowData> m_shadow_data;
+
+	// world sphere of every caster by entity index where it was last frame
+	std::vector<BoundingSphere> m_caster_spheres;
+	u32 m_transform_count = 0;
+
+	// a light on screen at this height fraction gets MAX_SLOT
+	f32 m_full_size_height = 0.5f;
+	// lights smaller than this on screen cast no shadow
+	f32 m_min_height = 0.02f;
+	LocalShadowStats m_stats;
+
+	u32 get_level(u32 size) const;
+	bool allocate(u32 size, Slot& slot);
+	void release(const Slot& slot);
+	// all `face_count` slots of one size, from `largest` down to `smallest`
+	bool allocate_faces(std::array<Slot, CUBE_FACES>& slots, u32 face_count, u32 largest, u32 smallest);
+
+	u32 get_desired_size(f32 screen_height) const;
+	void build_matrices(ShadowedLight& shadowed) const;
+	void invalidate_casters(Scene& scene, bool rebuild);
+};
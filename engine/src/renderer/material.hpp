@@ -20,6 +20,11 @@ struct PbrMaterial : public Bindable{
 	std::shared_ptr<Texture> emissive;
 	std::shared_ptr<ShaderProgram> shader;
 
+	// assigned by MaterialTable::add: index into the material buffer, and the set of
+	// texture arrays holding the textures, shared by every material packed into the same arrays
+	u32 material_index = 0;
+	u32 texture_set = 0;
+
 	// Inherited via Bindable
 	void bind() override;
 	void unbind() override;
@@ -0,0 +1,97 @@
+#include "material_table.hpp"
+
+#include <algorithm>
+#include "material.hpp"
+#include "resources/gl_state.hpp"
+
+void MaterialTable::add(PbrMaterial& material)
+{
+	const std::array<std::shared_ptr<Texture>, TEXTURE_SLOTS> textures = { material.albedo, material.normal, material.mra, material.emissive };
+
+	MaterialData data{};
+	data.metallic_factor = material.metallic_factor;
+	data.roughness_factor = material.roughness_factor;
+	data.emissive_factor = material.emissive_factor;
+	data.ao_factor = material.ao_factor;
+
+	std::array<u32, TEXTURE_SLOTS> arrays;
+	for (u32 slot = 0; slot < TEXTURE_SLOTS; slot++) {
+		const auto layer = textures[slot] ? pack(*textures[slot]) : Layer{ NO_ARRAY, 0 };
+		arrays[slot] = layer.array;
+		data.layers[slot] = layer.layer;
+	}
+
+	material.material_index = (u32)m_materials.size();
+	material.texture_set = m_set_lookup.emplace(arrays, (u32)m_sets.size()).first->second;
+	if (material.texture_set == m_sets.size())
+		m_sets.push_back(arrays);
+
+	m_materials.push_back(data);
+	m_dirty = true;
+}
+
+void MaterialTable::bind(u32 texture_set)
+{
+	if (m_dirty)
+		upload();
+
+	if (texture_set < m_sets.size()) {
+		const auto& arrays = m_sets[texture_set];
+		for (u32 slot = 0; slot < TEXTURE_SLOTS; slot++) {
+			if (arrays[slot] != NO_ARRAY)
+				m_arrays[arrays[slot]]->bind(slot);
+		}
+	}
+
+	if (m_buffer)
+		GlState::get()->bind_buffer_range(GL_SHADER_STORAGE_BUFFER, BUFFER_BINDING, m_buffer->get_id(), 0, m_buffer->get_count() * sizeof(MaterialData));
+}
+
+MaterialTable::Layer MaterialTable::pack(Texture& texture)
+{
+	const auto it = m_layers.find(texture.get_resource_id());
+	if (it != m_layers.end())
+		return it->second;
+
+	const auto& spec = texture.get_spec();
+	const auto width = texture.get_width();
+	const auto height = texture.get_height();
+	const auto levels = TextureArray::level_count(spec, width, height);
+	const auto format = TextureArray::sized_format(spec.internalFormat);
+
+	auto key = std::make_tuple(width, height, levels, format);
+	auto array = m_array_lookup.find(key);
+	if (array == m_array_lookup.end()) {
+		TextureArraySpecification array_spec{};
+		array_spec.width = width;
+		array_spec.height = height;
+		array_spec.levels = levels;
+		array_spec.internal_format = format;
+		array = m_array_lookup.emplace(key, (u32)m_arrays.size()).first;
+		m_arrays.push_back(TextureArray::create(array_spec));
+	}
+
+	const Layer layer = { array->second, m_arrays[array->second]->add_layer(texture) };
+	m_layers.emplace(texture.get_resource_id(), layer);
+	return layer;
+}
+
+void MaterialTable::upload()
+{
+	m_dirty = false;
+	if (m_materials.empty())
+		return;
+
+	// materials are only added while loading, recreating the buffer is fine
+	if (!m_buffer || m_buffer->get_count() < m_materials.size()) {
+		BufferSpecification spec{};
+		spec.type = GL_SHADER_STORAGE_BUFFER;
+		spec.element_size = sizeof(MaterialData);
+		spec.count = std::max((u32)m_materials.size(), m_buffer ? m_buffer->get_count() * 2 : 64u);
+		spec.data = nullptr;
+		spec.usage = GL_STATIC_DRAW;
+		m_buffer = GlBuffer::create(spec);
+	}
+
+	m_buffer->update(m_materials.data(), (u32)m_materials.size());
+}
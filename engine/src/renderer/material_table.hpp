@@ -0,0 +1,70 @@
+#pragma once
+
+#include <map>
+#include <array>
+#include <tuple>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include <defines.hpp>
+#include "resources/buffer.hpp"
+#include "resources/texture_array.hpp"
+
+struct PbrMaterial;
+
+//
+// GPU side of every registered material. Factors live in one shader storage buffer indexed
+// by the material index each instance carries, textures are packed into texture arrays of
+// matching size and format and addressed by layer. Materials whose textures landed in
+// the same four arrays form a texture set: draws of any of them need the same bindings,
+// so they can go into one multi draw.
+//
+class MaterialTable {
+public:
+	static const u32 BUFFER_BINDING = 4;
+	// albedo, normal, mra, emissive, bound to texture units [0, TEXTURE_SLOTS)
+	static const u32 TEXTURE_SLOTS = 4;
+	static const u32 NO_ARRAY = ~0u;
+
+	// packs the material textures and assigns its material_index and texture_set
+	void add(PbrMaterial& material);
+
+	// binds the arrays of `texture_set` and the material buffer, uploading it if materials were added
+	void bind(u32 texture_set);
+
+	u32 get_material_count() const { return (u32)m_materials.size(); }
+	u32 get_array_count() const { return (u32)m_arrays.size(); }
+	u32 get_set_count() const { return (u32)m_sets.size(); }
+
+private:
+	// std430 layout of the Materials buffer in gbuffer.frag
+	struct MaterialData {
+		f32 metallic_factor;
+		f32 roughness_factor;
+		f32 emissive_factor;
+		f32 ao_factor;
+		u32 layers[TEXTURE_SLOTS];
+	};
+
+	struct Layer {
+		u32 array;
+		u32 layer;
+	};
+
+	std::vector<MaterialData> m_materials;
+	std::shared_ptr<GlBuffer> m_buffer;
+	bool m_dirty = false;
+
+	// width, height, levels, sized format
+	std::map<std::tuple<u32, u32, u32, GLenum>, u32> m_array_lookup;
+	std::vector<std::shared_ptr<TextureArray>> m_arrays;
+	// texture id to where it was packed, textures shared by materials are copied once
+	std::unordered_map<u32, Layer> m_layers;
+
+	std::map<std::array<u32, TEXTURE_SLOTS>, u32> m_set_lookup;
+	std::vector<std::array<u32, TEXTURE_SLOTS>> m_sets;
+
+	Layer pack(Texture& texture);
+	void upload();
+};
@@ -22,16 +22,29 @@ Mesh::Mesh(const aiMesh* mesh, const aiScene* scene, const std::string& model_pa
 		return;
 	}
 
-	auto layout = VertexLayout::create();
-	layout->push<f32>("position", 3);
-	layout->push<f32>("normal", 3);
-	layout->push<f32>("texcoord", 2);
-	layout->push<f32>("tangent", 3);
-	layout->push<f32>("bitangent", 3);
+	// local bounds
+	if (mesh->mNumVertices > 0) {
+		m_bounds.min = m_bounds.max = glm::vec3(mesh->mVertices[0].x, mesh->mVertices[0].y, mesh->mVertices[0].z);
+		for (u64 i = 1; i < mesh->mNumVertices; i++) {
+			const auto position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+			m_bounds.min = glm::min(m_bounds.min, position);
+			m_bounds.max = glm::max(m_bounds.max, position);
+		}
+
+		// sphere around the box center, tight to the actual vertices
+		m_sphere.center = m_bounds.get_center();
+		for (u64 i = 0; i < mesh->mNumVertices; i++) {
+			const auto position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+			m_sphere.radius = glm::max(m_sphere.radius, glm::distance(position, m_sphere.center));
+		}
+	}
+
+	// vertices are interleaved in the layout of the renderer's geometry pool
+	std::vector<f32> vertices;
+	std::vector<u32> indices;
 
 	// load vertices
 	{
-		std::vector<f32> vertices;
 		vertices.reserve(mesh->mNumVertices * 16);
 		for (u64 i = 0; i < mesh->mNumVertices; i++) {
 			vertices.push_back(mesh->mVertices[i].x);
@@ -53,19 +66,10 @@ Mesh::Mesh(const aiMesh* mesh, const aiScene* scene, const std::string& model_pa
 			vertices.push_back(mesh->mBitangents[i].y);
 			vertices.push_back(mesh->mBitangents[i].z);
 		}
-
-		BufferSpecification vspec{};
-		vspec.type = GL_ARRAY_BUFFER;
-		vspec.count = (u32)vertices.size();
-		vspec.data = vertices.data();
-		vspec.element_size = sizeof(f32);
-		vspec.usage = GL_STATIC_DRAW;
-		m_vbuffer = GlBuffer::create(std::move(vspec));
 	}
 
 	// load indices
 	{
-		std::vector<u32> indices;
 		indices.reserve(mesh->mNumFaces * 3);
 		for (u64 i = 0; i < mesh->mNumFaces; i++) {
 			auto face = mesh->mFaces[i];
@@ -74,66 +78,47 @@ Mesh::Mesh(const aiMesh* mesh, const aiScene* scene, const std::string& model_pa
 			indices.push_back(face.mIndices[2]);
 		}
 
-		BufferSpecification ispec{};
-		ispec.type = GL_ELEMENT_ARRAY_BUFFER;
-		ispec.count = (u32)indices.size();
-		ispec.data = indices.data();
-		ispec.element_size = sizeof(u32);
-		ispec.usage = GL_STATIC_DRAW;
-		m_ibuffer = GlBuffer::create(std::move(ispec));
+		// low poly meshes are their own occluder, detailed ones get a box proxy inside them
+		std::vector<glm::vec3> positions;
+		positions.reserve(mesh->mNumVertices);
+		for (u64 i = 0; i < mesh->mNumVertices; i++) {
+			positions.push_back(glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z));
+		}
+
+		if (mesh->mNumFaces <= MAX_OCCLUDER_TRIANGLES) {
+			m_occluder = std::make_unique<Occluder>();
+			m_occluder->positions = std::move(positions);
+			m_occluder->indices = indices;
+		} else {
+			m_occluder = Occluder::create_inner_box(positions, indices);
+		}
 	}
 
-	VertexArraySpecification vao_spec{};
-	vao_spec.layout = layout;
-	vao_spec.index_buffer = m_ibuffer;
-	vao_spec.vertex_buffer = m_vbuffer;
-	m_vao = VertexArray::create(vao_spec);
+	m_pool = g_engine->get_renderer()->get_geometry_pool();
+	m_geometry = m_pool->allocate(vertices.data(), mesh->mNumVertices, indices.data(), (u32)indices.size());
 
 	const auto ai_material = scene->mMaterials[mesh->mMaterialIndex];
 	m_pbr = PbrMaterial::from_assimp(ai_material, model_path);
 }
 
-
-void Mesh::render(const std::shared_ptr<ShaderProgram>& shader, const glm::mat4& model) const {
-	shader->bind();
-	shader->set_float("metallic_factor", m_pbr->metallic_factor);
-	shader->set_float("roughness_factor", m_pbr->roughness_factor);
-	shader->set_float("emissive_factor", m_pbr->emissive_factor);
-	shader->set_float("ao_factor", m_pbr->ao_factor);
-
-	if (m_pbr->albedo)
-		m_pbr->albedo->bind();
-
-	if (m_pbr->normal)
-		m_pbr->normal->bind();
-
-	if (m_pbr->mra)
-		m_pbr->mra->bind();
-
-	if (m_pbr->emissive)
-		m_pbr->emissive->bind();
-
-	shader->set_mat4("model", glm::value_ptr(model));
-	
-	m_vao->bind();
-	glDrawElements(GL_TRIANGLES, m_ibuffer->get_count(), GL_UNSIGNED_INT, nullptr);
-
-	g_engine->get_renderer()->inc_render_stats_triangles(m_ibuffer->get_count() / 3);
+std::string Mesh::get_name() const
+{
+	return m_name;
 }
 
-void Mesh::render(const glm::mat4& model) const {
-	m_pbr->bind();
-	m_pbr->shader->set_mat4("model", glm::value_ptr(model));
-
-	m_vao->bind();
-	glDrawElements(GL_TRIANGLES, m_ibuffer->get_count(), GL_UNSIGNED_INT, nullptr);
+const AABB& Mesh::get_bounds() const
+{
+	return m_bounds;
+}
 
-	g_engine->get_renderer()->inc_render_stats_triangles(m_ibuffer->get_count() / 3);
+const BoundingSphere& Mesh::get_bounding_sphere() const
+{
+	return m_sphere;
 }
 
-std::string Mesh::get_name() const
+const Occluder* Mesh::get_occluder() const
 {
-	return m_name;
+	return m_occluder.get();
 }
 
 void Mesh::render_menu_debug() const
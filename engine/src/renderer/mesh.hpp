@@ -11,6 +11,9 @@
 #include "resources/shader_program.hpp"
 #include "renderer.hpp"
 #include "material.hpp"
+#include "occlusion.hpp"
+#include "geometry_pool.hpp"
+#include <scene/bounds.hpp>
 
 // assimp forward declare
 struct aiMesh;
@@ -18,23 +21,36 @@ struct aiScene;
 
 class Mesh {
 public:
+    // meshes up to this many triangles keep a cpu copy for software occlusion culling,
+    // larger ones an inner box proxy
+    static const u32 MAX_OCCLUDER_TRIANGLES = 512;
+
     static std::shared_ptr<Mesh> create_from_assimp(const aiMesh *mesh, const aiScene *scene, const std::string &model_path) {
         return std::make_shared<Mesh>(mesh, scene, model_path);
     }
 
     Mesh(const aiMesh *mesh, const aiScene *scene, const std::string &model_path);
 
-    void render(const std::shared_ptr<ShaderProgram>& shader, const glm::mat4& model) const;
-    void render(const glm::mat4 &model) const;
+    // instanced draws are recorded by the passes, this is where the mesh lives in the shared pool
+    VertexArray* get_vao() const { return m_pool->get_vao(); }
+    const GeometryRange& get_geometry() const { return m_geometry; }
+    PbrMaterial* get_material() const { return m_pbr.get(); }
+
     std::string get_name() const;
+    const AABB& get_bounds() const;
+    const BoundingSphere& get_bounding_sphere() const;
+    // nullptr when the mesh is too detailed and no box proxy fits inside it
+    const Occluder* get_occluder() const;
 
     void render_menu_debug() const;
 private:
     std::string m_name;
+    AABB m_bounds;
+    BoundingSphere m_sphere;
+    std::unique_ptr<Occluder> m_occluder;
 
     std::shared_ptr<PbrMaterial> m_pbr;
 
-    std::shared_ptr<GlBuffer> m_vbuffer;
-    std::shared_ptr<GlBuffer> m_ibuffer;
-    std::shared_ptr<VertexArray> m_vao;
+    GeometryPool* m_pool = nullptr;
+    GeometryRange m_geometry;
 };
\ No newline at end of file
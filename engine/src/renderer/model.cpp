@@ -3,45 +3,24 @@
 #include <assimp/postprocess.h>
 
 #include <iostream>
+#include <engine.hpp>
 
-Node::Node(std::vector<std::shared_ptr<Mesh>> meshes, const glm::mat4& transform)
-	: m_meshes(meshes), m_transform(transform)
+std::shared_ptr<Model> Model::create(const std::string& name)
 {
+	auto& renderer = g_engine->get_renderer();
 
-}
-
-void Node::add_child(std::shared_ptr<Node> child)
-{
-	assert(child && "No child to add!");
-	m_children.push_back(std::move(child));
-}
-
-void Node::render(const std::shared_ptr<ShaderProgram>& shader, const glm::mat4& parent_transform) const {
-	const auto transform = parent_transform * m_transform;
-
-	for (const auto& mesh : m_meshes) {
-		mesh->render(shader, transform);
-	}
+	// models are immutable after import, so every request for the same asset shares the same gpu data
+	auto model = renderer->get_model(name);
+	if (model)
+		return model;
 
-	for (const auto& child : m_children) {
-		child->render(shader, transform);
-	}
+	model = std::make_shared<Model>(name);
+	renderer->add_model(name, model);
+	return model;
 }
 
-void Node::render(const glm::mat4& parent_transform) const
-{
-	const auto transform = parent_transform * m_transform;
-
-	for (const auto& mesh : m_meshes) {
-		mesh->render(transform);
-	}
-
-	for (const auto& child : m_children) {
-		child->render(transform);
-	}
-}
-
-Model::Model(const std::string& name) {
+Model::Model(const std::string& name)
+	: m_name(name) {
 	const auto path = ResourceState::get()->getModelPath(name);
 
 	Assimp::Importer importer;
@@ -67,28 +46,99 @@ Model::Model(const std::string& name) {
 		m_meshes.push_back(Mesh::create_from_assimp(mesh, p_scene, path.string()));
 	}
 
-	m_root = parse_node(p_scene->mRootNode);
+	parse_node(p_scene->mRootNode, -1);
+
+	m_pvs = Pvs::load(path / "pvs.bin");
+	if (m_pvs && m_pvs->get_mesh_count() != m_nodes.meshes.size()) {
+		KERROR("PVS of {} was baked for {} meshes, model has {}", name, m_pvs->get_mesh_count(), m_nodes.meshes.size());
+		m_pvs = nullptr;
+	}
 }
 
-void Model::render(const std::shared_ptr<ShaderProgram>& shader, const glm::mat4& transform) const {
-	m_root->render(shader, transform);
+void Model::render_menu_debug() const
+{
+	for (const auto& mesh : m_meshes) {
+		mesh->render_menu_debug();
+	}
 }
 
-void Model::render(const glm::mat4& transform) const
+const ModelNodes& Model::get_nodes() const
 {
-	m_root->render(transform);
+	return m_nodes;
 }
 
-void Model::render_menu_debug() const
+const std::vector<std::shared_ptr<Mesh>>& Model::get_meshes() const
 {
-	for (const auto& mesh : m_meshes) {
-		mesh->render_menu_debug();
+	return m_meshes;
+}
+
+const std::string& Model::get_name() const
+{
+	return m_name;
+}
+
+PvsGeometry Model::load_pvs_geometry() const
+{
+	const auto path = ResourceState::get()->getModelPath(m_name);
+
+	Assimp::Importer importer;
+	const auto p_scene = importer.ReadFile((path / "scene.gltf").string(), aiProcess_Triangulate);
+
+	PvsGeometry geometry;
+	if (!p_scene) {
+		KERROR("Could not import {}", m_name);
+		return geometry;
+	}
+
+	// model space node transforms, parents come first
+	std::vector<glm::mat4> world(m_nodes.transforms.size());
+	for (u64 i = 0; i < world.size(); i++) {
+		const auto parent = m_nodes.parents[i];
+		world[i] = parent < 0 ? m_nodes.transforms[i] : world[parent] * m_nodes.transforms[i];
+	}
+
+	for (u32 i = 0; i < m_nodes.meshes.size(); i++) {
+		const auto& ref = m_nodes.meshes[i];
+		const auto mesh = p_scene->mMeshes[ref.mesh];
+		const auto base = (u32)geometry.positions.size();
+
+		auto bounds = AABB::empty();
+		for (u64 v = 0; v < mesh->mNumVertices; v++) {
+			const auto position = glm::vec3(world[ref.node] * glm::vec4(mesh->mVertices[v].x, mesh->mVertices[v].y, mesh->mVertices[v].z, 1.0f));
+			geometry.positions.push_back(position);
+			bounds.grow(position);
+		}
+
+		for (u64 f = 0; f < mesh->mNumFaces; f++) {
+			const auto& face = mesh->mFaces[f];
+			if (face.mNumIndices != 3)
+				continue;
+
+			geometry.indices.push_back(base + face.mIndices[0]);
+			geometry.indices.push_back(base + face.mIndices[1]);
+			geometry.indices.push_back(base + face.mIndices[2]);
+			geometry.triangle_meshes.push_back(i);
+		}
+
+		geometry.mesh_bounds.push_back(bounds);
 	}
+
+	return geometry;
 }
 
-std::shared_ptr<Node> Model::get_root() const
+const std::shared_ptr<Pvs>& Model::get_pvs() const
 {
-	return m_root;
+	return m_pvs;
+}
+
+void Model::bake_pvs(const PvsBakeSettings& settings)
+{
+	const auto geometry = load_pvs_geometry();
+	auto pvs = Pvs::bake(geometry, settings);
+	pvs->save(ResourceState::get()->getModelPath(m_name) / "pvs.bin");
+
+	KDEBUG("Baked PVS for {}: {} cells, {} unique sets", m_name, pvs->get_cell_count(), pvs->get_row_count());
+	m_pvs = std::move(pvs);
 }
 
 inline glm::mat4 Model::assimp_to_glm(const aiMatrix4x4& from)
@@ -114,7 +164,7 @@ inline glm::mat4 Model::assimp_to_glm(const aiMatrix4x4& from)
 
 }
 
-std::shared_ptr<Node> Model::parse_node(const aiNode* node) const
+void Model::parse_node(const aiNode* node, i32 parent)
 {
 	auto transform = assimp_to_glm(node->mTransformation);
 
@@ -122,16 +172,16 @@ std::shared_ptr<Node> Model::parse_node(const aiNode* node) const
 		transform = glm::mat4(1.0f);
 	}
 
-	std::vector<std::shared_ptr<Mesh>> meshes;
-	meshes.reserve(node->mNumMeshes);
+	// pre-order traversal keeps every parent ahead of its children
+	const auto index = (u32)m_nodes.transforms.size();
+	m_nodes.transforms.push_back(transform);
+	m_nodes.parents.push_back(parent);
+
 	for (u64 i = 0; i < node->mNumMeshes; i++) {
-		meshes.push_back(m_meshes[node->mMeshes[i]]);
+		m_nodes.meshes.push_back({ index, node->mMeshes[i] });
 	}
 
-	auto ret_node = std::make_shared<Node>(std::move(meshes), transform);
 	for (u64 i = 0; i < node->mNumChildren; i++) {
-		ret_node->add_child(parse_node(node->mChildren[i]));
+		parse_node(node->mChildren[i], (i32)index);
 	}
-
-	return ret_node;
 }
@@ -5,44 +5,53 @@
 #include <memory>
 #include "resources/shader_program.hpp"
 #include "mesh.hpp"
-
-class Node {
-	friend class Model;
-
-public:
-	Node(std::vector<std::shared_ptr<Mesh>> meshes, const glm::mat4& transform);
-
-	void add_child(std::shared_ptr<Node> child);
-	void render(const std::shared_ptr<ShaderProgram>& shader, const glm::mat4& parent_transform) const;
-	void render(const glm::mat4& parent_transform) const;
-
-	glm::mat4 m_transform;
-
-private:
-	std::vector<std::shared_ptr<Node>> m_children;
-	std::vector<std::shared_ptr<Mesh>> m_meshes;
+#include <scene/pvs.hpp>
+
+//
+// Imported node tree flattened into parent-sorted arrays.
+// A node's parent always has a smaller index than the node itself.
+//
+struct ModelNodes {
+	std::vector<glm::mat4> transforms;
+	std::vector<i32> parents;
+
+	// (node, mesh) pairs, one per mesh referenced by a node
+	struct MeshRef {
+		u32 node;
+		u32 mesh;
+	};
+	std::vector<MeshRef> meshes;
 };
 
 class Model {
 public:
-	static std::shared_ptr<Model> create(const std::string& name) {
-		return std::make_shared<Model>(name);
-	}
+	// returns the shared asset for `name`, importing it only the first time it is requested
+	static std::shared_ptr<Model> create(const std::string& name);
 
 	explicit Model(const std::string& name);
 
-	void render(const std::shared_ptr<ShaderProgram>& shader, const glm::mat4& transform = glm::mat4(1.0f)) const;
-	void render(const glm::mat4& transform = glm::mat4(1.0f)) const;
 	void render_menu_debug() const;
 
-	std::shared_ptr<Node> get_root() const;
+	const ModelNodes& get_nodes() const;
+	const std::vector<std::shared_ptr<Mesh>>& get_meshes() const;
+	const std::string& get_name() const;
+
+	// re-imports the asset with every mesh instance flattened into model space, mesh i of the
+	// result is get_nodes().meshes[i]. meant for offline bakes, the gpu data is untouched.
+	PvsGeometry load_pvs_geometry() const;
+
+	// visibility baked for static environments, loaded from pvs.bin next to the model when present
+	const std::shared_ptr<Pvs>& get_pvs() const;
+	// bakes, saves and replaces the pvs
+	void bake_pvs(const PvsBakeSettings& settings = {});
 
 private:
 	static inline glm::mat4 assimp_to_glm(const aiMatrix4x4& from);
 
-	std::shared_ptr<Node> parse_node(const aiNode* node) const;
+	void parse_node(const aiNode* node, i32 parent);
 
 	std::vector<std::shared_ptr<Mesh>> m_meshes;
-	std::shared_ptr<Node> m_root;
+	ModelNodes m_nodes;
 	std::string m_name;
+	std::shared_ptr<Pvs> m_pvs;
 };
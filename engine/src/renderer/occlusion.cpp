@@ -0,0 +1,364 @@
+#include "occlusion.hpp"
+
+#include <algorithm>
+#include <jobs.hpp>
+
+#if defined(_M_X64) || defined(__SSE__)
+#include <xmmintrin.h>
+#define OCCLUSION_SIMD 1
+#endif
+
+// clip space w below this is treated as behind the eye
+static const f32 MIN_W = 1e-4f;
+
+// separating axis test of a triangle against a box centered at the origin (Akenine-Moller)
+static bool triangle_overlaps_box(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, const glm::vec3& extents)
+{
+	const glm::vec3 edges[] = { v1 - v0, v2 - v1, v0 - v2 };
+
+	// the 9 cross products of the box axes and the triangle edges
+	for (const auto& edge : edges) {
+		for (u32 axis = 0; axis < 3; axis++) {
+			glm::vec3 unit(0.0f);
+			unit[axis] = 1.0f;
+			const auto direction = glm::cross(unit, edge);
+			const auto p0 = glm::dot(v0, direction);
+			const auto p1 = glm::dot(v1, direction);
+			const auto p2 = glm::dot(v2, direction);
+			const auto radius = glm::dot(extents, glm::abs(direction));
+			if (glm::min(p0, glm::min(p1, p2)) > radius || glm::max(p0, glm::max(p1, p2)) < -radius)
+				return false;
+		}
+	}
+
+	// the box faces
+	for (u32 axis = 0; axis < 3; axis++) {
+		if (glm::min(v0[axis], glm::min(v1[axis], v2[axis])) > extents[axis] || glm::max(v0[axis], glm::max(v1[axis], v2[axis])) < -extents[axis])
+			return false;
+	}
+
+	// the triangle plane
+	const auto normal = glm::cross(edges[0], edges[1]);
+	return glm::abs(glm::dot(normal, v0)) <= glm::dot(extents, glm::abs(normal));
+}
+
+// crossings of a ray from `origin` with the mesh, odd inside a closed mesh (Moller-Trumbore)
+static u32 count_crossings(const glm::vec3& origin, const glm::vec3& direction, const std::vector<glm::vec3>& positions, const std::vector<u32>& indices)
+{
+	u32 crossings = 0;
+	for (u64 i = 0; i + 2 < indices.size(); i += 3) {
+		const auto& v0 = positions[indices[i]];
+		const auto edge1 = positions[indices[i + 1]] - v0;
+		const auto edge2 = positions[indices[i + 2]] - v0;
+		const auto p = glm::cross(direction, edge2);
+		const auto det = glm::dot(edge1, p);
+		if (glm::abs(det) < 1e-12f)
+			continue;
+
+		const auto inv_det = 1.0f / det;
+		const auto offset = origin - v0;
+		const auto u = glm::dot(offset, p) * inv_det;
+		if (u < 0.0f || u > 1.0f)
+			continue;
+		const auto q = glm::cross(offset, edge1);
+		const auto v = glm::dot(direction, q) * inv_det;
+		if (v < 0.0f || u + v > 1.0f)
+			continue;
+		if (glm::dot(edge2, q) * inv_det > 0.0f)
+			crossings++;
+	}
+	return crossings;
+}
+
+std::unique_ptr<Occluder> Occluder::create_inner_box(const std::vector<glm::vec3>& positions, const std::vector<u32>& indices)
+{
+	auto bounds = AABB::empty();
+	for (const auto& position : positions)
+		bounds.grow(position);
+	if (bounds.is_empty())
+		return nullptr;
+
+	const auto center = bounds.get_center();
+	const auto extents = bounds.get_extents();
+	if (glm::min(extents.x, glm::min(extents.y, extents.z)) <= 0.0f)
+		return nullptr;
+
+	// a box no triangle crosses is either fully inside or fully outside, its center tells which.
+	// every ray has to agree, an open mesh lets some of them out. skewed directions so the
+	// rays do not run along the edges of axis aligned geometry
+	const glm::vec3 directions[] = {
+		glm::normalize(glm::vec3(1.0f, 0.0137f, 0.0071f)),
+		glm::normalize(glm::vec3(-0.0113f, 1.0f, 0.0173f)),
+		glm::normalize(glm::vec3(0.0091f, -0.0157f, -1.0f)),
+	};
+	u32 inside = 0;
+	for (const auto& direction : directions)
+		inside += count_crossings(center, direction, positions, indices) & 1;
+	if (inside < 3)
+		return nullptr;
+
+	for (const auto scale : { 0.95f, 0.9f, 0.8f, 0.7f, 0.6f, 0.5f, 0.4f, 0.3f }) {
+		const auto box_extents = extents * scale;
+		bool crossed = false;
+		for (u64 i = 0; i + 2 < indices.size() && !crossed; i += 3)
+			crossed = triangle_overlaps_box(positions[indices[i]] - center, positions[indices[i + 1]] - center, positions[indices[i + 2]] - center, box_extents);
+		if (crossed)
+			continue;
+
+		auto occluder = std::make_unique<Occluder>();
+		const AABB box{ center - box_extents, center + box_extents };
+		for (u32 i = 0; i < 8; i++)
+			occluder->positions.push_back(box.get_corner(i));
+		// two triangles per face, corner bit 0 is x, bit 1 y, bit 2 z
+		occluder->indices = {
+			0, 2, 6, 0, 6, 4,  1, 5, 7, 1, 7, 3,
+			0, 4, 5, 0, 5, 1,  2, 3, 7, 2, 7, 6,
+			0, 1, 3, 0, 3, 2,  4, 6, 7, 4, 7, 5,
+		};
+		return occluder;
+	}
+
+	return nullptr;
+}
+
+OcclusionCuller::OcclusionCuller()
+	: m_view_projection(1.0f)
+{
+	for (u32 width = WIDTH, height = HEIGHT; ; width = std::max(width / 2, 1u), height = std::max(height / 2, 1u)) {
+		m_levels.push_back({ width, height, std::vector<f32>((u64)width * height, 1.0f) });
+		if (width == 1 && height == 1)
+			break;
+	}
+}
+
+void OcclusionCuller::begin(const glm::mat4& view_projection)
+{
+	m_view_projection = view_projection;
+	m_occluders.clear();
+	m_stats = {};
+
+	for (auto& level : m_levels)
+		std::fill(level.depth.begin(), level.depth.end(), 1.0f);
+}
+
+void OcclusionCuller::add_occluder(const Occluder* occluder, const glm::mat4& model, const AABB& world_bounds)
+{
+	glm::vec3 min, max;
+	if (!occluder || !project(world_bounds, min, max))
+		return;
+
+	const auto size = glm::max(max - min, glm::vec3(0.0f));
+	m_occluders.push_back({ occluder, model, size.x * size.y });
+}
+
+void OcclusionCuller::rasterize()
+{
+	if (m_occluders.size() > MAX_OCCLUDERS) {
+		std::partial_sort(m_occluders.begin(), m_occluders.begin() + MAX_OCCLUDERS, m_occluders.end(), [](const QueuedOccluder& a, const QueuedOccluder& b) {
+			return a.area > b.area;
+		});
+		m_occluders.resize(MAX_OCCLUDERS);
+	}
+
+	setup_triangles();
+
+	// bands own disjoint rows of the depth buffer, no synchronization needed
+	JobSystem::get()->parallel_for(HEIGHT / BAND_HEIGHT, 1, [&](u32 begin, u32 end) {
+		for (u32 band = begin; band < end; band++)
+			rasterize_band(band);
+	});
+
+	build_pyramid();
+
+	m_stats.occluders = (u32)m_occluders.size();
+	m_stats.triangles = (u32)m_triangles.size();
+}
+
+void OcclusionCuller::setup_triangles()
+{
+	m_triangles.clear();
+
+	for (const auto& queued : m_occluders) {
+		const auto transform = m_view_projection * queued.model;
+		const auto& positions = queued.occluder->positions;
+		const auto& indices = queued.occluder->indices;
+
+		for (u64 i = 0; i + 2 < indices.size(); i += 3) {
+			ScreenTriangle triangle;
+			bool behind = false;
+
+			for (u32 j = 0; j < 3; j++) {
+				const auto clip = transform * glm::vec4(positions[indices[i + j]], 1.0f);
+				// no near plane clipping: dropping an occluder triangle is always conservative
+				if (clip.w < MIN_W) {
+					behind = true;
+					break;
+				}
+
+				const auto ndc = glm::vec3(clip) / clip.w;
+				triangle.v[j] = glm::vec3((ndc.x * 0.5f + 0.5f) * WIDTH, (ndc.y * 0.5f + 0.5f) * HEIGHT, ndc.z * 0.5f + 0.5f);
+			}
+
+			if (behind)
+				continue;
+
+			// counter clockwise winding so every edge function is positive inside
+			const auto& a = triangle.v[0];
+			const auto& b = triangle.v[1];
+			const auto& c = triangle.v[2];
+			const auto area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+			if (area == 0.0f)
+				continue;
+			if (area < 0.0f)
+				std::swap(triangle.v[1], triangle.v[2]);
+
+			triangle.min_y = glm::min(a.y, glm::min(b.y, c.y));
+			triangle.max_y = glm::max(a.y, glm::max(b.y, c.y));
+			if (triangle.max_y < 0.0f || triangle.min_y > (f32)HEIGHT)
+				continue;
+
+			m_triangles.push_back(triangle);
+		}
+	}
+}
+
+void OcclusionCuller::rasterize_band(u32 band)
+{
+	auto& depth = m_levels[0].depth;
+	const i32 band_min_y = band * BAND_HEIGHT;
+	const i32 band_max_y = band_min_y + BAND_HEIGHT - 1;
+
+	for (const auto& triangle : m_triangles) {
+		if (triangle.max_y < (f32)band_min_y || triangle.min_y > (f32)(band_max_y + 1))
+			continue;
+
+		const auto& v0 = triangle.v[0];
+		const auto& v1 = triangle.v[1];
+		const auto& v2 = triangle.v[2];
+
+		// pixel centers covered by the bounding box, x aligned to the simd width
+		const i32 min_x = std::max((i32)glm::floor(glm::min(v0.x, glm::min(v1.x, v2.x))), 0) & ~3;
+		const i32 max_x = std::min((i32)glm::ceil(glm::max(v0.x, glm::max(v1.x, v2.x))), (i32)WIDTH - 1);
+		const i32 min_y = std::max((i32)glm::floor(triangle.min_y), band_min_y);
+		const i32 max_y = std::min((i32)glm::ceil(triangle.max_y), band_max_y);
+		if (min_x > max_x || min_y > max_y)
+			continue;
+
+		// edge function i is zero on the edge opposite vertex i, e(x, y) = a * x + b * y + c
+		const f32 a0 = v1.y - v2.y, b0 = v2.x - v1.x, c0 = v1.x * v2.y - v1.y * v2.x;
+		const f32 a1 = v2.y - v0.y, b1 = v0.x - v2.x, c1 = v2.x * v0.y - v2.y * v0.x;
+		const f32 a2 = v0.y - v1.y, b2 = v1.x - v0.x, c2 = v0.x * v1.y - v0.y * v1.x;
+		const f32 inv_area = 1.0f / (c0 + c1 + c2);
+
+		// depth is linear in screen space: z = zx * x + zy * y + zc
+		const f32 zx = (a0 * v0.z + a1 * v1.z + a2 * v2.z) * inv_area;
+		const f32 zy = (b0 * v0.z + b1 * v1.z + b2 * v2.z) * inv_area;
+		const f32 zc = (c0 * v0.z + c1 * v1.z + c2 * v2.z) * inv_area;
+
+		for (i32 y = min_y; y <= max_y; y++) {
+			const f32 py = (f32)y + 0.5f;
+			f32* row = depth.data() + (u64)y * WIDTH;
+
+#if OCCLUSION_SIMD
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+			for (i32 x = min_x; x <= max_x; x += 4) {
+				const __m128 px = _mm_add_ps(_mm_set1_ps((f32)x), lane);
+
+				const __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a0), px), _mm_set1_ps(b0 * py + c0));
+				const __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a1), px), _mm_set1_ps(b1 * py + c1));
+				const __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a2), px), _mm_set1_ps(b2 * py + c2));
+				const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+				if (_mm_movemask_ps(inside) == 0)
+					continue;
+
+				const __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zx), px), _mm_set1_ps(zy * py + zc));
+				const __m128 current = _mm_loadu_ps(row + x);
+				const __m128 nearest = _mm_min_ps(current, z);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+			}
+#else
+			for (i32 x = min_x; x <= max_x; x++) {
+				const f32 px = (f32)x + 0.5f;
+				if (a0 * px + b0 * py + c0 < 0.0f || a1 * px + b1 * py + c1 < 0.0f || a2 * px + b2 * py + c2 < 0.0f)
+					continue;
+
+				row[x] = glm::min(row[x], zx * px + zy * py + zc);
+			}
+#endif
+		}
+	}
+}
+
+void OcclusionCuller::build_pyramid()
+{
+	// every texel keeps the farthest depth of the 2x2 block below it
+	for (u64 i = 1; i < m_levels.size(); i++) {
+		const auto& src = m_levels[i - 1];
+		auto& dst = m_levels[i];
+
+		for (u32 y = 0; y < dst.height; y++) {
+			const auto y0 = std::min(y * 2, src.height - 1);
+			const auto y1 = std::min(y * 2 + 1, src.height - 1);
+			for (u32 x = 0; x < dst.width; x++) {
+				const auto x0 = std::min(x * 2, src.width - 1);
+				const auto x1 = std::min(x * 2 + 1, src.width - 1);
+				dst.depth[(u64)y * dst.width + x] = glm::max(
+					glm::max(src.depth[(u64)y0 * src.width + x0], src.depth[(u64)y0 * src.width + x1]),
+					glm::max(src.depth[(u64)y1 * src.width + x0], src.depth[(u64)y1 * src.width + x1]));
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::project(const AABB& box, glm::vec3& min, glm::vec3& max) const
+{
+	min = glm::vec3(FLT_MAX);
+	max = glm::vec3(-FLT_MAX);
+
+	for (u32 i = 0; i < 8; i++) {
+		const auto clip = m_view_projection * glm::vec4(box.get_corner(i), 1.0f);
+		if (clip.w < MIN_W)
+			return false;
+
+		const auto ndc = glm::vec3(clip) / clip.w;
+		const auto screen = glm::vec3((ndc.x * 0.5f + 0.5f) * WIDTH, (ndc.y * 0.5f + 0.5f) * HEIGHT, ndc.z * 0.5f + 0.5f);
+		min = glm::min(min, screen);
+		max = glm::max(max, screen);
+	}
+
+	return true;
+}
+
+bool OcclusionCuller::is_visible(const AABB& box)
+{
+	m_stats.tested++;
+
+	glm::vec3 min, max;
+	// boxes crossing the eye plane are always visible
+	if (!project(box, min, max) || min.z <= 0.0f)
+		return true;
+
+	const i32 x0 = std::max((i32)glm::floor(min.x), 0);
+	const i32 y0 = std::max((i32)glm::floor(min.y), 0);
+	const i32 x1 = std::min((i32)glm::floor(max.x), (i32)WIDTH - 1);
+	const i32 y1 = std::min((i32)glm::floor(max.y), (i32)HEIGHT - 1);
+	if (x0 > x1 || y0 > y1)
+		return true;
+
+	// coarsest level where the rectangle spans at most a few texels per axis
+	u32 level = 0;
+	while (level + 1 < m_levels.size() && (std::max(x1 - x0, y1 - y0) >> level) > 3)
+		level++;
+
+	const auto& mip = m_levels[level];
+	for (i32 y = y0 >> level; y <= (y1 >> level); y++) {
+		for (i32 x = x0 >> level; x <= (x1 >> level); x++) {
+			if (min.z <= mip.depth[(u64)y * mip.width + x])
+				return true;
+		}
+	}
+
+	m_stats.occluded++;
+	return false;
+}
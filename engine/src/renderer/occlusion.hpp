@@ -0,0 +1,90 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <glm/glm/glm.hpp>
+
+#include <defines.hpp>
+#include <scene/bounds.hpp>
+
+// low poly geometry rasterized as an occluder, kept on the cpu at import
+struct Occluder {
+	std::vector<glm::vec3> positions;
+	std::vector<u32> indices;
+
+	// proxy of a mesh too detailed to rasterize: the largest scaled down copy of its bounding
+	// box that lies entirely inside the mesh, nullptr when none does (open or hollow meshes)
+	static std::unique_ptr<Occluder> create_inner_box(const std::vector<glm::vec3>& positions, const std::vector<u32>& indices);
+};
+
+struct OcclusionStats {
+	u32 occluders = 0;
+	u32 triangles = 0;
+	u32 tested = 0;
+	u32 occluded = 0;
+};
+
+//
+// Software occlusion culling, entirely on the cpu so nothing waits on a gpu readback.
+// The largest occluders on screen are rasterized into a low resolution depth buffer
+// (4 pixels per SSE step, one horizontal band per thread), which is then reduced into a
+// max depth pyramid. An occludee is hidden when the nearest point of its box is farther
+// than everything already drawn over the screen rectangle it covers.
+// Depth is NDC z remapped to [0, 1], 1 being the far plane.
+//
+class OcclusionCuller {
+public:
+	static const u32 WIDTH = 256;
+	static const u32 HEIGHT = 128;
+	static const u32 BAND_HEIGHT = 16;
+	// only the occluders covering the most screen area are rasterized
+	static const u32 MAX_OCCLUDERS = 32;
+
+	OcclusionCuller();
+
+	// clears the depth buffer and forgets last frame's occluders
+	void begin(const glm::mat4& view_projection);
+
+	// queues an occluder, `world_bounds` ranks it against the others
+	void add_occluder(const Occluder* occluder, const glm::mat4& model, const AABB& world_bounds);
+
+	// rasterizes the queued occluders and builds the depth pyramid
+	void rasterize();
+
+	// false when the box is hidden behind the rasterized occluders
+	bool is_visible(const AABB& box);
+
+	// depth of mip 0, WIDTH * HEIGHT row major, row 0 at the bottom of the screen
+	const std::vector<f32>& get_depth() const { return m_levels[0].depth; }
+	const OcclusionStats& get_stats() const { return m_stats; }
+
+private:
+	struct QueuedOccluder {
+		const Occluder* occluder;
+		glm::mat4 model;
+		f32 area;
+	};
+
+	struct ScreenTriangle {
+		glm::vec3 v[3];
+		f32 min_y, max_y;
+	};
+
+	struct Level {
+		u32 width, height;
+		std::vector<f32> depth;
+	};
+
+	glm::mat4 m_view_projection;
+	std::vector<QueuedOccluder> m_occluders;
+	std::vector<ScreenTriangle> m_triangles;
+	std::vector<Level> m_levels;
+	OcclusionStats m_stats;
+
+	void setup_triangles();
+	void rasterize_band(u32 band);
+	void build_pyramid();
+
+	// projects the 8 corners, returns false if any lies behind the eye
+	bool project(const AABB& box, glm::vec3& min, glm::vec3& max) const;
+};
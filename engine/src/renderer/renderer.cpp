@@ -9,17 +9,17 @@
 #include <engine.hpp>
 
 Renderer::Renderer() {
-	// initialize camera matrices and uniform buffer
+	// initialize camera matrices and the ring they are written to every frame
 	m_view_matrices = std::make_shared<ViewMatrices>();
-	UniformBufferSpecification spec = {};
-	spec.index = 0;
-	spec.size = sizeof(ViewMatrices);
-	spec.usage = GL_DYNAMIC_DRAW;
-	m_view_ub = std::make_shared<UniformBuffer>(spec);
+	m_uniform_ring = RingBuffer::create(GL_UNIFORM_BUFFER, UNIFORM_RING_SIZE);
+	m_frame_timer = GpuTimer::create();
 
 	// initialize screen quad
 	init_screen_quad();
 
+	// shared mesh buffers, must exist before any model is loaded
+	init_geometry_pool();
+
 	// initialize default pbr textures
 	// TODO: this should be in a material system type class
 	// but it's enough for current purposes
@@ -41,6 +41,18 @@ void Renderer::initialize() {
 	init_lighting_pass();
 }
 
+void Renderer::init_geometry_pool()
+{
+	// every mesh is loaded in this format, see Mesh::Mesh
+	auto layout = VertexLayout::create();
+	layout->push<f32>("position", 3);
+	layout->push<f32>("normal", 3);
+	layout->push<f32>("texcoord", 2);
+	layout->push<f32>("tangent", 3);
+	layout->push<f32>("bitangent", 3);
+	m_geometry_pool = GeometryPool::create(layout);
+}
+
 void Renderer::init_default_pbr_material()
 {
 	auto albedo_path = ResourceState::get()->getTexturePath("default_albedo.png").string();
@@ -102,93 +114,47 @@ void Renderer::init_default_pbr_material()
 }
 
 void Renderer::init_gbuffer() {
-	//
-	// create the 4 gbuffer textures
-	//
-	std::vector<std::shared_ptr<Texture>> color_attachements;
-	TextureSpecification spec{};
-	spec.width = 1920;
-	spec.height = 1080;
-
-	// 1. albedo (HDR)
-	spec.internalFormat = GL_RGBA16F;
-	spec.slot = 0;
-	color_attachements.push_back(Texture::create(spec));
-
-	// 2. normals (HDR)
-	spec.internalFormat = GL_RGBA16F;
-	spec.slot = 1;
-	color_attachements.push_back(Texture::create(spec));
-
-	// 3. mra (r-ambient occlusion, g-roughness, b-metallic)
-	spec.internalFormat = GL_RGBA16F;
-	spec.slot = 2;
-	color_attachements.push_back(Texture::create(spec));
-
-	// 4. emissive (HDR)
-	spec.internalFormat = GL_RGBA16F;
-	spec.slot = 3;
-	color_attachements.push_back(Texture::create(spec));
-
-	// 5. position (HDR for precision)
-	spec.internalFormat = GL_RGBA16F;
-	spec.slot = 4;
-	color_attachements.push_back(Texture::create(spec));
-
-	//
-	FramebufferSpecification frame_spec{};
-	frame_spec.clear_color = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
-	frame_spec.color_attachements = color_attachements;
-	frame_spec.depth_stencil = true;
-	frame_spec.width = 1920;
-	frame_spec.height = 1080;
-
-	m_gbuffer = std::make_unique<GBuffer>(frame_spec);	// create gbuffer
-
-	// set shader
+	// the gbuffer targets are transient, declared every frame in the frame graph (GBuffer::declare)
 	m_shaders["gbuffer"] = ShaderProgram::create("gbuffer.vert", "gbuffer.frag");
-	m_gbuffer->m_shader = m_shaders["gbuffer"];
-
+	m_gbuffer = std::make_unique<GBuffer>(m_shaders["gbuffer"]);
 }
 
 void Renderer::init_lighting_pass() {
 	auto shader = ShaderProgram::create("deferred_lighting.vert", "deferred_lighting.frag");
 	m_shaders["deferred_lighting"] = shader;
 
-	TextureSpecification spec{};
-	spec.width = 1920;
-	spec.height = 1080;
-	spec.internalFormat = GL_RGBA16F;
-	spec.slot = 0;
-	auto texture = Texture::create(spec);
-
-	FramebufferSpecification frame_spec{};
-	frame_spec.clear_color = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
-	frame_spec.color_attachements = { texture };
-	frame_spec.depth_stencil = false;
-	frame_spec.width = 1920;
-	frame_spec.height = 1080;
-	
-	m_lighting_pass = std::make_unique<LightingPass>(frame_spec, shader, m_gbuffer->m_outputs, m_ibl, m_shadow_map_pass.get());
+	m_lighting_pass = std::make_unique<LightingPass>(shader, m_ibl, m_shadow_map_pass.get(), &m_light_clusters);
 }
 
 void Renderer::init_shadowmap_pass() {
 	auto shader = ShaderProgram::create("shadow_map.vert", "shadow_map.frag");
 	m_shaders["shadow_map"] = shader;
-
-	FramebufferSpecification frame_spec{};
-	frame_spec.clear_color = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
-	frame_spec.color_attachements = {};
-	frame_spec.depth_stencil = false;
-
-	m_shadow_map_pass = std::make_unique<ShadowMapPass>(frame_spec, shader);
+	auto mark_shader = ShaderProgram::create_compute("mark_pages.comp");
+	m_shaders["mark_pages"] = mark_shader;
+	auto moments_shader = ShaderProgram::create("deferred_lighting.vert", "shadow_moments.frag");
+	m_shaders["shadow_moments"] = moments_shader;
+	auto blur_shader = ShaderProgram::create("deferred_lighting.vert", "shadow_blur.frag");
+	m_shaders["shadow_blur"] = blur_shader;
+
+	m_shadow_map_pass = std::make_unique<ShadowMapPass>(shader, mark_shader, moments_shader, blur_shader);
 }
 
 void Renderer::update_view(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& eye_pos) {
 	m_view_matrices->view = view;
 	m_view_matrices->projection = projection;
 	m_view_matrices->eye_position = eye_pos;
-	m_view_ub->update(m_view_matrices.get(), sizeof(ViewMatrices));
+
+	const auto offset = m_uniform_ring->write(m_view_matrices.get(), sizeof(ViewMatrices));
+	if (offset != RingBuffer::INVALID_OFFSET)
+		m_uniform_ring->bind_range(VIEW_BINDING, offset, sizeof(ViewMatrices));
+}
+
+void Renderer::begin_frame() {
+	m_uniform_ring->begin_frame();
+}
+
+void Renderer::end_frame() {
+	m_uniform_ring->end_frame();
 }
 
 std::shared_ptr<ShaderProgram> Renderer::get_shader(const std::string& name) {
@@ -257,7 +223,7 @@ void Renderer::init_screen_quad()
 	m_screen_vao = std::make_unique<VertexArray>(vao_spec);
 }
 
-void Renderer::render_screen_framebuffer(const std::shared_ptr<Framebuffer>& framebuffer, u32 width, u32 height)
+void Renderer::render_screen_framebuffer(const std::shared_ptr<Texture>& texture)
 {
 	auto shader = get_shader("screen");
 
@@ -269,10 +235,10 @@ void Renderer::render_screen_framebuffer(const std::shared_ptr<Framebuffer>& fra
 	shader->set_float("max_span", max_span);
 
 	m_screen_vao->bind();
-	framebuffer->get_color_attachement(0)->bind();
-	framebuffer->get_color_attachement(1)->bind();
-	shader->set_float("inverse_width", 1.0f / width);
-	shader->set_float("inverse_height", 1.0f / height);
+	// the texture may be rendered below window size, sampling it across the window is the upscale
+	texture->bind(0);
+	shader->set_float("inverse_width", 1.0f / texture->get_width());
+	shader->set_float("inverse_height", 1.0f / texture->get_height());
 	glDrawElements(GL_TRIANGLES, m_screen_ibo->get_count(), GL_UNSIGNED_INT, nullptr);
 	m_screen_vao->unbind();
 	shader->unbind();
@@ -331,5 +297,16 @@ std::shared_ptr<PbrMaterial> Renderer::get_pbr(const std::string& name) const {
 }
 
 void Renderer::add_pbr(const std::string& name, std::shared_ptr<PbrMaterial> material) {
+	m_material_table.add(*material);
 	m_pbr_materials[name] = material;
 }
+
+std::shared_ptr<Model> Renderer::get_model(const std::string& name) const {
+	auto model = m_models.find(name);
+	if (model == m_models.end()) return nullptr;
+	return model->second;
+}
+
+void Renderer::add_model(const std::string& name, std::shared_ptr<Model> model) {
+	m_models[name] = model;
+}
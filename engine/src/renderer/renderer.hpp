@@ -12,6 +12,17 @@
 #include "resources/framebuffer.hpp"
 #include "material.hpp"
 #include "gbuffer.hpp"
+#include "instancing.hpp"
+#include "command_buffer.hpp"
+#include "geometry_pool.hpp"
+#include "material_table.hpp"
+#include "frame_graph.hpp"
+#include "resources/ring_buffer.hpp"
+#include "resources/gpu_timer.hpp"
+#include "dynamic_resolution.hpp"
+#include "light_clusters.hpp"
+
+class Model;
 
 class Renderer {
 public:
@@ -19,12 +30,22 @@ public:
 		return std::make_unique<Renderer>();
 	}
 
+	// uniform block bindings fed from the uniform ring
+	static const u32 VIEW_BINDING = 0;
+	static const u32 UNIFORM_RING_SIZE = 256 * 1024;
+
 	Renderer();
 	void initialize();
 
+	// per frame dynamic data is written to the next region of the uniform ring
+	void begin_frame();
+	void end_frame();
+
 	void update_view(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& eye_pos);
+	RingBuffer* get_uniform_ring() { return m_uniform_ring.get(); }
 
-	void render_screen_framebuffer(const std::shared_ptr<Framebuffer>& framebuffer, u32 width, u32 height);
+	// tone maps `texture` into the bound framebuffer
+	void render_screen_framebuffer(const std::shared_ptr<Texture>& texture);
 
 	void invalidate_shaders();
 	void render_debug_menu();
@@ -33,16 +54,36 @@ public:
 	void add_texture(const std::string& path, std::shared_ptr<Texture> texture);
 	std::shared_ptr<PbrMaterial> get_pbr(const std::string& name) const;
 	void add_pbr(const std::string& name, std::shared_ptr<PbrMaterial> material);
+	std::shared_ptr<Model> get_model(const std::string& name) const;
+	void add_model(const std::string& name, std::shared_ptr<Model> model);
 
 	std::unique_ptr<GBuffer>& get_gbuffer() { return m_gbuffer; }
 	LightingPass* get_light_pass() { return m_lighting_pass.get(); }
 	ShadowMapPass* get_shadow_map_pass() { return m_shadow_map_pass.get(); }
+	InstanceBatcher& get_instance_batcher() { return m_instance_batcher; }
+	OcclusionCuller& get_occlusion_culler() { return m_occlusion_culler; }
+	RenderQueue& get_render_queue() { return m_render_queue; }
+	GeometryPool* get_geometry_pool() { return m_geometry_pool.get(); }
+	MaterialTable& get_material_table() { return m_material_table; }
+	FrameGraph& get_frame_graph() { return m_frame_graph; }
+	LightClusters& get_light_clusters() { return m_light_clusters; }
+	GpuTimer* get_frame_timer() { return m_frame_timer.get(); }
+	DynamicResolution& get_dynamic_resolution() { return m_dynamic_resolution; }
 
 	void inc_render_stats_triangles(u64 amount) {
 		triangles_rendered += amount;
 	}
+	void inc_render_stats_draw_calls(u64 amount) {
+		draw_calls += amount;
+	}
+	void inc_render_stats_state_changes(u64 amount) {
+		state_changes += amount;
+	}
 	u64 get_rendered_triangles() { return triangles_rendered; }
+	u64 get_draw_calls() { return draw_calls; }
+	u64 get_state_changes() { return state_changes; }
 	void reset_rendered_triangles() { triangles_rendered = 0; }
+	void reset_render_stats() { triangles_rendered = 0; draw_calls = 0; state_changes = 0; }
 
 	std::unique_ptr<VertexArray> m_screen_vao;
 	std::shared_ptr<GlBuffer> m_screen_vbo;
@@ -54,19 +95,30 @@ private:
 	std::unordered_map<std::string, std::shared_ptr<ShaderProgram>> m_shaders;
 	std::unordered_map<std::string, std::shared_ptr<Texture>> m_textures;
 	std::unordered_map<std::string, std::shared_ptr<PbrMaterial>> m_pbr_materials;
+	std::unordered_map<std::string, std::shared_ptr<Model>> m_models;
 
 	// render passes
 	std::unique_ptr<GBuffer> m_gbuffer;
 	std::unique_ptr<LightingPass> m_lighting_pass;
 	std::unique_ptr<ShadowMapPass> m_shadow_map_pass;
 
+	InstanceBatcher m_instance_batcher;
+	OcclusionCuller m_occlusion_culler;
+	RenderQueue m_render_queue;
+	std::unique_ptr<GeometryPool> m_geometry_pool;
+	MaterialTable m_material_table;
+	FrameGraph m_frame_graph;
+	LightClusters m_light_clusters;
+	std::unique_ptr<GpuTimer> m_frame_timer;
+	DynamicResolution m_dynamic_resolution;
+
 	struct ViewMatrices {
 		glm::mat4 view;
 		glm::mat4 projection;
 		glm::vec3 eye_position;
 	};
 	std::shared_ptr<ViewMatrices> m_view_matrices;
-	std::shared_ptr<UniformBuffer> m_view_ub;
+	std::unique_ptr<RingBuffer> m_uniform_ring;
 
 	// FXAA
 	float luma_threshold = 0.5f;
@@ -76,9 +128,12 @@ private:
 	bool use_fxaa = false;
 
 	u64 triangles_rendered = 0;
+	u64 draw_calls = 0;
+	u64 state_changes = 0;
 
 	// screen quad
 	void init_screen_quad();
+	void init_geometry_pool();
 	void init_default_pbr_material();
 	void init_gbuffer();
 	void init_lighting_pass();
@@ -25,7 +25,10 @@ public:
 
     void bind() override;
     void unbind() override;
-    void update(void* data, u32 count);
+    // writes `count` elements starting at element `offset`
+    void update(const void* data, u32 count, u32 offset = 0);
+    // copies the first `count` elements of `source`, used to grow a buffer
+    void copy_from(const GlBuffer& source, u32 count);
 
     u32 get_id() const { return m_id; }
     u32 get_count() const { return m_count; }
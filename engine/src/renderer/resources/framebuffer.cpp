@@ -1,13 +1,14 @@
 #include "framebuffer.hpp"
+#include "gl_state.hpp"
 #include <iostream>
 #include <format>
 #include <cassert>
 
 Framebuffer::Framebuffer(const FramebufferSpecification& spec)
-	: m_spec(spec), m_color_attachement_id(0)
+	: m_spec(spec), m_color_attachement_id(0), m_depth_stencil_renderbuffer(0)
 {
 	glGenFramebuffers(1, &m_id);
-	glBindFramebuffer(GL_FRAMEBUFFER, m_id);
+	GlState::get()->bind_framebuffer(GL_FRAMEBUFFER, m_id);
 
 
 	// create depth renderbuffer
@@ -21,17 +22,17 @@ Framebuffer::Framebuffer(const FramebufferSpecification& spec)
 		glBindRenderbuffer(GL_RENDERBUFFER, 0);
 	}
 
+	// depth attachments do not take a color slot
 	for (const auto& texture : m_spec.color_attachements) {
-		texture->bind_to_framebuffer(m_color_attachement_id++);
+		if (texture->get_spec().attachement_target == GL_COLOR_ATTACHMENT0)
+			texture->bind_to_framebuffer(m_color_attachement_id++);
+		else
+			texture->bind_to_framebuffer(0);
 	}
 
 	std::vector<u32> attachments;
-	for (int i = 0; i < m_color_attachement_id; i++) {
-		if (m_spec.color_attachements[i]->get_spec().attachement_target == GL_DEPTH_ATTACHMENT)
-			continue;
-
+	for (u32 i = 0; i < m_color_attachement_id; i++)
 		attachments.push_back(GL_COLOR_ATTACHMENT0 + i);
-	}
 
 	if (attachments.size() == 0.0f) {
 		glDrawBuffer(GL_NONE);
@@ -46,17 +47,25 @@ Framebuffer::Framebuffer(const FramebufferSpecification& spec)
 	}
 
 	// always unbind after creation
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GlState::get()->bind_framebuffer(GL_FRAMEBUFFER, 0);
+}
+
+Framebuffer::~Framebuffer()
+{
+	glDeleteFramebuffers(1, &m_id);
+	GlState::get()->on_framebuffer_deleted(m_id);
+	if (m_depth_stencil_renderbuffer)
+		glDeleteRenderbuffers(1, &m_depth_stencil_renderbuffer);
 }
 
 void Framebuffer::bind()
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, m_id);
+	GlState::get()->bind_framebuffer(GL_FRAMEBUFFER, m_id);
 }
 
 void Framebuffer::unbind()
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GlState::get()->bind_framebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Framebuffer::begin_pass()
@@ -74,9 +83,17 @@ std::shared_ptr<Texture> Framebuffer::get_color_attachement(u32 slot) const
 
 void Framebuffer::rescale(u32 width, u32 height)
 {
+	m_spec.width = width;
+	m_spec.height = height;
+
 	bind();
 	if (m_spec.depth_stencil) {
 		glBindRenderbuffer(GL_RENDERBUFFER, m_depth_stencil_renderbuffer);
 		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
 	}
+
+	// attachments keep their names, reallocating their storage is enough
+	for (const auto& texture : m_spec.color_attachements)
+		texture->resize(width, height);
 }
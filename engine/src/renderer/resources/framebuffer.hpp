@@ -20,6 +20,7 @@ public:
 	}
 
 	Framebuffer(const FramebufferSpecification& spec);
+	~Framebuffer();
 
 	void bind() override;
 	void unbind() override;
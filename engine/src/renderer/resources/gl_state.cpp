@@ -0,0 +1,229 @@
+#include "gl_state.hpp"
+
+#include "gl_errors.hpp"
+
+bool GlState::change(u32& cached, u32 value)
+{
+	if (cached == value) {
+		m_filtered++;
+		return false;
+	}
+
+	cached = value;
+	m_issued++;
+	return true;
+}
+
+void GlState::active_unit(u32 unit)
+{
+	if (change(m_active_unit, unit))
+		glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void GlState::use_program(u32 program)
+{
+	if (change(m_program, program))
+		GLCALL(glUseProgram(program));
+}
+
+void GlState::bind_vertex_array(u32 vao)
+{
+	if (change(m_vao, vao))
+		glBindVertexArray(vao);
+}
+
+void GlState::bind_buffer(GLenum target, u32 buffer)
+{
+	switch (target) {
+	case GL_ARRAY_BUFFER:
+		if (change(m_array_buffer, buffer))
+			glBindBuffer(target, buffer);
+		break;
+	case GL_UNIFORM_BUFFER:
+		if (change(m_uniform_buffer, buffer))
+			glBindBuffer(target, buffer);
+		break;
+	default:
+		// element array bindings live in the vao, they are not global state
+		glBindBuffer(target, buffer);
+		m_issued++;
+		break;
+	}
+}
+
+void GlState::bind_buffer_range(GLenum target, u32 index, u32 buffer, u32 offset, u32 size)
+{
+	if (target == GL_UNIFORM_BUFFER && index < MAX_UNIFORM_BINDINGS) {
+		auto& range = m_uniform_ranges[index];
+		if (range.buffer == buffer && range.offset == offset && range.size == size && m_uniform_buffer == buffer) {
+			m_filtered++;
+			return;
+		}
+
+		range = { buffer, offset, size };
+		m_uniform_buffer = buffer;
+	}
+
+	glBindBufferRange(target, index, buffer, offset, size);
+	m_issued++;
+}
+
+void GlState::bind_texture(u32 unit, GLenum target, u32 texture)
+{
+	u32 index = TARGET_COUNT;
+	switch (target) {
+	case GL_TEXTURE_2D: index = TARGET_2D; break;
+	case GL_TEXTURE_CUBE_MAP: index = TARGET_CUBE_MAP; break;
+	case GL_TEXTURE_2D_ARRAY: index = TARGET_2D_ARRAY; break;
+	}
+
+	if (unit < MAX_TEXTURE_UNITS && index < TARGET_COUNT) {
+		if (m_textures[unit][index] == texture) {
+			m_filtered++;
+			return;
+		}
+
+		m_textures[unit][index] = texture;
+	}
+
+	active_unit(unit);
+	GLCALL(glBindTexture(target, texture));
+	m_issued++;
+}
+
+void GlState::bind_texture(GLenum target, u32 texture)
+{
+	bind_texture(m_active_unit == UNKNOWN ? 0 : m_active_unit, target, texture);
+}
+
+void GlState::bind_framebuffer(GLenum target, u32 framebuffer)
+{
+	switch (target) {
+	case GL_READ_FRAMEBUFFER:
+		if (change(m_read_framebuffer, framebuffer))
+			glBindFramebuffer(target, framebuffer);
+		break;
+	case GL_DRAW_FRAMEBUFFER:
+		if (change(m_draw_framebuffer, framebuffer))
+			glBindFramebuffer(target, framebuffer);
+		break;
+	default:
+		if (m_read_framebuffer == framebuffer && m_draw_framebuffer == framebuffer) {
+			m_filtered++;
+			return;
+		}
+
+		m_read_framebuffer = m_draw_framebuffer = framebuffer;
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		m_issued++;
+		break;
+	}
+}
+
+void GlState::set_enabled(GLenum capability, bool enabled)
+{
+	u32 index = CAP_COUNT;
+	switch (capability) {
+	case GL_BLEND: index = CAP_BLEND; break;
+	case GL_DEPTH_TEST: index = CAP_DEPTH_TEST; break;
+	case GL_CULL_FACE: index = CAP_CULL_FACE; break;
+	}
+
+	if (index < CAP_COUNT && !change(m_capabilities[index], enabled ? 1 : 0))
+		return;
+	if (index == CAP_COUNT)
+		m_issued++;
+
+	if (enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+}
+
+void GlState::depth_func(GLenum func)
+{
+	if (change(m_depth_func, func))
+		glDepthFunc(func);
+}
+
+void GlState::cull_face(GLenum mode)
+{
+	if (change(m_cull_face, mode))
+		glCullFace(mode);
+}
+
+void GlState::blend_func(GLenum src, GLenum dst)
+{
+	if (m_blend_src == src && m_blend_dst == dst) {
+		m_filtered++;
+		return;
+	}
+
+	m_blend_src = src;
+	m_blend_dst = dst;
+	glBlendFunc(src, dst);
+	m_issued++;
+}
+
+void GlState::on_program_deleted(u32 program)
+{
+	// a deleted program stays in use until another one is, and its name may come back
+	if (m_program == program)
+		m_program = UNKNOWN;
+}
+
+void GlState::on_vertex_array_deleted(u32 vao)
+{
+	if (m_vao == vao)
+		m_vao = 0;
+}
+
+void GlState::on_buffer_deleted(u32 buffer)
+{
+	if (m_array_buffer == buffer)
+		m_array_buffer = 0;
+	if (m_uniform_buffer == buffer)
+		m_uniform_buffer = 0;
+	for (auto& range : m_uniform_ranges) {
+		if (range.buffer == buffer)
+			range = { UNKNOWN, 0, 0 };
+	}
+}
+
+void GlState::on_texture_deleted(u32 texture)
+{
+	for (auto& unit : m_textures) {
+		for (auto& bound : unit) {
+			if (bound == texture)
+				bound = 0;
+		}
+	}
+}
+
+void GlState::on_framebuffer_deleted(u32 framebuffer)
+{
+	if (m_read_framebuffer == framebuffer)
+		m_read_framebuffer = 0;
+	if (m_draw_framebuffer == framebuffer)
+		m_draw_framebuffer = 0;
+}
+
+void GlState::invalidate()
+{
+	m_program = UNKNOWN;
+	m_vao = UNKNOWN;
+	m_array_buffer = UNKNOWN;
+	m_uniform_buffer = UNKNOWN;
+	m_uniform_ranges.fill({ UNKNOWN, 0, 0 });
+	m_active_unit = UNKNOWN;
+	for (auto& unit : m_textures)
+		unit.fill(UNKNOWN);
+	m_read_framebuffer = UNKNOWN;
+	m_draw_framebuffer = UNKNOWN;
+
+	m_capabilities.fill(UNKNOWN);
+	m_depth_func = UNKNOWN;
+	m_cull_face = UNKNOWN;
+	m_blend_src = UNKNOWN;
+	m_blend_dst = UNKNOWN;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <glad/glad.h>
+
+#include <defines.hpp>
+
+//
+// Shadow copy of the GL state the renderer changes. Every resource class binds through it,
+// calls that would set the state to its current value are dropped before reaching the driver.
+// Only valid while nothing else touches GL behind its back, call invalidate() after
+// code that does (imgui, other contexts).
+//
+class GlState {
+public:
+	static const u32 MAX_TEXTURE_UNITS = 16;
+	static const u32 MAX_UNIFORM_BINDINGS = 16;
+
+	static GlState* get() { return _instance; }
+
+	// needs a current context, the cache starts unknown so the first call of each kind is issued
+	static void init() {
+		assert(_instance == nullptr);
+		_instance = new GlState();
+	}
+
+	void use_program(u32 program);
+	void bind_vertex_array(u32 vao);
+	// GL_ARRAY_BUFFER and GL_UNIFORM_BUFFER are cached, other targets are passed through
+	void bind_buffer(GLenum target, u32 buffer);
+	// indexed binding, also sets the generic binding of `target` like GL does
+	void bind_buffer_range(GLenum target, u32 index, u32 buffer, u32 offset, u32 size);
+	void bind_texture(u32 unit, GLenum target, u32 texture);
+	// binds on the active unit, used when creating or updating a texture
+	void bind_texture(GLenum target, u32 texture);
+	// GL_FRAMEBUFFER sets both the read and draw binding
+	void bind_framebuffer(GLenum target, u32 framebuffer);
+
+	// GL_BLEND, GL_DEPTH_TEST and GL_CULL_FACE are cached, other capabilities are passed through
+	void set_enabled(GLenum capability, bool enabled);
+	void enable(GLenum capability) { set_enabled(capability, true); }
+	void disable(GLenum capability) { set_enabled(capability, false); }
+	void depth_func(GLenum func);
+	void cull_face(GLenum mode);
+	void blend_func(GLenum src, GLenum dst);
+
+	// deleted objects are unbound by GL and their names can be reused
+	void on_program_deleted(u32 program);
+	void on_vertex_array_deleted(u32 vao);
+	void on_buffer_deleted(u32 buffer);
+	void on_texture_deleted(u32 texture);
+	void on_framebuffer_deleted(u32 framebuffer);
+
+	// forget everything, the next call of each kind is issued again
+	void invalidate();
+
+	u64 get_issued_calls() const { return m_issued; }
+	u64 get_filtered_calls() const { return m_filtered; }
+	void reset_stats() { m_issued = 0; m_filtered = 0; }
+
+private:
+	static constexpr u32 UNKNOWN = ~0u;
+
+	// cached texture targets per unit
+	enum TextureTarget : u32 {
+		TARGET_2D = 0,
+		TARGET_CUBE_MAP,
+		TARGET_2D_ARRAY,
+		TARGET_COUNT
+	};
+
+	enum Capability : u32 {
+		CAP_BLEND = 0,
+		CAP_DEPTH_TEST,
+		CAP_CULL_FACE,
+		CAP_COUNT
+	};
+
+	GlState() { invalidate(); }
+
+	u32 m_program;
+	u32 m_vao;
+	u32 m_array_buffer;
+	u32 m_uniform_buffer;
+	struct BufferRange {
+		u32 buffer;
+		u32 offset;
+		u32 size;
+	};
+	std::array<BufferRange, MAX_UNIFORM_BINDINGS> m_uniform_ranges;
+	u32 m_active_unit;
+	std::array<std::array<u32, TARGET_COUNT>, MAX_TEXTURE_UNITS> m_textures;
+	u32 m_read_framebuffer;
+	u32 m_draw_framebuffer;
+
+	std::array<u32, CAP_COUNT> m_capabilities;
+	u32 m_depth_func;
+	u32 m_cull_face;
+	u32 m_blend_src;
+	u32 m_blend_dst;
+
+	u64 m_issued = 0;
+	u64 m_filtered = 0;
+
+	// true when the call has to reach the driver, updates the cached value
+	bool change(u32& cached, u32 value);
+	void active_unit(u32 unit);
+
+	static inline GlState* _instance = nullptr;
+};
@@ -0,0 +1,36 @@
+#include "gpu_timer.hpp"
+
+GpuTimer::GpuTimer()
+{
+	glGenQueries(FRAMES, m_queries.data());
+}
+
+GpuTimer::~GpuTimer()
+{
+	glDeleteQueries(FRAMES, m_queries.data());
+}
+
+void GpuTimer::begin()
+{
+	m_frame = (m_frame + 1) % FRAMES;
+
+	// the oldest query is reused, take its result if the gpu got to it
+	if (m_pending[m_frame]) {
+		i32 available = 0;
+		glGetQueryObjectiv(m_queries[m_frame], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available) {
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(m_queries[m_frame], GL_QUERY_RESULT, &nanoseconds);
+			m_milliseconds = (f32)(nanoseconds / 1.0e6);
+		}
+	}
+
+	// a result still pending is dropped, restarting the query discards it
+	glBeginQuery(GL_TIME_ELAPSED, m_queries[m_frame]);
+}
+
+void GpuTimer::end()
+{
+	glEndQuery(GL_TIME_ELAPSED);
+	m_pending[m_frame] = true;
+}
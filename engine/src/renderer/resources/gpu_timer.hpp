@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <glad/glad.h>
+
+#include <defines.hpp>
+
+//
+// Measures gpu time between begin() and end() with GL_TIME_ELAPSED queries. Results
+// arrive a few frames late, each frame uses its own query from a ring of FRAMES so
+// reading one never waits on the gpu; a frame whose query is still pending keeps
+// the previous result.
+//
+class KAPI GpuTimer {
+public:
+	static const u32 FRAMES = 4;
+
+	static std::unique_ptr<GpuTimer> create() {
+		return std::make_unique<GpuTimer>();
+	}
+
+	GpuTimer();
+	~GpuTimer();
+
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer& operator=(const GpuTimer&) = delete;
+
+	// time elapsed queries can not nest, only one timer may be running at a time
+	void begin();
+	void end();
+
+	// latest available measurement in milliseconds, 0 until the first one arrives
+	f32 get_milliseconds() const { return m_milliseconds; }
+
+private:
+	std::array<u32, FRAMES> m_queries{};
+	std::array<bool, FRAMES> m_pending{};
+	u32 m_frame = 0;
+	f32 m_milliseconds = 0.0f;
+};
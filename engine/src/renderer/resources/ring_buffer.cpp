@@ -0,0 +1,120 @@
+#include "ring_buffer.hpp"
+
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <format>
+
+#include "gl_state.hpp"
+#include "gl_errors.hpp"
+
+RingBuffer::RingBuffer(GLenum target, u32 frame_size)
+	: m_target(target)
+{
+	GLint alignment = 1;
+	if (target == GL_UNIFORM_BUFFER)
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	else if (target == GL_SHADER_STORAGE_BUFFER)
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	m_alignment = (u32)std::max(alignment, 1);
+
+	// regions start aligned as well
+	m_frame_size = (frame_size + m_alignment - 1) / m_alignment * m_alignment;
+	const auto size = (GLsizeiptr)m_frame_size * FRAMES;
+
+	glGenBuffers(1, &m_id);
+	GlState::get()->bind_buffer(m_target, m_id);
+
+	if (GLAD_GL_VERSION_4_4) {
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		GLCALL(glBufferStorage(m_target, size, nullptr, flags));
+		m_mapped = (u8*)glMapBufferRange(m_target, 0, size, flags);
+	}
+	else {
+		glBufferData(m_target, size, nullptr, GL_DYNAMIC_DRAW);
+	}
+
+	GlState::get()->bind_buffer(m_target, 0);
+}
+
+RingBuffer::~RingBuffer()
+{
+	for (auto fence : m_fences) {
+		if (fence)
+			glDeleteSync(fence);
+	}
+
+	if (m_mapped) {
+		GlState::get()->bind_buffer(m_target, m_id);
+		glUnmapBuffer(m_target);
+	}
+
+	glDeleteBuffers(1, &m_id);
+	GlState::get()->on_buffer_deleted(m_id);
+}
+
+void RingBuffer::begin_frame()
+{
+	m_frame = (m_frame + 1) % FRAMES;
+	m_offset = 0;
+
+	auto& fence = m_fences[m_frame];
+	if (!fence)
+		return;
+
+	// usually signaled already, the region was submitted FRAMES - 1 frames ago
+	auto result = glClientWaitSync(fence, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED) {
+		m_stalls++;
+		do {
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		} while (result == GL_TIMEOUT_EXPIRED);
+	}
+
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+void RingBuffer::end_frame()
+{
+	auto& fence = m_fences[m_frame];
+	if (fence)
+		glDeleteSync(fence);
+
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+u32 RingBuffer::write(const void* data, u32 size)
+{
+	if (m_offset + size > m_frame_size) {
+		KERROR("Ring buffer region of {} bytes is full", m_frame_size);
+		return INVALID_OFFSET;
+	}
+
+	const auto offset = m_frame * m_frame_size + m_offset;
+	if (m_mapped) {
+		std::memcpy(m_mapped + offset, data, size);
+	}
+	else {
+		GlState::get()->bind_buffer(m_target, m_id);
+		glBufferSubData(m_target, offset, size, data);
+	}
+
+	m_offset = (m_offset + size + m_alignment - 1) / m_alignment * m_alignment;
+	return offset;
+}
+
+void RingBuffer::bind_range(u32 index, u32 offset, u32 size) const
+{
+	GlState::get()->bind_buffer_range(m_target, index, m_id, offset, size);
+}
+
+void RingBuffer::bind()
+{
+	GlState::get()->bind_buffer(m_target, m_id);
+}
+
+void RingBuffer::unbind()
+{
+	GlState::get()->bind_buffer(m_target, 0);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <glad/glad.h>
+
+#include <defines.hpp>
+#include "bindable.hpp"
+
+//
+// Buffer for data written every frame (view constants, per draw constants). It is split
+// in FRAMES regions used round robin, the cpu writes the current region while the gpu may
+// still read the previous ones. A fence per region makes begin_frame() wait only when
+// the gpu is more than FRAMES - 1 frames behind.
+// With GL 4.4 the storage is immutable and persistently mapped, writes are plain memcpys.
+// On older contexts the region is updated with glBufferSubData instead.
+//
+class KAPI RingBuffer : Bindable {
+public:
+	static const u32 FRAMES = 3;
+	static const u32 INVALID_OFFSET = ~0u;
+
+	static std::unique_ptr<RingBuffer> create(GLenum target, u32 frame_size) {
+		return std::make_unique<RingBuffer>(target, frame_size);
+	}
+
+	RingBuffer(GLenum target, u32 frame_size);
+	~RingBuffer();
+
+	RingBuffer(const RingBuffer&) = delete;
+	RingBuffer& operator=(const RingBuffer&) = delete;
+
+	// moves to the next region, waiting for the gpu to be done with it
+	void begin_frame();
+	// fences the region written since begin_frame()
+	void end_frame();
+
+	// copies `size` bytes into the current region, returns their offset in the buffer,
+	// aligned for binding, or INVALID_OFFSET when the region is full
+	u32 write(const void* data, u32 size);
+	void bind_range(u32 index, u32 offset, u32 size) const;
+
+	void bind() override;
+	void unbind() override;
+
+	u32 get_frame_size() const { return m_frame_size; }
+	// bytes written in the current frame
+	u32 get_used() const { return m_offset; }
+	// times begin_frame() had to block on a fence
+	u64 get_stall_count() const { return m_stalls; }
+
+private:
+	GLenum m_target;
+	u32 m_frame_size;
+	u32 m_alignment = 1;
+
+	u8* m_mapped = nullptr;
+	std::array<GLsync, FRAMES> m_fences{};
+	u32 m_frame = 0;
+	u32 m_offset = 0;
+	u64 m_stalls = 0;
+};
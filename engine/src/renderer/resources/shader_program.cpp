@@ -6,6 +6,7 @@
 
 #include "resources.hpp"
 #include "gl_errors.hpp"
+#include "gl_state.hpp"
 
 ShaderProgram::ShaderProgram(const std::string& vertex_name, const std::string& fragment_name) {
     const auto vertex_path = ResourceState::get()->getShaderPath(vertex_name);
@@ -17,6 +18,13 @@ ShaderProgram::ShaderProgram(const std::string& vertex_name, const std::string&
     m_id = compile_shader(vertex_path, fragment_path);
 }
 
+ShaderProgram::ShaderProgram(const std::string& compute_name) {
+    const auto compute_path = ResourceState::get()->getShaderPath(compute_name);
+    m_compute_path = compute_path.string();
+
+    m_id = compile_compute(compute_path);
+}
+
 void ShaderProgram::checkCompileErrors(unsigned int shader, const std::string &type) {
     int success;
     char infoLog[1024];
@@ -94,14 +102,50 @@ u32 ShaderProgram::compile_shader(const std::filesystem::path& vertex_path, cons
     return id;
 }
 
-void ShaderProgram::bind() { GLCALL(glUseProgram(m_id)); }
+u32 ShaderProgram::compile_compute(const std::filesystem::path& compute_path)
+{
+    std::string compute_code;
+
+    std::ifstream c_shader_file;
+    c_shader_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+    try {
+        c_shader_file.open(compute_path);
+        std::stringstream c_shader_stream;
+        c_shader_stream << c_shader_file.rdbuf();
+        c_shader_file.close();
+        compute_code = c_shader_stream.str();
+    }
+    catch (std::ifstream::failure& e) {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+    }
+
+    const char* c_shader_code = compute_code.c_str();
 
-void ShaderProgram::unbind() { GLCALL(glUseProgram(0)); }
+    u32 compute = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(compute, 1, &c_shader_code, nullptr);
+    glCompileShader(compute);
+    checkCompileErrors(compute, "COMPUTE");
+
+    u32 id = glCreateProgram();
+    glAttachShader(id, compute);
+    glLinkProgram(id);
+    checkCompileErrors(id, "PROGRAM");
+
+    glDeleteShader(compute);
+
+    return id;
+}
+
+void ShaderProgram::bind() { GlState::get()->use_program(m_id); }
+
+void ShaderProgram::unbind() { GlState::get()->use_program(0); }
 
 void ShaderProgram::invalidate()
 {
     glDeleteProgram(m_id);
-    m_id = compile_shader(m_vertex_path, m_frag_path);
+    GlState::get()->on_program_deleted(m_id);
+    m_id = m_compute_path.empty() ? compile_shader(m_vertex_path, m_frag_path) : compile_compute(m_compute_path);
 }
 
 void ShaderProgram::set_bool(const std::string &name, bool value) const {
@@ -114,6 +158,11 @@ void ShaderProgram::set_int(const std::string &name, int value) const {
     GLCALL(glUniform1i(loc, value));
 }
 
+void ShaderProgram::set_uint(const std::string &name, u32 value) const {
+    const auto loc = GLCALL(glGetUniformLocation(m_id, name.c_str()));
+    GLCALL(glUniform1ui(loc, value));
+}
+
 void ShaderProgram::set_float(const std::string &name, float value) const {
     const auto loc = GLCALL(glGetUniformLocation(m_id, name.c_str()));
     GLCALL(glUniform1f(loc, value));
@@ -129,6 +178,16 @@ void ShaderProgram::set_vec2(const std::string &name, float *value) const {
     GLCALL(glUniform2f(loc, value[0], value[1]));
 }
 
+void ShaderProgram::set_ivec2(const std::string &name, const int *value) const {
+    const auto loc = GLCALL(glGetUniformLocation(m_id, name.c_str()));
+    GLCALL(glUniform2i(loc, value[0], value[1]));
+}
+
+void ShaderProgram::set_ivec4(const std::string &name, const int *value) const {
+    const auto loc = GLCALL(glGetUniformLocation(m_id, name.c_str()));
+    GLCALL(glUniform4i(loc, value[0], value[1], value[2], value[3]));
+}
+
 void ShaderProgram::set_mat4(const std::string &name, const float *value) const {
     const auto loc = GLCALL(glGetUniformLocation(m_id, name.c_str()));
     GLCALL(glUniformMatrix4fv(loc, 1, GL_FALSE, value));
@@ -11,8 +11,14 @@ class KAPI ShaderProgram : Bindable {
         return std::make_shared<ShaderProgram>(vertex_name, fragment_name);
     }
 
+    static std::shared_ptr<ShaderProgram> create_compute(const std::string &compute_name) {
+        return std::make_shared<ShaderProgram>(compute_name);
+    }
+
     ShaderProgram(const std::string &vertex_name, const std::string &fragment_name);
     ShaderProgram(const std::string &vertex_name, const std::string &fragment_name, const std::string &geometry_name);
+    // compute program
+    explicit ShaderProgram(const std::string &compute_name);
 
     // delete copy and move constructors
     ShaderProgram(const ShaderProgram &) = delete;
@@ -20,21 +26,29 @@ class KAPI ShaderProgram : Bindable {
     ShaderProgram(ShaderProgram &&) = delete;
     ShaderProgram &operator=(ShaderProgram &&) = delete;
 
+    using Bindable::get_resource_id;
+
     void bind() override;
     void unbind() override;
     void invalidate();
 
     void set_bool(const std::string &name, bool value) const;
     void set_int(const std::string &name, int value) const;
+    void set_uint(const std::string &name, u32 value) const;
     void set_float(const std::string &name, float value) const;
     void set_mat4(const std::string &name, const float *value) const;
     void set_vec3(const std::string &name, float *value) const;
     void set_vec2(const std::string &name, float *value) const;
+    void set_ivec2(const std::string &name, const int *value) const;
+    void set_ivec4(const std::string &name, const int *value) const;
 
   private:
     static void checkCompileErrors(unsigned int shader, const std::string &type);
     static u32 compile_shader(const std::filesystem::path& vertex_path, const std::filesystem::path& frag_path);
+    static u32 compile_compute(const std::filesystem::path& compute_path);
 
     std::string m_vertex_path;
     std::string m_frag_path;
+    // set for compute programs only
+    std::string m_compute_path;
 };
@@ -9,6 +9,7 @@
 #include <defines.hpp>
 
 #include "gl_errors.hpp"
+#include "gl_state.hpp"
 
 Texture::Texture(const TextureSpecification& spec) : m_spec(spec) {
 	// from file
@@ -21,18 +22,21 @@ Texture::Texture(const TextureSpecification& spec) : m_spec(spec) {
 		loadFromData();
 }
 
+Texture::~Texture() {
+	glDeleteTextures(1, &m_id);
+	GlState::get()->on_texture_deleted(m_id);
+}
+
 void Texture::bind() {
-	glActiveTexture(GL_TEXTURE0 + m_spec.slot);
-	GLCALL(glBindTexture(m_spec.target, m_id));
+	GlState::get()->bind_texture(m_spec.slot, m_spec.target, m_id);
 }
 
 void Texture::bind(u32 slot) {
-	glActiveTexture(GL_TEXTURE0 + slot);
-	GLCALL(glBindTexture(m_spec.target, m_id));
+	GlState::get()->bind_texture(slot, m_spec.target, m_id);
 }
 
 void Texture::unbind() {
-	glBindTexture(m_spec.target, 0);
+	GlState::get()->bind_texture(m_spec.slot, m_spec.target, 0);
 }
 
 void Texture::bind_to_framebuffer(u32 attachement_slot) const
@@ -40,6 +44,18 @@ void Texture::bind_to_framebuffer(u32 attachement_slot) const
 	glFramebufferTexture2D(GL_FRAMEBUFFER, m_spec.attachement_target + attachement_slot, m_spec.target, m_id, 0);
 }
 
+void Texture::resize(u32 width, u32 height)
+{
+	m_width = m_spec.width = width;
+	m_height = m_spec.height = height;
+
+	GlState::get()->bind_texture(m_spec.target, m_id);
+	glTexImage2D(m_spec.target, 0, m_spec.internalFormat, width, height, 0, m_spec.format, m_spec.type, nullptr);
+	if (m_spec.generateMipmaps)
+		glGenerateMipmap(m_spec.target);
+	GlState::get()->bind_texture(m_spec.target, 0);
+}
+
 void Texture::loadHdrFromFile() {
 	auto path = m_spec.path;
 
@@ -68,7 +84,7 @@ void Texture::loadHdrFromFile() {
 	m_height = height;
 
 	glGenTextures(1, &m_id);
-	glBindTexture(m_spec.target, m_id);
+	GlState::get()->bind_texture(m_spec.target, m_id);
 
 	glTexParameteri(m_spec.target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(m_spec.target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -77,7 +93,7 @@ void Texture::loadHdrFromFile() {
 
 	glTexImage2D(m_spec.target, 0, GL_RGB16F, width, height, 0, channels > 3 ? GL_RGBA : GL_RGB, GL_FLOAT, data);
 
-	glBindTexture(m_spec.target, 0);
+	GlState::get()->bind_texture(m_spec.target, 0);
 	stbi_image_free(data);
 }
 
@@ -109,7 +125,7 @@ void Texture::loadFromFile() {
 	m_height = height;
 
 	glGenTextures(1, &m_id);
-	glBindTexture(m_spec.target, m_id);
+	GlState::get()->bind_texture(m_spec.target, m_id);
 
 	glTexParameteri(m_spec.target, GL_TEXTURE_WRAP_S, m_spec.wrapS);
 	glTexParameteri(m_spec.target, GL_TEXTURE_WRAP_T, m_spec.wrapT);
@@ -128,13 +144,13 @@ void Texture::loadFromFile() {
 	if (m_spec.generateMipmaps)
 		glGenerateMipmap(m_spec.target);
 
-	glBindTexture(m_spec.target, 0);
+	GlState::get()->bind_texture(m_spec.target, 0);
 	stbi_image_free(data);
 }
 
 void Texture::loadFromData() {
 	glGenTextures(1, &m_id);
-	glBindTexture(m_spec.target, m_id);
+	GlState::get()->bind_texture(m_spec.target, m_id);
 
 	m_width = m_spec.width;
 	m_height = m_spec.height;
@@ -149,7 +165,7 @@ void Texture::loadFromData() {
 	if (m_spec.generateMipmaps)
 		glGenerateMipmap(m_spec.target);
 
-	glBindTexture(m_spec.target, 0);
+	GlState::get()->bind_texture(m_spec.target, 0);
 }
 
 u32 Texture::get_width() const
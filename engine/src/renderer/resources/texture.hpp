@@ -39,11 +39,14 @@ public:
     }
 
     Texture(const TextureSpecification& spec);
+    ~Texture();
 
     void bind() override;
     void bind(u32 slot);
     void unbind() override;
     void bind_to_framebuffer(u32 attachement_slot) const;
+    // reallocates a render target texture, the contents are lost
+    void resize(u32 width, u32 height);
     TextureSpecification& get_spec() { return m_spec; }
 
     u32 get_width() const;
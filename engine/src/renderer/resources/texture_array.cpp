@@ -0,0 +1,101 @@
+#include "texture_array.hpp"
+
+#include <algorithm>
+#include "gl_state.hpp"
+#include "gl_errors.hpp"
+
+TextureArray::TextureArray(const TextureArraySpecification& spec)
+	: m_spec(spec)
+{
+	m_spec.capacity = std::max(m_spec.capacity, 1u);
+	m_id = allocate(m_spec.capacity);
+}
+
+TextureArray::~TextureArray()
+{
+	glDeleteTextures(1, &m_id);
+	GlState::get()->on_texture_deleted(m_id);
+}
+
+void TextureArray::bind()
+{
+	GlState::get()->bind_texture(m_spec.slot, GL_TEXTURE_2D_ARRAY, m_id);
+}
+
+void TextureArray::bind(u32 slot)
+{
+	GlState::get()->bind_texture(slot, GL_TEXTURE_2D_ARRAY, m_id);
+}
+
+void TextureArray::unbind()
+{
+	GlState::get()->bind_texture(m_spec.slot, GL_TEXTURE_2D_ARRAY, 0);
+}
+
+u32 TextureArray::add_layer(Texture& texture)
+{
+	if (m_layers == m_spec.capacity) {
+		// immutable storage can not grow, copy every layer into a larger array
+		const auto capacity = m_spec.capacity * 2;
+		const auto id = allocate(capacity);
+		for (u32 level = 0; level < m_spec.levels; level++) {
+			GLCALL(glCopyImageSubData(m_id, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, id, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+				std::max(m_spec.width >> level, 1u), std::max(m_spec.height >> level, 1u), m_layers));
+		}
+
+		glDeleteTextures(1, &m_id);
+		GlState::get()->on_texture_deleted(m_id);
+		m_id = id;
+		m_spec.capacity = capacity;
+	}
+
+	const auto layer = m_layers++;
+	for (u32 level = 0; level < m_spec.levels; level++) {
+		GLCALL(glCopyImageSubData(texture.get_resource_id(), GL_TEXTURE_2D, level, 0, 0, 0, m_id, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+			std::max(m_spec.width >> level, 1u), std::max(m_spec.height >> level, 1u), 1));
+	}
+
+	return layer;
+}
+
+u32 TextureArray::allocate(u32 capacity)
+{
+	u32 id = 0;
+	glGenTextures(1, &id);
+	GlState::get()->bind_texture(GL_TEXTURE_2D_ARRAY, id);
+
+	GLCALL(glTexStorage3D(GL_TEXTURE_2D_ARRAY, m_spec.levels, m_spec.internal_format, m_spec.width, m_spec.height, capacity));
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, m_spec.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	GlState::get()->bind_texture(GL_TEXTURE_2D_ARRAY, 0);
+	return id;
+}
+
+GLenum TextureArray::sized_format(GLenum format)
+{
+	switch (format) {
+	case GL_RED: return GL_R8;
+	case GL_RG: return GL_RG8;
+	case GL_RGB: return GL_RGB8;
+	case GL_RGBA: return GL_RGBA8;
+	case GL_SRGB: return GL_SRGB8;
+	case GL_SRGB_ALPHA: return GL_SRGB8_ALPHA8;
+	}
+
+	return format;
+}
+
+u32 TextureArray::level_count(const TextureSpecification& spec, u32 width, u32 height)
+{
+	if (!spec.generateMipmaps)
+		return 1;
+
+	u32 levels = 1;
+	for (auto size = std::max(width, height); size > 1; size >>= 1)
+		levels++;
+
+	return levels;
+}
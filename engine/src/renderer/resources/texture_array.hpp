@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <memory>
+
+#include "defines.hpp"
+#include "bindable.hpp"
+#include "texture.hpp"
+
+struct TextureArraySpecification {
+    u32 width = 0;
+    u32 height = 0;
+    u32 levels = 1;
+    // must be a sized format, see TextureArray::sized_format
+    GLenum internal_format = GL_RGBA8;
+    u32 slot = 0;
+    // layers allocated up front, the array grows by copying when it is full
+    u32 capacity = 8;
+};
+
+// GL_TEXTURE_2D_ARRAY of textures sharing size, mip count and format
+class KAPI TextureArray : public Bindable {
+public:
+    static std::shared_ptr<TextureArray> create(const TextureArraySpecification& spec) {
+        return std::make_shared<TextureArray>(spec);
+    }
+
+    TextureArray(const TextureArraySpecification& spec);
+    ~TextureArray();
+
+    void bind() override;
+    void bind(u32 slot);
+    void unbind() override;
+
+    // copies every level of `texture` into a new layer and returns its index.
+    // the texture must match the array size, level count and format class
+    u32 add_layer(Texture& texture);
+
+    u32 get_layer_count() const { return m_layers; }
+    const TextureArraySpecification& get_spec() const { return m_spec; }
+
+    // sized equivalent of the unsized formats textures are created with
+    static GLenum sized_format(GLenum format);
+    static u32 level_count(const TextureSpecification& spec, u32 width, u32 height);
+
+private:
+    TextureArraySpecification m_spec;
+    u32 m_layers = 0;
+
+    u32 allocate(u32 capacity);
+};
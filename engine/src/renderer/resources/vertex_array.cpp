@@ -3,12 +3,13 @@
 #include <iostream>
 #include <format>
 #include "renderer/resources/gl_errors.hpp"
+#include "renderer/resources/gl_state.hpp"
 #include <defines.hpp>
 
 VertexArray::VertexArray(const VertexArraySpecification& spec)
 {
 	glGenVertexArrays(1, &m_id);
-	glBindVertexArray(m_id);
+	GlState::get()->bind_vertex_array(m_id);
 
 	if (spec.vertex_buffer)
 		spec.vertex_buffer->bind();
@@ -29,20 +30,50 @@ VertexArray::VertexArray(const VertexArraySpecification& spec)
 	}
 
 	// unbind to not mess up gpu state
-	glBindVertexArray(0);
+	GlState::get()->bind_vertex_array(0);
 }
 
 VertexArray::~VertexArray()
 {
 	glDeleteVertexArrays(1, &m_id);
+	GlState::get()->on_vertex_array_deleted(m_id);
 }
 
 void VertexArray::bind()
 {
-	glBindVertexArray(m_id);
+	GlState::get()->bind_vertex_array(m_id);
 }
 
 void VertexArray::unbind()
 {
-	glBindVertexArray(0);
+	GlState::get()->bind_vertex_array(0);
+}
+
+void VertexArray::set_instance_buffer(const std::shared_ptr<GlBuffer>& buffer, u32 location)
+{
+	GlState::get()->bind_vertex_array(m_id);
+	buffer->bind();
+
+	// a mat4 attribute is fed as 4 consecutive vec4 columns, advanced once per instance
+	for (u32 i = 0; i < 4; i++) {
+		GLCALL(glEnableVertexAttribArray(location + i));
+		GLCALL(glVertexAttribPointer(location + i, 4, GL_FLOAT, GL_FALSE, buffer->get_element_size(), (void*)(sizeof(f32) * 4 * i)));
+		GLCALL(glVertexAttribDivisor(location + i, 1));
+	}
+
+	GlState::get()->bind_vertex_array(0);
+	buffer->unbind();
+}
+
+void VertexArray::set_instance_uint(const std::shared_ptr<GlBuffer>& buffer, u32 location, u32 offset)
+{
+	GlState::get()->bind_vertex_array(m_id);
+	buffer->bind();
+
+	GLCALL(glEnableVertexAttribArray(location));
+	GLCALL(glVertexAttribIPointer(location, 1, GL_UNSIGNED_INT, buffer->get_element_size(), (void*)(u64)offset));
+	GLCALL(glVertexAttribDivisor(location, 1));
+
+	GlState::get()->bind_vertex_array(0);
+	buffer->unbind();
 }
@@ -22,6 +22,14 @@ public:
     VertexArray(const VertexArraySpecification &spec);
     ~VertexArray();
 
+    using Bindable::get_resource_id;
+
     void bind() override;
     void unbind() override;
+
+    // attaches a per-instance mat4 stream occupying locations [location, location + 3],
+    // read from the start of each buffer element
+    void set_instance_buffer(const std::shared_ptr<GlBuffer>& buffer, u32 location);
+    // attaches a per-instance uint read `offset` bytes into each buffer element
+    void set_instance_uint(const std::shared_ptr<GlBuffer>& buffer, u32 location, u32 offset);
 };
\ No newline at end of file
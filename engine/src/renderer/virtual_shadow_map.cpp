@@ -0,0 +1,408 @@
+#include "virtual_shadow_map.hpp"
+
+#include <cfloat>
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <imgui/imgui.h>
+#include <utils.hpp>
+
+#include <scene/scene.hpp>
+#include "resources/gl_state.hpp"
+
+// absolute light space page coordinates packed into a map key
+static u64 make_key(glm::ivec2 page)
+{
+	return ((u64)(u32)page.x << 32) | (u32)page.y;
+}
+
+static glm::ivec2 key_page(u64 key)
+{
+	return glm::ivec2((i32)(u32)(key >> 32), (i32)(u32)key);
+}
+
+VirtualShadowMap::VirtualShadowMap(std::shared_ptr<ShaderProgram> mark_shader)
+	: m_mark_shader(mark_shader), m_page_table(VIRTUAL_PAGES * VIRTUAL_PAGES, 0u)
+{
+	m_physical.resize(POOL_PAGES * POOL_PAGES, { NO_PAGE, 0 });
+
+	BufferSpecification spec{};
+	spec.type = GL_SHADER_STORAGE_BUFFER;
+	spec.element_size = sizeof(u32);
+	spec.count = VIRTUAL_PAGES * VIRTUAL_PAGES;
+	spec.data = m_page_table.data();
+	spec.usage = GL_DYNAMIC_DRAW;
+	m_page_table_buffer = GlBuffer::create(spec);
+}
+
+VirtualShadowMap::~VirtualShadowMap()
+{
+	for (auto& readback : m_readbacks) {
+		if (readback.fence)
+			glDeleteSync(readback.fence);
+	}
+}
+
+glm::mat4 VirtualShadowMap::get_virtual_matrix() const
+{
+	const auto page = get_page_world_size();
+	const auto low = glm::vec2(m_origin) * page;
+	const auto high = glm::vec2(m_origin + glm::ivec2(VIRTUAL_PAGES)) * page;
+	return glm::ortho(low.x, high.x, low.y, high.y, m_z_near, m_z_far) * m_light_view;
+}
+
+glm::mat4 VirtualShadowMap::get_page_matrix(glm::ivec2 page) const
+{
+	// same depth range as the virtual matrix, so page depths compare against it directly
+	const auto size = get_page_world_size();
+	const auto low = glm::vec2(page) * size;
+	return glm::ortho(low.x, low.x + size, low.y, low.y + size, m_z_near, m_z_far) * m_light_view;
+}
+
+void VirtualShadowMap::update(const glm::mat4& light_view, const glm::vec3& eye, const AABB& scene_bounds, Scene& scene)
+{
+	m_frame++;
+	m_render_list.clear();
+	m_stats = {};
+	// moving casters are not tracked while disabled
+	const bool was_enabled = m_enabled;
+	m_enabled = m_enabled_next;
+	m_extent = m_extent_next;
+	if (!m_enabled)
+		return;
+
+	if (!m_pool) {
+		TextureSpecification spec{};
+		spec.internalFormat = GL_DEPTH_COMPONENT;
+		spec.format = GL_DEPTH_COMPONENT;
+		spec.type = GL_FLOAT;
+		spec.width = POOL_PAGES * PAGE_SIZE;
+		spec.height = POOL_PAGES * PAGE_SIZE;
+		spec.wrapS = GL_CLAMP_TO_EDGE;
+		spec.wrapT = GL_CLAMP_TO_EDGE;
+		spec.minFilter = GL_NEAREST;
+		spec.magFilter = GL_NEAREST;
+		spec.attachement_target = GL_DEPTH_ATTACHMENT;
+		spec.generateMipmaps = false;
+		m_pool = std::make_shared<Texture>(spec);
+	}
+
+	// depth range of the whole scene along the light, in coarse steps so it rarely changes
+	auto z_near = m_z_near;
+	auto z_far = m_z_far;
+	if (!scene_bounds.is_empty()) {
+		auto scene_ls = AABB::empty();
+		for (u32 i = 0; i < 8; i++)
+			scene_ls.grow(glm::vec3(light_view * glm::vec4(scene_bounds.get_corner(i), 1.0f)));
+		z_near = glm::floor(-scene_ls.max.z / DEPTH_STEP) * DEPTH_STEP;
+		z_far = glm::max(glm::ceil(-scene_ls.min.z / DEPTH_STEP) * DEPTH_STEP, z_near + DEPTH_STEP);
+	}
+
+	// casters spawned since the last frame have no rectangle yet, new transforms drop every page
+	auto& transforms = scene.get_transforms();
+	const bool invalidated = !was_enabled || light_view != m_light_view || z_near != m_z_near || z_far != m_z_far
+		|| m_extent != m_rendered_extent || transforms.size() != m_transform_count;
+	if (invalidated) {
+		m_light_view = light_view;
+		m_z_near = z_near;
+		m_z_far = z_far;
+		m_rendered_extent = m_extent;
+		m_transform_count = transforms.size();
+		invalidate_all();
+	}
+	update_casters(scene, invalidated);
+
+	// the map is centered on the camera and moves in whole pages
+	const auto eye_ls = glm::vec2(light_view * glm::vec4(eye, 1.0f));
+	m_origin = glm::ivec2(glm::floor(eye_ls / get_page_world_size())) - glm::ivec2(VIRTUAL_PAGES / 2);
+
+	read_requests();
+	allocate_pages();
+}
+
+void VirtualShadowMap::update_casters(Scene& scene, bool rebuild)
+{
+	auto& transforms = scene.get_transforms();
+	if (!rebuild && transforms.get_updated_count() == 0)
+		return;
+
+	// the rectangle of a caster that moved is invalidated where it was and where it is now
+	scene.get_world().each<Transform, Bounds>([&](Entity entity, Transform& transform, Bounds& bounds) {
+		if (transform.node == INVALID_TRANSFORM || (!rebuild && !transforms.has_moved(transform.node)))
+			return;
+
+		if (entity.index >= m_caster_rects.size())
+			m_caster_rects.resize(entity.index + 1, glm::vec4(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX));
+
+		auto& rect = m_caster_rects[entity.index];
+		if (!rebuild)
+			invalidate_rect(rect);
+
+		const auto& sphere = bounds.world_sphere;
+		const auto center = glm::vec2(m_light_view * glm::vec4(sphere.center, 1.0f));
+		rect = glm::vec4(center - sphere.radius, center + sphere.radius);
+		if (!rebuild)
+			invalidate_rect(rect);
+	});
+}
+
+void VirtualShadowMap::invalidate_all()
+{
+	for (auto& page : m_physical)
+		page.key = NO_PAGE;
+	m_stats.invalidated += (u32)m_resident.size();
+	m_resident.clear();
+}
+
+void VirtualShadowMap::invalidate_rect(const glm::vec4& rect)
+{
+	if (rect.x > rect.z || m_resident.empty())
+		return;
+
+	const auto size = get_page_world_size();
+	const auto first = glm::ivec2(glm::floor(glm::vec2(rect.x, rect.y) / size));
+	const auto last = glm::ivec2(glm::floor(glm::vec2(rect.z, rect.w) / size));
+
+	auto drop = [&](u64 key) {
+		const auto it = m_resident.find(key);
+		if (it == m_resident.end())
+			return;
+		m_physical[it->second].key = NO_PAGE;
+		m_resident.erase(it);
+		m_stats.invalidated++;
+	};
+
+	// large casters are tested against the resident pages instead of walking their pages
+	const auto area = (u64)(last.x - first.x + 1) * (u64)(last.y - first.y + 1);
+	if (area <= m_resident.size()) {
+		for (i32 y = first.y; y <= last.y; y++) {
+			for (i32 x = first.x; x <= last.x; x++)
+				drop(make_key(glm::ivec2(x, y)));
+		}
+		return;
+	}
+
+	for (auto& page : m_physical) {
+		if (page.key == NO_PAGE)
+			continue;
+		const auto position = key_page(page.key);
+		if (position.x >= first.x && position.x <= last.x && position.y >= first.y && position.y <= last.y)
+			drop(page.key);
+	}
+}
+
+void VirtualShadowMap::read_requests()
+{
+	bool read = false;
+	for (auto& readback : m_readbacks) {
+		if (!readback.fence)
+			continue;
+
+		// never waits, a request buffer is read once the gpu is done with it
+		const auto result = glClientWaitSync(readback.fence, 0, 0);
+		if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+			continue;
+
+		glDeleteSync(readback.fence);
+		readback.fence = nullptr;
+		if (readback.extent != m_extent)
+			continue;
+
+		if (!read)
+			m_requested.clear();
+		read = true;
+
+		m_request_data.resize(VIRTUAL_PAGES * VIRTUAL_PAGES);
+		readback.buffer->bind();
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_request_data.size() * sizeof(u32), m_request_data.data());
+		readback.buffer->unbind();
+
+		for (u32 i = 0; i < (u32)m_request_data.size(); i++) {
+			if (m_request_data[i])
+				m_requested.push_back(make_key(readback.origin + glm::ivec2(i % VIRTUAL_PAGES, i / VIRTUAL_PAGES)));
+		}
+	}
+
+	// several buffers can land in the same frame
+	if (read) {
+		std::sort(m_requested.begin(), m_requested.end());
+		m_requested.erase(std::unique(m_requested.begin(), m_requested.end()), m_requested.end());
+	}
+}
+
+void VirtualShadowMap::allocate_pages()
+{
+	const auto center = m_origin + glm::ivec2(VIRTUAL_PAGES / 2);
+
+	// requested pages still inside the map, the missing ones closest to the camera first
+	std::vector<std::pair<i32, u64>> missing;
+	for (const auto key : m_requested) {
+		const auto page = key_page(key);
+		const auto local = page - m_origin;
+		if (local.x < 0 || local.y < 0 || local.x >= (i32)VIRTUAL_PAGES || local.y >= (i32)VIRTUAL_PAGES)
+			continue;
+
+		m_stats.requested++;
+		const auto it = m_resident.find(key);
+		if (it != m_resident.end()) {
+			m_physical[it->second].last_used = m_frame;
+			continue;
+		}
+
+		const auto offset = page - center;
+		missing.push_back({ offset.x * offset.x + offset.y * offset.y, key });
+	}
+	std::sort(missing.begin(), missing.end());
+
+	// free pages first, then the least recently used. pages requested this frame are kept
+	std::vector<u32> candidates;
+	for (u32 i = 0; i < (u32)m_physical.size(); i++) {
+		if (m_physical[i].last_used < m_frame || m_physical[i].key == NO_PAGE)
+			candidates.push_back(i);
+	}
+	std::sort(candidates.begin(), candidates.end(), [&](u32 a, u32 b) {
+		const auto free_a = m_physical[a].key == NO_PAGE;
+		const auto free_b = m_physical[b].key == NO_PAGE;
+		if (free_a != free_b)
+			return free_a;
+		return m_physical[a].last_used < m_physical[b].last_used;
+	});
+
+	const auto count = std::min({ (u32)missing.size(), MAX_RENDERED_PAGES, (u32)candidates.size() });
+	for (u32 i = 0; i < count; i++) {
+		const auto physical = candidates[i];
+		auto& page = m_physical[physical];
+		if (page.key != NO_PAGE) {
+			m_resident.erase(page.key);
+			m_stats.evicted++;
+		}
+
+		page.key = missing[i].second;
+		page.last_used = m_frame;
+		m_resident[page.key] = physical;
+		m_render_list.push_back(physical);
+	}
+	m_stats.rendered = count;
+	m_stats.deferred = (u32)missing.size() - count;
+	m_stats.resident = (u32)m_resident.size();
+
+	for (u32 y = 0; y < VIRTUAL_PAGES; y++) {
+		for (u32 x = 0; x < VIRTUAL_PAGES; x++) {
+			const auto it = m_resident.find(make_key(m_origin + glm::ivec2(x, y)));
+			m_page_table[x + y * VIRTUAL_PAGES] = it == m_resident.end() ? 0u : it->second + 1;
+		}
+	}
+}
+
+Frustum VirtualShadowMap::get_frustum() const
+{
+	if (m_render_list.empty()) {
+		Frustum frustum = Frustum::from_matrix(glm::mat4(1.0f));
+		// a plane every box is behind of
+		frustum.planes[Frustum::NEAR_PLANE] = glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+		return frustum;
+	}
+
+	// one frustum around all pages, every page then draws every caster of the union
+	auto first = key_page(m_physical[m_render_list[0]].key);
+	auto last = first;
+	for (const auto physical : m_render_list) {
+		const auto page = key_page(m_physical[physical].key);
+		first = glm::min(first, page);
+		last = glm::max(last, page);
+	}
+
+	const auto size = get_page_world_size();
+	const auto low = glm::vec2(first) * size;
+	const auto high = glm::vec2(last + 1) * size;
+	return Frustum::from_matrix(glm::ortho(low.x, high.x, low.y, high.y, m_z_near, m_z_far) * m_light_view);
+}
+
+void VirtualShadowMap::begin_page(u32 index, ShaderProgram& shader)
+{
+	const auto physical = m_render_list[index];
+	const auto x = (i32)((physical % POOL_PAGES) * PAGE_SIZE);
+	const auto y = (i32)((physical / POOL_PAGES) * PAGE_SIZE);
+	glViewport(x, y, PAGE_SIZE, PAGE_SIZE);
+	glScissor(x, y, PAGE_SIZE, PAGE_SIZE);
+
+	const f32 depth = 1.0f;
+	glClearBufferfv(GL_DEPTH, 0, &depth);
+
+	const auto matrix = get_page_matrix(key_page(m_physical[physical].key));
+	shader.bind();
+	shader.set_mat4("light_space_matrix", glm::value_ptr(matrix));
+}
+
+void VirtualShadowMap::mark_pages(const std::shared_ptr<Texture>& depth, const glm::mat4& inverse_view_projection)
+{
+	if (!m_enabled)
+		return;
+
+	// every buffer is still in flight, the requests of this frame are skipped
+	auto& readback = m_readbacks[m_readback_index];
+	if (readback.fence)
+		return;
+	m_readback_index = (m_readback_index + 1) % READBACK_FRAMES;
+
+	if (!readback.buffer) {
+		BufferSpecification spec{};
+		spec.type = GL_SHADER_STORAGE_BUFFER;
+		spec.element_size = sizeof(u32);
+		spec.count = VIRTUAL_PAGES * VIRTUAL_PAGES;
+		spec.data = nullptr;
+		spec.usage = GL_STREAM_READ;
+		readback.buffer = GlBuffer::create(spec);
+	}
+
+	const u32 zero = 0;
+	readback.buffer->bind();
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	readback.buffer->unbind();
+	GlState::get()->bind_buffer_range(GL_SHADER_STORAGE_BUFFER, REQUEST_BINDING, readback.buffer->get_id(), 0, VIRTUAL_PAGES * VIRTUAL_PAGES * sizeof(u32));
+
+	const auto virtual_matrix = get_virtual_matrix();
+	m_mark_shader->bind();
+	m_mark_shader->set_mat4("inverse_view_projection", glm::value_ptr(inverse_view_projection));
+	m_mark_shader->set_mat4("virtual_matrix", glm::value_ptr(virtual_matrix));
+	depth->bind(4);
+
+	// 8 x 8 pixels per group, see mark_pages.comp
+	glDispatchCompute((depth->get_width() + 7) / 8, (depth->get_height() + 7) / 8, 1);
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	m_mark_shader->unbind();
+
+	readback.origin = m_origin;
+	readback.extent = m_extent;
+	readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void VirtualShadowMap::bind(ShaderProgram& shader)
+{
+	shader.set_bool("virtual_shadows", m_enabled);
+	if (!m_enabled)
+		return;
+
+	m_page_table_buffer->update(m_page_table.data(), (u32)m_page_table.size());
+	GlState::get()->bind_buffer_range(GL_SHADER_STORAGE_BUFFER, PAGE_TABLE_BINDING, m_page_table_buffer->get_id(), 0, (u32)m_page_table.size() * sizeof(u32));
+
+	// depth bias of two texels, in the depth units of the virtual matrix
+	const auto texel = get_page_world_size() / PAGE_SIZE;
+	const auto virtual_matrix = get_virtual_matrix();
+	shader.set_mat4("virtual_matrix", glm::value_ptr(virtual_matrix));
+	shader.set_float("virtual_bias", 2.0f * texel / (m_z_far - m_z_near));
+	m_pool->bind(POOL_UNIT);
+}
+
+void VirtualShadowMap::render_debug_menu()
+{
+	ImGui::Checkbox("virtual shadow map", &m_enabled_next);
+	if (!m_enabled)
+		return;
+
+	ImGui::DragFloat("virtual extent", &m_extent_next, 1.0f, 16.0f, 4096.0f);
+	ImGui::Text("%u virtual pages of %.2f m, %u pool pages", VIRTUAL_PAGES * VIRTUAL_PAGES, get_page_world_size(), POOL_PAGES * POOL_PAGES);
+	ImGui::Text("requested %u, resident %u", m_stats.requested, m_stats.resident);
+	ImGui::Text("rendered %u, deferred %u, evicted %u, invalidated %u", m_stats.rendered, m_stats.deferred, m_stats.evicted, m_stats.invalidated);
+	utils::imgui_render_hoverable_image(m_pool, ImVec2(400.0f, 400.0f));
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <glad/glad.h>
+#include <glm/glm/glm.hpp>
+
+#include <defines.hpp>
+#include <scene/bounds.hpp>
+#include "culling.hpp"
+#include "resources/buffer.hpp"
+#include "resources/texture.hpp"
+#include "resources/shader_program.hpp"
+
+class Scene;
+
+struct VirtualShadowStats {
+	u32 requested = 0;
+	u32 resident = 0;
+	u32 rendered = 0;
+	// requested pages left for the next frames by the per-frame budget
+	u32 deferred = 0;
+	u32 evicted = 0;
+	u32 invalidated = 0;
+};
+
+//
+// Sun shadow map of VIRTUAL_PAGES² pages of PAGE_SIZE² texels around the camera, far
+// more than fits in memory. Only the pages covering visible pixels are backed by a page
+// of the physical pool: the G-buffer depth is projected into the virtual map on the gpu
+// and the touched pages are read back a few frames later. A page stays in the pool
+// until its space is needed, keyed by its absolute position in light space, so it
+// survives the map following the camera. Casters that move only invalidate the pages
+// under them, everything is invalidated when the light or the depth range changes.
+//
+// The lighting pass looks the page up in the page table and falls back to the cascades
+// of ShadowMapPass while a page is not resident yet.
+//
+class VirtualShadowMap {
+public:
+	static const u32 PAGE_SIZE = 128;
+	// per side of the virtual map and of the physical pool
+	static const u32 VIRTUAL_PAGES = 128;
+	static const u32 POOL_PAGES = 32;
+	static const u32 MAX_RENDERED_PAGES = 64;
+	// request buffers in flight, read back once the gpu is done with them
+	static const u32 READBACK_FRAMES = 3;
+
+	static const u32 REQUEST_BINDING = 8;
+	static const u32 PAGE_TABLE_BINDING = 9;
+	static const u32 POOL_UNIT = 9;
+
+	VirtualShadowMap(std::shared_ptr<ShaderProgram> mark_shader);
+	~VirtualShadowMap();
+
+	bool is_enabled() const { return m_enabled; }
+
+	// follows the camera, reads back the requested pages and picks the pages rendered this frame.
+	// `light_view` is ShadowMapPass::get_light_view()
+	void update(const glm::mat4& light_view, const glm::vec3& eye, const AABB& scene_bounds, Scene& scene);
+
+	// light frustum around the pages rendered this frame, rejects everything when there are none
+	Frustum get_frustum() const;
+	u32 get_render_count() const { return (u32)m_render_list.size(); }
+	// clears the pool page of the `index`th page to render and points `shader` at it,
+	// draw the LAYER_SHADOW_VIRTUAL casters after this
+	void begin_page(u32 index, ShaderProgram& shader);
+
+	// projects every pixel of the gbuffer depth into the virtual map and flags its page
+	void mark_pages(const std::shared_ptr<Texture>& depth, const glm::mat4& inverse_view_projection);
+	// uploads the page table and sets the lookup uniforms of deferred_lighting.frag
+	void bind(ShaderProgram& shader);
+
+	std::shared_ptr<Texture> get_pool() { return m_pool; }
+	const VirtualShadowStats& get_stats() const { return m_stats; }
+	void render_debug_menu();
+
+private:
+	struct PhysicalPage {
+		// absolute light space page, NO_PAGE when free
+		u64 key;
+		u64 last_used;
+	};
+
+	struct Readback {
+		std::shared_ptr<GlBuffer> buffer;
+		GLsync fence = nullptr;
+		// absolute page of the first virtual page and page size when it was marked
+		glm::ivec2 origin = glm::ivec2(0);
+		f32 extent = 0.0f;
+	};
+
+	static const u64 NO_PAGE = ~0ull;
+	// the depth range moves in steps of this many meters
+	static constexpr f32 DEPTH_STEP = 8.0f;
+
+	std::shared_ptr<ShaderProgram> m_mark_shader;
+	bool m_enabled = false;
+	// the debug menu runs after the casters were recorded, the switch waits for the next update()
+	bool m_enabled_next = false;
+	// meters covered by the virtual map per side. the menu edits m_extent_next, update() applies
+	// it so mark_pages() and bind() use the extent the page table was built for
+	f32 m_extent = 128.0f;
+	f32 m_extent_next = 128.0f;
+
+	// light space placement, every page is rendered with the same light view and depth range.
+	// the pages are dropped when any of these change
+	glm::mat4 m_light_view = glm::mat4(1.0f);
+	f32 m_z_near = 0.0f;
+	f32 m_z_far = 1.0f;
+	f32 m_rendered_extent = 0.0f;
+	u32 m_transform_count = 0;
+
+	glm::ivec2 m_origin = glm::ivec2(0);
+	u64 m_frame = 0;
+
+	std::vector<PhysicalPage> m_physical;
+	std::unordered_map<u64, u32> m_resident;
+	// pool pages rendered this frame, their page table entries are only valid once drawn
+	std::vector<u32> m_render_list;
+
+	std::array<Readback, READBACK_FRAMES> m_readbacks;
+	u32 m_readback_index = 0;
+	std::vector<u32> m_request_data;
+	// absolute pages of the last requests read back
+	std::vector<u64> m_requested;
+
+	// light space xy rectangle of every caster by entity index, where its shadow was last rendered
+	std::vector<glm::vec4> m_caster_rects;
+
+	std::shared_ptr<Texture> m_pool;
+	std::shared_ptr<GlBuffer> m_page_table_buffer;
+	// entries of the virtual pages, 0 when not resident, otherwise the pool page + 1
+	std::vector<u32> m_page_table;
+	VirtualShadowStats m_stats;
+
+	f32 get_page_world_size() const { return m_extent / VIRTUAL_PAGES; }
+	// world to the clip space of the whole virtual map or of one page of it
+	glm::mat4 get_virtual_matrix() const;
+	glm::mat4 get_page_matrix(glm::ivec2 page) const;
+
+	void update_casters(Scene& scene, bool rebuild);
+	void invalidate_all();
+	void invalidate_rect(const glm::vec4& rect);
+	void read_requests();
+	void allocate_pages();
+};
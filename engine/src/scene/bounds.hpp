@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cfloat>
+#include <glm/glm/glm.hpp>
+#include <defines.hpp>
+
+struct AABB {
+	glm::vec3 min = glm::vec3(0.0f);
+	glm::vec3 max = glm::vec3(0.0f);
+
+	glm::vec3 get_center() const { return (min + max) * 0.5f; }
+	glm::vec3 get_extents() const { return (max - min) * 0.5f; }
+
+	f32 get_surface_area() const {
+		const auto size = max - min;
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	void grow(const AABB& other) {
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+	}
+
+	void grow(const glm::vec3& point) {
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+
+	// squared distance from `point` to the closest point of the box (0 inside)
+	f32 distance_squared(const glm::vec3& point) const {
+		const auto delta = glm::max(glm::max(min - point, point - max), glm::vec3(0.0f));
+		return glm::dot(delta, delta);
+	}
+
+	bool is_empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+
+	AABB intersection(const AABB& other) const {
+		return { glm::max(min, other.min), glm::min(max, other.max) };
+	}
+
+	glm::vec3 get_corner(u32 i) const {
+		return glm::vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+	}
+
+	// an empty box that any grow() replaces
+	static AABB empty() {
+		return { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+	}
+};
+
+struct BoundingSphere {
+	glm::vec3 center = glm::vec3(0.0f);
+	f32 radius = 0.0f;
+
+	bool intersects(const AABB& box) const {
+		return box.distance_squared(center) <= radius * radius;
+	}
+};
+
+struct Ray {
+	glm::vec3 origin = glm::vec3(0.0f);
+	glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+
+	// slab test, returns the entry distance along the ray or a negative value on a miss
+	f32 intersect(const AABB& box, f32 max_distance = FLT_MAX) const {
+		const auto inv_direction = 1.0f / direction;
+		const auto t0 = (box.min - origin) * inv_direction;
+		const auto t1 = (box.max - origin) * inv_direction;
+		const auto t_min = glm::min(t0, t1);
+		const auto t_max = glm::max(t0, t1);
+
+		const auto enter = glm::max(glm::max(t_min.x, t_min.y), glm::max(t_min.z, 0.0f));
+		const auto exit = glm::min(glm::min(t_max.x, t_max.y), glm::min(t_max.z, max_distance));
+		return enter <= exit ? enter : -1.0f;
+	}
+};
+
+//
+// Six inward facing planes (xyz = normal, w = distance), a point p is inside when
+// dot(plane.xyz, p) + plane.w >= 0 for every plane.
+//
+struct Frustum {
+	enum Plane { LEFT_PLANE, RIGHT_PLANE, BOTTOM_PLANE, TOP_PLANE, NEAR_PLANE, FAR_PLANE, PLANE_COUNT };
+
+	glm::vec4 planes[PLANE_COUNT];
+
+	// Gribb-Hartmann extraction from an OpenGL style (clip z in [-w, w]) view projection matrix
+	static Frustum from_matrix(const glm::mat4& view_projection) {
+		auto row = [&](u32 i) {
+			return glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+		};
+
+		Frustum frustum;
+		frustum.planes[LEFT_PLANE] = row(3) + row(0);
+		frustum.planes[RIGHT_PLANE] = row(3) - row(0);
+		frustum.planes[BOTTOM_PLANE] = row(3) + row(1);
+		frustum.planes[TOP_PLANE] = row(3) - row(1);
+		frustum.planes[NEAR_PLANE] = row(3) + row(2);
+		frustum.planes[FAR_PLANE] = row(3) - row(2);
+
+		for (auto& plane : frustum.planes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+
+		return frustum;
+	}
+
+	enum Containment { OUTSIDE, INTERSECTS, INSIDE };
+
+	// like intersects() but also reports boxes fully inside, so hierarchies can skip their children
+	Containment classify(const AABB& box) const {
+		const auto center = box.get_center();
+		const auto extents = box.get_extents();
+		auto result = INSIDE;
+		for (const auto& plane : planes) {
+			const auto normal = glm::vec3(plane);
+			const auto radius = glm::dot(glm::abs(normal), extents);
+			const auto distance = glm::dot(normal, center) + plane.w;
+			if (distance < -radius)
+				return OUTSIDE;
+			if (distance < radius)
+				result = INTERSECTS;
+		}
+		return result;
+	}
+
+	bool intersects(const AABB& box) const {
+		const auto center = box.get_center();
+		const auto extents = box.get_extents();
+		for (const auto& plane : planes) {
+			const auto normal = glm::vec3(plane);
+			const auto radius = glm::dot(glm::abs(normal), extents);
+			if (glm::dot(normal, center) + plane.w < -radius)
+				return false;
+		}
+		return true;
+	}
+
+	bool intersects(const BoundingSphere& sphere) const {
+		for (const auto& plane : planes) {
+			if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius)
+				return false;
+		}
+		return true;
+	}
+};
+
+// world space box around the 8 corners of the clip volume of `view_projection`
+inline AABB frustum_bounds(const glm::mat4& view_projection) {
+	const auto inverse = glm::inverse(view_projection);
+
+	auto box = AABB::empty();
+	for (u32 i = 0; i < 8; i++) {
+		const auto ndc = glm::vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f, 1.0f);
+		const auto corner = inverse * ndc;
+		box.grow(glm::vec3(corner) / corner.w);
+	}
+	return box;
+}
+
+// smallest aabb enclosing `box` after transformation (Arvo's method, no corner expansion)
+inline AABB transform_aabb(const AABB& box, const glm::mat4& transform) {
+	const auto center = glm::vec3(transform * glm::vec4(box.get_center(), 1.0f));
+	const auto extents = box.get_extents();
+
+	glm::vec3 world_extents(0.0f);
+	for (u32 i = 0; i < 3; i++) {
+		world_extents[i] = glm::abs(transform[0][i]) * extents.x
+			+ glm::abs(transform[1][i]) * extents.y
+			+ glm::abs(transform[2][i]) * extents.z;
+	}
+
+	return { center - world_extents, center + world_extents };
+}
+
+inline BoundingSphere transform_sphere(const BoundingSphere& sphere, const glm::mat4& transform) {
+	// non uniform scale grows the sphere by the largest axis scale
+	const auto scale = glm::max(glm::length(glm::vec3(transform[0])), glm::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+	return { glm::vec3(transform * glm::vec4(sphere.center, 1.0f)), sphere.radius * scale };
+}
@@ -0,0 +1,326 @@
+#include "bvh.hpp"
+
+#include <cassert>
+#include <algorithm>
+
+// past this depth nodes split at the object median, bounding the traversal stacks to 64 entries
+static const u32 SAH_MAX_DEPTH = 32;
+static const u32 SAH_BINS = 12;
+
+BvhProxy Bvh::insert(const AABB& box, u32 user_data)
+{
+	BvhProxy proxy;
+	if (!m_free_list.empty()) {
+		proxy = m_free_list.back();
+		m_free_list.pop_back();
+	}
+	else {
+		proxy = (BvhProxy)m_proxies.size();
+		m_proxies.emplace_back();
+	}
+
+	m_proxies[proxy] = { box, user_data, true };
+	m_alive++;
+	m_needs_rebuild = true;
+	return proxy;
+}
+
+void Bvh::remove(BvhProxy proxy)
+{
+	assert(proxy < m_proxies.size() && m_proxies[proxy].alive && "Invalid bvh proxy!");
+	m_proxies[proxy].alive = false;
+	m_free_list.push_back(proxy);
+	m_alive--;
+	m_needs_rebuild = true;
+}
+
+void Bvh::move(BvhProxy proxy, const AABB& box)
+{
+	assert(proxy < m_proxies.size() && m_proxies[proxy].alive && "Invalid bvh proxy!");
+	m_proxies[proxy].box = box;
+	m_needs_refit = true;
+}
+
+void Bvh::update()
+{
+	if (m_needs_rebuild) {
+		rebuild();
+		return;
+	}
+
+	if (!m_needs_refit)
+		return;
+
+	refit();
+	if (m_cost > m_build_cost * REBUILD_RATIO)
+		rebuild();
+}
+
+void Bvh::rebuild()
+{
+	m_nodes.clear();
+	m_leaf_proxies.clear();
+
+	for (BvhProxy proxy = 0; proxy < m_proxies.size(); proxy++) {
+		if (m_proxies[proxy].alive)
+			m_leaf_proxies.push_back(proxy);
+	}
+
+	if (!m_leaf_proxies.empty()) {
+		m_nodes.reserve(m_leaf_proxies.size() * 2);
+		m_nodes.emplace_back();
+		build(0, 0, (u32)m_leaf_proxies.size(), 0);
+	}
+
+	m_build_cost = m_cost = compute_cost();
+	m_needs_rebuild = false;
+	m_needs_refit = false;
+	m_rebuilds++;
+}
+
+void Bvh::build(u32 node_index, u32 first, u32 count, u32 depth)
+{
+	// m_nodes may reallocate below, so the node is addressed by index only
+	AABB box = AABB::empty();
+	AABB centroids = AABB::empty();
+	for (u32 i = first; i < first + count; i++) {
+		const auto& proxy_box = m_proxies[m_leaf_proxies[i]].box;
+		box.grow(proxy_box);
+		centroids.grow(proxy_box.get_center());
+	}
+
+	m_nodes[node_index].box = box;
+	m_nodes[node_index].left_first = first;
+	m_nodes[node_index].count = count;
+
+	if (count <= 1)
+		return;
+
+	u32 split = first;
+	const auto extents = centroids.max - centroids.min;
+	const u32 axis = extents.x > extents.y ? (extents.x > extents.z ? 0 : 2) : (extents.y > extents.z ? 1 : 2);
+
+	if (depth < SAH_MAX_DEPTH && extents[axis] > 0.0f) {
+		// binned SAH along the widest centroid axis
+		struct Bin {
+			AABB box = AABB::empty();
+			u32 count = 0;
+		};
+
+		Bin bins[SAH_BINS];
+		const f32 scale = SAH_BINS / extents[axis];
+		auto bin_of = [&](BvhProxy proxy) {
+			const auto offset = m_proxies[proxy].box.get_center()[axis] - centroids.min[axis];
+			return std::min((u32)(offset * scale), SAH_BINS - 1);
+		};
+
+		for (u32 i = first; i < first + count; i++) {
+			auto& bin = bins[bin_of(m_leaf_proxies[i])];
+			bin.box.grow(m_proxies[m_leaf_proxies[i]].box);
+			bin.count++;
+		}
+
+		// sweep from the right to get the cost of every split plane in one pass
+		f32 right_area[SAH_BINS - 1];
+		u32 right_count[SAH_BINS - 1];
+		AABB right_box = AABB::empty();
+		u32 right_total = 0;
+		for (u32 i = SAH_BINS - 1; i > 0; i--) {
+			right_box.grow(bins[i].box);
+			right_total += bins[i].count;
+			right_area[i - 1] = right_total ? right_box.get_surface_area() : 0.0f;
+			right_count[i - 1] = right_total;
+		}
+
+		f32 best_cost = FLT_MAX;
+		u32 best_split = 0;
+		AABB left_box = AABB::empty();
+		u32 left_total = 0;
+		for (u32 i = 0; i < SAH_BINS - 1; i++) {
+			left_box.grow(bins[i].box);
+			left_total += bins[i].count;
+			if (left_total == 0 || right_count[i] == 0)
+				continue;
+
+			const auto cost = left_box.get_surface_area() * left_total + right_area[i] * right_count[i];
+			if (cost < best_cost) {
+				best_cost = cost;
+				best_split = i;
+			}
+		}
+
+		// traversal costs one box test per child, intersecting a box costs one unit
+		const auto leaf_cost = (f32)count;
+		const auto split_cost = 1.0f + best_cost / box.get_surface_area();
+		if (split_cost >= leaf_cost && count <= MAX_LEAF_SIZE)
+			return;
+
+		split = (u32)(std::partition(m_leaf_proxies.begin() + first, m_leaf_proxies.begin() + first + count, [&](BvhProxy proxy) {
+			return bin_of(proxy) <= best_split;
+		}) - m_leaf_proxies.begin());
+	}
+	else if (count <= MAX_LEAF_SIZE) {
+		return;
+	}
+
+	if (split == first || split == first + count) {
+		// every centroid landed on one side, fall back to the object median
+		split = first + count / 2;
+		std::nth_element(m_leaf_proxies.begin() + first, m_leaf_proxies.begin() + split, m_leaf_proxies.begin() + first + count, [&](BvhProxy a, BvhProxy b) {
+			return m_proxies[a].box.get_center()[axis] < m_proxies[b].box.get_center()[axis];
+		});
+	}
+
+	const auto left = (u32)m_nodes.size();
+	m_nodes.emplace_back();
+	m_nodes.emplace_back();
+	m_nodes[node_index].left_first = left;
+	m_nodes[node_index].count = 0;
+
+	build(left, first, split - first, depth + 1);
+	build(left + 1, split, first + count - split, depth + 1);
+}
+
+void Bvh::refit()
+{
+	// children are stored after their parent, walking backwards visits them first
+	for (u32 i = (u32)m_nodes.size(); i-- > 0;) {
+		auto& node = m_nodes[i];
+		node.box = AABB::empty();
+
+		if (node.is_leaf()) {
+			for (u32 j = 0; j < node.count; j++)
+				node.box.grow(m_proxies[m_leaf_proxies[node.left_first + j]].box);
+		}
+		else {
+			node.box.grow(m_nodes[node.left_first].box);
+			node.box.grow(m_nodes[node.left_first + 1].box);
+		}
+	}
+
+	m_cost = compute_cost();
+	m_needs_refit = false;
+}
+
+f32 Bvh::compute_cost() const
+{
+	if (m_nodes.empty())
+		return 0.0f;
+
+	// SAH cost relative to the root: expected box tests of a random ray through the root
+	f32 cost = 0.0f;
+	for (const auto& node : m_nodes) {
+		cost += node.box.get_surface_area() * (node.is_leaf() ? (f32)node.count : 1.0f);
+	}
+
+	const auto root_area = m_nodes[0].box.get_surface_area();
+	return root_area > 0.0f ? cost / root_area : 0.0f;
+}
+
+void Bvh::query(const AABB& box, std::vector<u32>& out) const
+{
+	if (m_nodes.empty())
+		return;
+
+	u32 stack[64];
+	u32 top = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		const auto& node = m_nodes[stack[--top]];
+		if (box.intersection(node.box).is_empty())
+			continue;
+
+		if (node.is_leaf()) {
+			for (u32 i = 0; i < node.count; i++) {
+				const auto& proxy = m_proxies[m_leaf_proxies[node.left_first + i]];
+				if (!box.intersection(proxy.box).is_empty())
+					out.push_back(proxy.user_data);
+			}
+			continue;
+		}
+
+		stack[top++] = node.left_first;
+		stack[top++] = node.left_first + 1;
+	}
+}
+
+void Bvh::query(const BoundingSphere& sphere, std::vector<u32>& out) const
+{
+	if (m_nodes.empty())
+		return;
+
+	u32 stack[64];
+	u32 top = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		const auto& node = m_nodes[stack[--top]];
+		if (!sphere.intersects(node.box))
+			continue;
+
+		if (node.is_leaf()) {
+			for (u32 i = 0; i < node.count; i++) {
+				const auto& proxy = m_proxies[m_leaf_proxies[node.left_first + i]];
+				if (sphere.intersects(proxy.box))
+					out.push_back(proxy.user_data);
+			}
+			continue;
+		}
+
+		stack[top++] = node.left_first;
+		stack[top++] = node.left_first + 1;
+	}
+}
+
+bool Bvh::raycast(const Ray& ray, BvhRayHit& hit, f32 max_distance) const
+{
+	return raycast(ray, hit, [&](u32, const AABB& box, f32 distance) {
+		return ray.intersect(box, distance);
+	}, max_distance);
+}
+
+bool Bvh::nearest(const glm::vec3& point, BvhRayHit& hit, f32 max_distance) const
+{
+	if (m_nodes.empty())
+		return false;
+
+	// compared squared, converted back on return
+	f32 best = max_distance == FLT_MAX ? FLT_MAX : max_distance * max_distance;
+	bool found = false;
+
+	u32 stack[64];
+	u32 top = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		const auto& node = m_nodes[stack[--top]];
+		if (node.box.distance_squared(point) >= best)
+			continue;
+
+		if (node.is_leaf()) {
+			for (u32 i = 0; i < node.count; i++) {
+				const auto& proxy = m_proxies[m_leaf_proxies[node.left_first + i]];
+				const auto distance = proxy.box.distance_squared(point);
+				if (distance < best) {
+					best = distance;
+					hit.user_data = proxy.user_data;
+					found = true;
+				}
+			}
+			continue;
+		}
+
+		u32 near_child = node.left_first;
+		u32 far_child = node.left_first + 1;
+		if (m_nodes[far_child].box.distance_squared(point) < m_nodes[near_child].box.distance_squared(point))
+			std::swap(near_child, far_child);
+
+		stack[top++] = far_child;
+		stack[top++] = near_child;
+	}
+
+	if (found)
+		hit.distance = glm::sqrt(best);
+	return found;
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <glm/glm/glm.hpp>
+
+#include <defines.hpp>
+#include "bounds.hpp"
+
+// stable handle of a box stored in the Bvh
+typedef u32 BvhProxy;
+constexpr BvhProxy INVALID_PROXY = ~0u;
+
+struct BvhRayHit {
+	u32 user_data = ~0u;
+	f32 distance = FLT_MAX;
+};
+
+//
+// Bounding volume hierarchy over dynamic boxes.
+// Moving boxes only refit the tree bottom-up; inserts, removals and a refit that degrades
+// the SAH cost past REBUILD_RATIO trigger a full binned SAH rebuild. Nodes are stored
+// depth first with children always after their parent, so a reverse sweep refits the tree.
+//
+class Bvh {
+public:
+	// leaves stop splitting at this many boxes
+	static const u32 MAX_LEAF_SIZE = 4;
+	// rebuild once the refit tree costs this much more than the freshly built one
+	static constexpr f32 REBUILD_RATIO = 1.5f;
+
+	BvhProxy insert(const AABB& box, u32 user_data);
+	void remove(BvhProxy proxy);
+	void move(BvhProxy proxy, const AABB& box);
+
+	// refits (or rebuilds) the tree after move/insert/remove, call once before querying
+	void update();
+	void rebuild();
+
+	// calls fn(user_data, fully_inside) for every box that may intersect the frustum.
+	// boxes reported with fully_inside == false only passed a coarser test and may still be outside.
+	template <class F>
+	void query(const Frustum& frustum, F&& fn) const;
+
+	void query(const AABB& box, std::vector<u32>& out) const;
+	void query(const BoundingSphere& sphere, std::vector<u32>& out) const;
+
+	// closest box hit by the ray
+	bool raycast(const Ray& ray, BvhRayHit& hit, f32 max_distance = FLT_MAX) const;
+	// closest primitive hit by the ray, intersect(user_data, box, max_distance) returns the hit
+	// distance or a negative value on a miss, for geometry that only partially fills its box
+	template <class F>
+	bool raycast(const Ray& ray, BvhRayHit& hit, F&& intersect, f32 max_distance = FLT_MAX) const;
+	// closest box to `point` (distance to the box surface, 0 inside)
+	bool nearest(const glm::vec3& point, BvhRayHit& hit, f32 max_distance = FLT_MAX) const;
+
+	const AABB& get_box(BvhProxy proxy) const { return m_proxies[proxy].box; }
+	u32 get_user_data(BvhProxy proxy) const { return m_proxies[proxy].user_data; }
+
+	// box around everything in the tree, empty when nothing was inserted
+	AABB get_bounds() const { return m_nodes.empty() ? AABB::empty() : m_nodes[0].box; }
+
+	u32 size() const { return m_alive; }
+	u32 get_node_count() const { return (u32)m_nodes.size(); }
+	f32 get_cost() const { return m_cost; }
+	u32 get_rebuild_count() const { return m_rebuilds; }
+
+private:
+	struct Node {
+		AABB box;
+		// first child when count == 0, first entry in m_leaf_proxies otherwise
+		u32 left_first = 0;
+		u32 count = 0;
+
+		bool is_leaf() const { return count > 0; }
+	};
+
+	struct Proxy {
+		AABB box;
+		u32 user_data = 0;
+		bool alive = false;
+	};
+
+	std::vector<Node> m_nodes;
+	std::vector<BvhProxy> m_leaf_proxies;
+
+	std::vector<Proxy> m_proxies;
+	std::vector<BvhProxy> m_free_list;
+	u32 m_alive = 0;
+
+	bool m_needs_rebuild = false;
+	bool m_needs_refit = false;
+	f32 m_build_cost = 0.0f;
+	f32 m_cost = 0.0f;
+	u32 m_rebuilds = 0;
+
+	void build(u32 node, u32 first, u32 count, u32 depth);
+	void refit();
+	f32 compute_cost() const;
+};
+
+template <class F>
+void Bvh::query(const Frustum& frustum, F&& fn) const
+{
+	if (m_nodes.empty())
+		return;
+
+	struct Entry {
+		u32 node;
+		bool inside;
+	};
+
+	Entry stack[64];
+	u32 top = 0;
+	stack[top++] = { 0, false };
+
+	while (top > 0) {
+		const auto entry = stack[--top];
+		const auto& node = m_nodes[entry.node];
+
+		// once a node is fully inside every descendant is, no more plane tests
+		bool inside = entry.inside;
+		if (!inside) {
+			const auto containment = frustum.classify(node.box);
+			if (containment == Frustum::OUTSIDE)
+				continue;
+			inside = containment == Frustum::INSIDE;
+		}
+
+		if (node.is_leaf()) {
+			for (u32 i = 0; i < node.count; i++) {
+				fn(m_proxies[m_leaf_proxies[node.left_first + i]].user_data, inside);
+			}
+			continue;
+		}
+
+		stack[top++] = { node.left_first, inside };
+		stack[top++] = { node.left_first + 1, inside };
+	}
+}
+
+template <class F>
+bool Bvh::raycast(const Ray& ray, BvhRayHit& hit, F&& intersect, f32 max_distance) const
+{
+	if (m_nodes.empty() || ray.intersect(m_nodes[0].box, max_distance) < 0.0f)
+		return false;
+
+	hit.distance = max_distance;
+	bool found = false;
+
+	u32 stack[64];
+	u32 top = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		const auto& node = m_nodes[stack[--top]];
+
+		if (node.is_leaf()) {
+			for (u32 i = 0; i < node.count; i++) {
+				const auto& proxy = m_proxies[m_leaf_proxies[node.left_first + i]];
+				const auto distance = intersect(proxy.user_data, proxy.box, hit.distance);
+				if (distance >= 0.0f && distance < hit.distance) {
+					hit.distance = distance;
+					hit.user_data = proxy.user_data;
+					found = true;
+				}
+			}
+			continue;
+		}
+
+		// visit the nearer child first so farther subtrees get rejected by the shrinking hit distance
+		u32 near_child = node.left_first;
+		u32 far_child = node.left_first + 1;
+		auto near_distance = ray.intersect(m_nodes[near_child].box, hit.distance);
+		auto far_distance = ray.intersect(m_nodes[far_child].box, hit.distance);
+		if (far_distance >= 0.0f && (near_distance < 0.0f || far_distance < near_distance)) {
+			std::swap(near_child, far_child);
+			std::swap(near_distance, far_distance);
+		}
+
+		if (far_distance >= 0.0f)
+			stack[top++] = far_child;
+		if (near_distance >= 0.0f)
+			stack[top++] = near_child;
+	}
+
+	return found;
+}
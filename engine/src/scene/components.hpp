@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glm/glm/glm.hpp>
+#include <defines.hpp>
+
+#include "transform_hierarchy.hpp"
+#include "bounds.hpp"
+#include "bvh.hpp"
+
+class Mesh;
+
+//
+// Components are plain data, stored contiguously per archetype by the World.
+//
+
+// placement of the entity, the matrices themselves live in the scene TransformHierarchy
+struct Transform {
+	TransformHandle node = INVALID_TRANSFORM;
+};
+
+// meshes are owned by the cached Model they were imported with and outlive the scene
+struct MeshRenderer {
+	Mesh* mesh = nullptr;
+};
+
+struct PointLight {
+	glm::vec3 color = glm::vec3(1.0f);
+	f32 intensity = 1.0f;
+	f32 radius = 10.0f;
+};
+
+// points down the -z axis of its transform, angles are in degrees from the axis
+struct SpotLight {
+	glm::vec3 color = glm::vec3(1.0f);
+	f32 intensity = 1.0f;
+	f32 radius = 10.0f;
+	f32 inner_angle = 20.0f;
+	f32 outer_angle = 30.0f;
+};
+
+// local bounds come from the mesh, world bounds are refreshed every frame by the scene
+struct Bounds {
+	AABB local;
+	AABB world;
+	BoundingSphere local_sphere;
+	BoundingSphere world_sphere;
+
+	// world box inside the scene bvh, user data is the entity index
+	BvhProxy proxy = INVALID_PROXY;
+};
@@ -0,0 +1,161 @@
+#include "ecs.hpp"
+
+Archetype::Archetype(ComponentMask mask)
+	: m_mask(mask)
+{
+	m_column_lookup.fill(-1);
+
+	for (u32 id = 0; id < MAX_COMPONENTS; id++) {
+		if (!(mask & (ComponentMask(1) << id)))
+			continue;
+
+		m_column_lookup[id] = (i32)m_columns.size();
+		m_columns.push_back({ id, ecs::component_infos()[id].size, {} });
+	}
+}
+
+void* Archetype::get(u32 component, u32 row)
+{
+	auto& column = m_columns[m_column_lookup[component]];
+	return column.data.data() + (u64)row * column.element_size;
+}
+
+u32 Archetype::push(Entity entity)
+{
+	m_entities.push_back(entity);
+	for (auto& column : m_columns) {
+		column.data.resize(column.data.size() + column.element_size, 0);
+	}
+
+	return (u32)m_entities.size() - 1;
+}
+
+Entity Archetype::remove(u32 row)
+{
+	const u32 last = (u32)m_entities.size() - 1;
+	Entity moved = INVALID_ENTITY;
+
+	if (row != last) {
+		m_entities[row] = m_entities[last];
+		moved = m_entities[row];
+
+		for (auto& column : m_columns) {
+			std::memcpy(column.data.data() + (u64)row * column.element_size, column.data.data() + (u64)last * column.element_size, column.element_size);
+		}
+	}
+
+	m_entities.pop_back();
+	for (auto& column : m_columns) {
+		column.data.resize(column.data.size() - column.element_size);
+	}
+
+	return moved;
+}
+
+void Archetype::copy_row(u32 dst_row, Archetype& src, u32 src_row)
+{
+	for (auto& column : m_columns) {
+		if (!src.has(column.component))
+			continue;
+
+		std::memcpy(column.data.data() + (u64)dst_row * column.element_size, src.get(column.component, src_row), column.element_size);
+	}
+}
+
+Entity World::create()
+{
+	u32 index;
+	if (!m_free_list.empty()) {
+		index = m_free_list.back();
+		m_free_list.pop_back();
+	}
+	else {
+		index = (u32)m_records.size();
+		m_records.emplace_back();
+	}
+
+	auto& record = m_records[index];
+	record.archetype = nullptr;
+	record.row = 0;
+	record.alive = true;
+	m_alive++;
+
+	return { index, record.generation };
+}
+
+void World::destroy(Entity entity)
+{
+	if (!is_alive(entity))
+		return;
+
+	auto& record = m_records[entity.index];
+	if (record.archetype) {
+		const auto moved = record.archetype->remove(record.row);
+		if (moved.is_valid())
+			m_records[moved.index].row = record.row;
+	}
+
+	record.archetype = nullptr;
+	record.alive = false;
+	record.generation++;
+	m_free_list.push_back(entity.index);
+	m_alive--;
+}
+
+bool World::is_alive(Entity entity) const
+{
+	return entity.index < m_records.size() && m_records[entity.index].alive && m_records[entity.index].generation == entity.generation;
+}
+
+Entity World::get_entity(u32 index) const
+{
+	if (index >= m_records.size() || !m_records[index].alive)
+		return INVALID_ENTITY;
+
+	return { index, m_records[index].generation };
+}
+
+Archetype* World::get_or_create_archetype(ComponentMask mask)
+{
+	auto it = m_archetypes.find(mask);
+	if (it != m_archetypes.end())
+		return it->second;
+
+	m_archetype_list.push_back(std::make_unique<Archetype>(mask));
+	auto archetype = m_archetype_list.back().get();
+	m_archetypes[mask] = archetype;
+	return archetype;
+}
+
+void World::move(Entity entity, ComponentMask mask)
+{
+	auto& record = m_records[entity.index];
+	auto src = record.archetype;
+	const auto src_row = record.row;
+
+	if (mask == 0) {
+		if (src) {
+			const auto moved = src->remove(src_row);
+			if (moved.is_valid())
+				m_records[moved.index].row = src_row;
+		}
+
+		record.archetype = nullptr;
+		record.row = 0;
+		return;
+	}
+
+	auto dst = get_or_create_archetype(mask);
+	const auto dst_row = dst->push(entity);
+
+	if (src) {
+		dst->copy_row(dst_row, *src, src_row);
+
+		const auto moved = src->remove(src_row);
+		if (moved.is_valid())
+			m_records[moved.index].row = src_row;
+	}
+
+	record.archetype = dst;
+	record.row = dst_row;
+}
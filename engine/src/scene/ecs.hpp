@@ -0,0 +1,253 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <type_traits>
+#include <unordered_map>
+
+#include <defines.hpp>
+#include <jobs.hpp>
+
+//
+// Archetype based entity-component storage.
+//
+// Entities with the same set of components live in the same Archetype, where every
+// component type is stored in its own contiguous column. Systems iterate the columns
+// of every matching archetype linearly, so component data is visited in memory order.
+// Components must be trivially copyable; rows are moved between archetypes with memcpy.
+//
+
+constexpr u32 MAX_COMPONENTS = 64;
+typedef u64 ComponentMask;
+
+struct Entity {
+	u32 index = ~0u;
+	u32 generation = 0;
+
+	bool is_valid() const { return index != ~0u; }
+	bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const Entity& other) const { return !(*this == other); }
+};
+
+constexpr Entity INVALID_ENTITY = {};
+
+namespace ecs {
+	struct ComponentInfo {
+		u32 size = 0;
+	};
+
+	inline std::array<ComponentInfo, MAX_COMPONENTS>& component_infos() {
+		static std::array<ComponentInfo, MAX_COMPONENTS> infos;
+		return infos;
+	}
+
+	inline u32 next_component_id() {
+		static u32 counter = 0;
+		assert(counter < MAX_COMPONENTS && "Too many component types!");
+		return counter++;
+	}
+
+	template <class T>
+	u32 component_id() {
+		static_assert(std::is_trivially_copyable_v<T>, "Components must be trivially copyable");
+
+		static const u32 id = [] {
+			const auto id = next_component_id();
+			component_infos()[id].size = sizeof(T);
+			return id;
+		}();
+		return id;
+	}
+
+	template <class... T>
+	ComponentMask component_mask() {
+		return ((ComponentMask(1) << component_id<T>()) | ... | ComponentMask(0));
+	}
+}
+
+class Archetype {
+public:
+	explicit Archetype(ComponentMask mask);
+
+	ComponentMask get_mask() const { return m_mask; }
+	u32 size() const { return (u32)m_entities.size(); }
+	const std::vector<Entity>& get_entities() const { return m_entities; }
+
+	bool has(u32 component) const { return m_column_lookup[component] >= 0; }
+
+	template <class T>
+	T* column() {
+		const auto index = m_column_lookup[ecs::component_id<T>()];
+		assert(index >= 0 && "Archetype does not store this component!");
+		return reinterpret_cast<T*>(m_columns[index].data.data());
+	}
+
+	void* get(u32 component, u32 row);
+
+	// appends a zeroed row and returns its index
+	u32 push(Entity entity);
+	// swap-removes a row, returns the entity that was moved into `row` (or INVALID_ENTITY)
+	Entity remove(u32 row);
+
+	// copies every component both archetypes share from `src_row` of `src` into `dst_row`
+	void copy_row(u32 dst_row, Archetype& src, u32 src_row);
+
+private:
+	struct Column {
+		u32 component;
+		u32 element_size;
+		std::vector<u8> data;
+	};
+
+	ComponentMask m_mask;
+	std::vector<Entity> m_entities;
+	std::vector<Column> m_columns;
+	std::array<i32, MAX_COMPONENTS> m_column_lookup;
+};
+
+class World {
+public:
+	World() = default;
+	World(const World&) = delete;
+	World& operator=(const World&) = delete;
+
+	Entity create();
+	void destroy(Entity entity);
+	bool is_alive(Entity entity) const;
+	// entity currently stored in slot `index`, INVALID_ENTITY if the slot is free
+	Entity get_entity(u32 index) const;
+
+	template <class... T>
+	Entity create(const T&... components) {
+		const auto entity = create();
+		(add<T>(entity, components), ...);
+		return entity;
+	}
+
+	template <class T>
+	void add(Entity entity, const T& component) {
+		assert(is_alive(entity) && "Entity is not alive!");
+		const auto id = ecs::component_id<T>();
+		auto& record = m_records[entity.index];
+
+		if (!record.archetype || !record.archetype->has(id))
+			move(entity, (record.archetype ? record.archetype->get_mask() : 0) | (ComponentMask(1) << id));
+
+		std::memcpy(record.archetype->get(id, record.row), &component, sizeof(T));
+	}
+
+	template <class T>
+	void remove(Entity entity) {
+		assert(is_alive(entity) && "Entity is not alive!");
+		const auto& record = m_records[entity.index];
+		if (!record.archetype || !record.archetype->has(ecs::component_id<T>()))
+			return;
+
+		move(entity, record.archetype->get_mask() & ~ecs::component_mask<T>());
+	}
+
+	template <class T>
+	T* get(Entity entity) {
+		if (!is_alive(entity))
+			return nullptr;
+
+		const auto& record = m_records[entity.index];
+		const auto id = ecs::component_id<T>();
+		if (!record.archetype || !record.archetype->has(id))
+			return nullptr;
+
+		return reinterpret_cast<T*>(record.archetype->get(id, record.row));
+	}
+
+	template <class T>
+	bool has(Entity entity) {
+		return get<T>(entity) != nullptr;
+	}
+
+	// calls fn(Entity, T&...) for every entity that has all of T
+	template <class... T, class F>
+	void each(F&& fn) {
+		const auto mask = ecs::component_mask<T...>();
+		for (auto& archetype : m_archetype_list) {
+			if ((archetype->get_mask() & mask) != mask || archetype->size() == 0)
+				continue;
+
+			const auto& entities = archetype->get_entities();
+			auto columns = std::make_tuple(archetype->template column<T>()...);
+			for (u32 row = 0; row < archetype->size(); row++) {
+				fn(entities[row], std::get<T*>(columns)[row]...);
+			}
+		}
+	}
+
+	// same as each() but rows are split in chunks processed as jobs.
+	// fn must only touch the components it is handed.
+	template <class... T, class F>
+	void par_each(F&& fn, u32 chunk_size = 256) {
+		const auto mask = ecs::component_mask<T...>();
+
+		struct Chunk {
+			Archetype* archetype;
+			u32 begin;
+			u32 end;
+		};
+
+		std::vector<Chunk> chunks;
+		for (auto& archetype : m_archetype_list) {
+			if ((archetype->get_mask() & mask) != mask)
+				continue;
+
+			for (u32 begin = 0; begin < archetype->size(); begin += chunk_size) {
+				chunks.push_back({ archetype.get(), begin, std::min(begin + chunk_size, archetype->size()) });
+			}
+		}
+
+		JobSystem::get()->parallel_for((u32)chunks.size(), 1, [&](u32 begin, u32 end) {
+			for (u32 i = begin; i < end; i++) {
+				const auto& chunk = chunks[i];
+				const auto& entities = chunk.archetype->get_entities();
+				auto columns = std::make_tuple(chunk.archetype->template column<T>()...);
+				for (u32 row = chunk.begin; row < chunk.end; row++) {
+					fn(entities[row], std::get<T*>(columns)[row]...);
+				}
+			}
+		});
+	}
+
+	// number of entities with all of T
+	template <class... T>
+	u32 count() const {
+		const auto mask = ecs::component_mask<T...>();
+		u32 total = 0;
+		for (const auto& archetype : m_archetype_list) {
+			if ((archetype->get_mask() & mask) == mask)
+				total += archetype->size();
+		}
+		return total;
+	}
+
+	u32 size() const { return m_alive; }
+	u32 get_archetype_count() const { return (u32)m_archetype_list.size(); }
+
+private:
+	struct EntityRecord {
+		Archetype* archetype = nullptr;
+		u32 row = 0;
+		u32 generation = 0;
+		bool alive = false;
+	};
+
+	std::vector<EntityRecord> m_records;
+	std::vector<u32> m_free_list;
+	u32 m_alive = 0;
+
+	std::unordered_map<ComponentMask, Archetype*> m_archetypes;
+	std::vector<std::unique_ptr<Archetype>> m_archetype_list;
+
+	Archetype* get_or_create_archetype(ComponentMask mask);
+	void move(Entity entity, ComponentMask mask);
+};
@@ -0,0 +1,242 @@
+#include "pvs.hpp"
+
+#include <map>
+#include <format>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+
+#include "bvh.hpp"
+#include <jobs.hpp>
+
+// file layout: header, cell row indices, rows
+struct PvsFileHeader {
+	u32 magic;
+	u32 version;
+	glm::vec3 origin;
+	f32 cell_size;
+	u32 dims[3];
+	u32 mesh_count;
+	u32 row_count;
+};
+
+static const u32 PVS_MAGIC = 0x31535650; // "PVS1"
+static const u32 PVS_VERSION = 1;
+static const u32 PVS_MAX_CELLS_PER_AXIS = 512;
+
+// Moller-Trumbore, distance along the ray or a negative value on a miss
+static f32 intersect_triangle(const Ray& ray, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, f32 max_distance)
+{
+	const auto edge1 = b - a;
+	const auto edge2 = c - a;
+	const auto p = glm::cross(ray.direction, edge2);
+	const auto det = glm::dot(edge1, p);
+	if (glm::abs(det) < 1e-8f)
+		return -1.0f;
+
+	const auto inv_det = 1.0f / det;
+	const auto t_vec = ray.origin - a;
+	const auto u = glm::dot(t_vec, p) * inv_det;
+	if (u < 0.0f || u > 1.0f)
+		return -1.0f;
+
+	const auto q = glm::cross(t_vec, edge1);
+	const auto v = glm::dot(ray.direction, q) * inv_det;
+	if (v < 0.0f || u + v > 1.0f)
+		return -1.0f;
+
+	const auto t = glm::dot(edge2, q) * inv_det;
+	return t >= 0.0f && t <= max_distance ? t : -1.0f;
+}
+
+// small deterministic generator so a bake is reproducible
+static f32 next_random(u32& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+std::shared_ptr<Pvs> Pvs::bake(const PvsGeometry& geometry, const PvsBakeSettings& settings)
+{
+	auto pvs = std::make_shared<Pvs>();
+	pvs->m_mesh_count = (u32)geometry.mesh_bounds.size();
+	pvs->m_words_per_row = (pvs->m_mesh_count + 63) / 64;
+
+	const u32 triangle_count = (u32)geometry.triangle_meshes.size();
+	if (triangle_count == 0 || pvs->m_mesh_count == 0)
+		return pvs;
+
+	// triangle bvh, every ray looks for the first triangle it hits
+	Bvh triangles;
+	auto bounds = AABB::empty();
+	for (u32 i = 0; i < triangle_count; i++) {
+		auto box = AABB::empty();
+		for (u32 j = 0; j < 3; j++)
+			box.grow(geometry.positions[geometry.indices[i * 3 + j]]);
+
+		bounds.grow(box);
+		triangles.insert(box, i);
+	}
+	triangles.update();
+
+	pvs->m_cell_size = settings.cell_size;
+	pvs->m_origin = bounds.min;
+	const auto size = bounds.max - bounds.min;
+	for (u32 axis = 0; axis < 3; axis++) {
+		pvs->m_dims[axis] = std::clamp((u32)glm::ceil(size[axis] / settings.cell_size), 1u, PVS_MAX_CELLS_PER_AXIS);
+	}
+
+	const u32 cell_count = pvs->m_dims.x * pvs->m_dims.y * pvs->m_dims.z;
+	const u32 words = pvs->m_words_per_row;
+	std::vector<u64> cell_bits((u64)cell_count * words, 0);
+	std::vector<u8> cell_valid(cell_count, 0);
+
+	// cells are independent, each one only writes its own bits
+	auto bake_cell = [&](u32 cell) {
+		const glm::uvec3 coord(cell % pvs->m_dims.x, (cell / pvs->m_dims.x) % pvs->m_dims.y, cell / (pvs->m_dims.x * pvs->m_dims.y));
+		AABB box;
+		box.min = pvs->m_origin + glm::vec3((f32)coord.x, (f32)coord.y, (f32)coord.z) * settings.cell_size;
+		box.max = box.min + glm::vec3(settings.cell_size);
+
+		// the camera can not stand inside geometry, leave the cell without a set
+		std::vector<u32> overlapping;
+		triangles.query(box, overlapping);
+		if (!overlapping.empty())
+			return;
+
+		auto row = cell_bits.data() + (u64)cell * words;
+		auto mark = [&](u32 mesh) { row[mesh / 64] |= u64(1) << (mesh % 64); };
+
+		// near field: small meshes next to the cell are easily missed by the rays
+		auto near_box = box;
+		near_box.min -= glm::vec3(settings.cell_size * settings.neighbor_cells);
+		near_box.max += glm::vec3(settings.cell_size * settings.neighbor_cells);
+		for (u32 mesh = 0; mesh < pvs->m_mesh_count; mesh++) {
+			if (!near_box.intersection(geometry.mesh_bounds[mesh]).is_empty())
+				mark(mesh);
+		}
+
+		u32 state = cell * 9781u + 6271u;
+		for (u32 i = 0; i < settings.rays_per_cell; i++) {
+			// random point in the cell, fibonacci sphere direction
+			Ray ray;
+			ray.origin = box.min + glm::vec3(next_random(state), next_random(state), next_random(state)) * settings.cell_size;
+
+			const auto z = 1.0f - 2.0f * (i + 0.5f) / settings.rays_per_cell;
+			const auto radius = glm::sqrt(glm::max(0.0f, 1.0f - z * z));
+			const auto phi = 2.39996323f * i + next_random(state) * 0.1f;
+			ray.direction = glm::vec3(radius * glm::cos(phi), radius * glm::sin(phi), z);
+
+			BvhRayHit hit;
+			const auto found = triangles.raycast(ray, hit, [&](u32 triangle, const AABB&, f32 max_distance) {
+				return intersect_triangle(ray,
+					geometry.positions[geometry.indices[triangle * 3 + 0]],
+					geometry.positions[geometry.indices[triangle * 3 + 1]],
+					geometry.positions[geometry.indices[triangle * 3 + 2]],
+					max_distance);
+			});
+
+			if (found)
+				mark(geometry.triangle_meshes[hit.user_data]);
+		}
+
+		cell_valid[cell] = 1;
+	};
+
+	JobSystem::get()->parallel_for(cell_count, 16, [&](u32 begin, u32 end) {
+		for (u32 cell = begin; cell < end; cell++)
+			bake_cell(cell);
+	});
+
+	// neighbouring cells usually see the same meshes, store every distinct set once
+	std::map<std::vector<u64>, u32> unique_rows;
+	pvs->m_cell_rows.assign(cell_count, NO_ROW);
+	for (u32 cell = 0; cell < cell_count; cell++) {
+		if (!cell_valid[cell])
+			continue;
+
+		std::vector<u64> row(cell_bits.begin() + (u64)cell * words, cell_bits.begin() + (u64)(cell + 1) * words);
+		auto it = unique_rows.find(row);
+		if (it == unique_rows.end()) {
+			it = unique_rows.emplace(row, (u32)(pvs->m_rows.size() / words)).first;
+			pvs->m_rows.insert(pvs->m_rows.end(), row.begin(), row.end());
+		}
+
+		pvs->m_cell_rows[cell] = it->second;
+	}
+
+	return pvs;
+}
+
+std::shared_ptr<Pvs> Pvs::load(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return nullptr;
+
+	PvsFileHeader header{};
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || header.magic != PVS_MAGIC || header.version != PVS_VERSION) {
+		KERROR("Invalid PVS file: {}", path.string());
+		return nullptr;
+	}
+
+	auto pvs = std::make_shared<Pvs>();
+	pvs->m_origin = header.origin;
+	pvs->m_cell_size = header.cell_size;
+	pvs->m_dims = glm::uvec3(header.dims[0], header.dims[1], header.dims[2]);
+	pvs->m_mesh_count = header.mesh_count;
+	pvs->m_words_per_row = (header.mesh_count + 63) / 64;
+
+	pvs->m_cell_rows.resize((u64)header.dims[0] * header.dims[1] * header.dims[2]);
+	pvs->m_rows.resize((u64)header.row_count * pvs->m_words_per_row);
+	file.read(reinterpret_cast<char*>(pvs->m_cell_rows.data()), pvs->m_cell_rows.size() * sizeof(u32));
+	file.read(reinterpret_cast<char*>(pvs->m_rows.data()), pvs->m_rows.size() * sizeof(u64));
+	if (!file) {
+		KERROR("Truncated PVS file: {}", path.string());
+		return nullptr;
+	}
+
+	return pvs;
+}
+
+bool Pvs::save(const std::filesystem::path& path) const
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		KERROR("Could not write PVS file: {}", path.string());
+		return false;
+	}
+
+	PvsFileHeader header{};
+	header.magic = PVS_MAGIC;
+	header.version = PVS_VERSION;
+	header.origin = m_origin;
+	header.cell_size = m_cell_size;
+	header.dims[0] = m_dims.x;
+	header.dims[1] = m_dims.y;
+	header.dims[2] = m_dims.z;
+	header.mesh_count = m_mesh_count;
+	header.row_count = get_row_count();
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(m_cell_rows.data()), m_cell_rows.size() * sizeof(u32));
+	file.write(reinterpret_cast<const char*>(m_rows.data()), m_rows.size() * sizeof(u64));
+	return (bool)file;
+}
+
+const u64* Pvs::lookup(const glm::vec3& position) const
+{
+	if (m_cell_rows.empty())
+		return nullptr;
+
+	const auto cell = glm::floor((position - m_origin) / m_cell_size);
+	if (cell.x < 0.0f || cell.y < 0.0f || cell.z < 0.0f || cell.x >= (f32)m_dims.x || cell.y >= (f32)m_dims.y || cell.z >= (f32)m_dims.z)
+		return nullptr;
+
+	const auto index = ((u32)cell.z * m_dims.y + (u32)cell.y) * m_dims.x + (u32)cell.x;
+	const auto row = m_cell_rows[index];
+	return row == NO_ROW ? nullptr : m_rows.data() + (u64)row * m_words_per_row;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <filesystem>
+#include <glm/glm/glm.hpp>
+
+#include <defines.hpp>
+#include "bounds.hpp"
+
+// triangle soup of a model in model space, every triangle tagged with the mesh it belongs to
+struct PvsGeometry {
+	std::vector<glm::vec3> positions;
+	std::vector<u32> indices;
+	std::vector<u32> triangle_meshes;
+	std::vector<AABB> mesh_bounds;
+};
+
+struct PvsBakeSettings {
+	f32 cell_size = 1.0f;
+	// rays shot from random points of each cell, every mesh hit first is visible from the cell
+	u32 rays_per_cell = 2048;
+	// meshes whose bounds touch the cell grown by this many cells are always visible
+	u32 neighbor_cells = 1;
+};
+
+//
+// Potentially visible sets of a static model.
+// The model bounds are split into a grid of cells. Cells free of geometry are baked
+// by ray casting, cells touched by geometry have no set and see everything. Identical
+// sets are stored once, each cell only holds the index of its set, so a lookup is one
+// grid index computation and one array read.
+//
+class Pvs {
+public:
+	static constexpr u32 NO_ROW = ~0u;
+
+	static std::shared_ptr<Pvs> bake(const PvsGeometry& geometry, const PvsBakeSettings& settings = {});
+	// nullptr when the file is missing or invalid
+	static std::shared_ptr<Pvs> load(const std::filesystem::path& path);
+	bool save(const std::filesystem::path& path) const;
+
+	// visibility bits (one per mesh) of the cell containing the model space `position`,
+	// nullptr outside the grid or inside geometry, where everything must be considered visible
+	const u64* lookup(const glm::vec3& position) const;
+
+	static bool is_visible(const u64* row, u32 mesh) { return !row || (row[mesh / 64] >> (mesh % 64)) & 1; }
+
+	u32 get_mesh_count() const { return m_mesh_count; }
+	u32 get_cell_count() const { return (u32)m_cell_rows.size(); }
+	u32 get_row_count() const { return m_words_per_row ? (u32)(m_rows.size() / m_words_per_row) : 0; }
+
+private:
+	glm::vec3 m_origin = glm::vec3(0.0f);
+	f32 m_cell_size = 1.0f;
+	glm::uvec3 m_dims = glm::uvec3(0);
+
+	u32 m_mesh_count = 0;
+	u32 m_words_per_row = 0;
+
+	// row index per cell (x fastest), NO_ROW for cells without a set
+	std::vector<u32> m_cell_rows;
+	std::vector<u64> m_rows;
+};
@@ -0,0 +1,152 @@
+#include "scene.hpp"
+
+#include <renderer/model.hpp>
+#include <renderer/mesh.hpp>
+#include <utils.hpp>
+
+Entity Scene::spawn_model(const std::string& name, const glm::mat4& transform)
+{
+	const auto model = Model::create(name);
+	const auto& nodes = model->get_nodes();
+	const auto& meshes = model->get_meshes();
+
+	const auto root = m_world.create(Transform{ m_transforms.add(transform) });
+
+	// mirror the model node tree under the root, nodes without meshes only exist in the hierarchy
+	std::vector<TransformHandle> handles;
+	handles.reserve(nodes.transforms.size());
+	for (u64 i = 0; i < nodes.transforms.size(); i++) {
+		const auto parent = nodes.parents[i] < 0 ? m_world.get<Transform>(root)->node : handles[nodes.parents[i]];
+		handles.push_back(m_transforms.add(nodes.transforms[i], parent));
+	}
+
+	ModelInstance instance;
+	instance.model = model;
+	instance.root = m_world.get<Transform>(root)->node;
+
+	for (const auto& ref : nodes.meshes) {
+		const auto& mesh = meshes[ref.mesh];
+
+		Bounds bounds{};
+		bounds.local = mesh->get_bounds();
+		bounds.world = bounds.local;
+		bounds.local_sphere = mesh->get_bounding_sphere();
+		bounds.world_sphere = bounds.local_sphere;
+
+		const auto entity = m_world.create(Transform{ handles[ref.node] }, MeshRenderer{ mesh.get() });
+		bounds.proxy = m_bvh.insert(bounds.world, entity.index);
+		m_world.add(entity, bounds);
+		instance.meshes.push_back(entity);
+	}
+
+	m_models.push_back(std::move(instance));
+	return root;
+}
+
+Entity Scene::spawn_point_light(const glm::vec3& position, const glm::vec3& color, f32 intensity, f32 radius)
+{
+	const auto transform = utils::create_transform(position, glm::vec3(0.0f), glm::vec3(1.0f));
+
+	PointLight light{};
+	light.color = color;
+	light.intensity = intensity;
+	light.radius = radius;
+
+	return m_world.create(Transform{ m_transforms.add(transform) }, light);
+}
+
+Entity Scene::spawn_spot_light(const glm::mat4& transform, const SpotLight& light)
+{
+	return m_world.create(Transform{ m_transforms.add(transform) }, light);
+}
+
+void Scene::set_transform(Entity entity, const glm::mat4& transform)
+{
+	const auto component = m_world.get<Transform>(entity);
+	assert(component && "Entity has no transform!");
+	m_transforms.set_local(component->node, transform);
+}
+
+void Scene::update()
+{
+	m_transforms.update();
+
+	// nothing moved, world bounds and the bvh are still valid
+	if (m_transforms.get_updated_count() == 0)
+		return;
+
+	// bounds only read the (now final) hierarchy, so rows can be refreshed concurrently
+	m_world.par_each<Transform, Bounds>([&](Entity, Transform& transform, Bounds& bounds) {
+		const auto& world = m_transforms.get_world(transform.node);
+		bounds.world = transform_aabb(bounds.local, world);
+		bounds.world_sphere = transform_sphere(bounds.local_sphere, world);
+	});
+
+	m_world.each<Bounds>([&](Entity, Bounds& bounds) {
+		m_bvh.move(bounds.proxy, bounds.world);
+	});
+	m_bvh.update();
+}
+
+void Scene::update_visibility(const glm::vec3& eye)
+{
+	for (auto& instance : m_models) {
+		const auto& pvs = instance.model->get_pvs();
+		const u64* row = nullptr;
+		if (pvs) {
+			const auto eye_model = glm::vec3(glm::inverse(m_transforms.get_world(instance.root)) * glm::vec4(eye, 1.0f));
+			row = pvs->lookup(eye_model);
+		}
+
+		// sets are shared between cells, the flags only change when the camera crosses into another set
+		if (pvs.get() == instance.pvs && row == instance.row)
+			continue;
+
+		instance.pvs = pvs.get();
+		instance.row = row;
+
+		for (u32 i = 0; i < instance.meshes.size(); i++) {
+			const auto index = instance.meshes[i].index;
+			if (index >= m_pvs_hidden.size())
+				m_pvs_hidden.resize(index + 1, 0);
+
+			const u8 hidden = !Pvs::is_visible(row, i);
+			m_pvs_hidden_count += hidden - m_pvs_hidden[index];
+			m_pvs_hidden[index] = hidden;
+		}
+	}
+}
+
+bool Scene::is_potentially_visible(u32 entity_index) const
+{
+	return entity_index >= m_pvs_hidden.size() || !m_pvs_hidden[entity_index];
+}
+
+Entity Scene::raycast(const Ray& ray, f32* distance) const
+{
+	BvhRayHit hit;
+	if (!m_bvh.raycast(ray, hit))
+		return INVALID_ENTITY;
+
+	if (distance)
+		*distance = hit.distance;
+	return m_world.get_entity(hit.user_data);
+}
+
+Entity Scene::nearest(const glm::vec3& point) const
+{
+	BvhRayHit hit;
+	if (!m_bvh.nearest(point, hit))
+		return INVALID_ENTITY;
+
+	return m_world.get_entity(hit.user_data);
+}
+
+void Scene::query(const BoundingSphere& sphere, std::vector<Entity>& out) const
+{
+	std::vector<u32> indices;
+	m_bvh.query(sphere, indices);
+	for (const auto index : indices) {
+		out.push_back(m_world.get_entity(index));
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <glm/glm/glm.hpp>
+
+#include "ecs.hpp"
+#include "components.hpp"
+#include "transform_hierarchy.hpp"
+#include "bvh.hpp"
+#include "pvs.hpp"
+
+class Model;
+
+//
+// Everything placed in the world: entities and their components plus the transform
+// hierarchy their Transform components point into.
+//
+class Scene {
+public:
+	// instantiates a (cached) model, one entity per mesh parented to the returned root entity
+	Entity spawn_model(const std::string& name, const glm::mat4& transform = glm::mat4(1.0f));
+	Entity spawn_point_light(const glm::vec3& position, const glm::vec3& color, f32 intensity, f32 radius);
+	Entity spawn_spot_light(const glm::mat4& transform, const SpotLight& light);
+
+	void set_transform(Entity entity, const glm::mat4& transform);
+
+	// resolves world transforms, world bounds and the bvh, call once per frame before rendering
+	void update();
+
+	// hides the meshes of pvs baked models their camera cell can not see
+	void update_visibility(const glm::vec3& eye);
+	bool is_potentially_visible(u32 entity_index) const;
+	u32 get_pvs_hidden_count() const { return m_pvs_hidden_count; }
+
+	// closest entity whose world box is hit by the ray, INVALID_ENTITY on a miss
+	Entity raycast(const Ray& ray, f32* distance = nullptr) const;
+	// entities whose world box is closest to / overlaps the query
+	Entity nearest(const glm::vec3& point) const;
+	void query(const BoundingSphere& sphere, std::vector<Entity>& out) const;
+
+	World& get_world() { return m_world; }
+	const Bvh& get_bvh() const { return m_bvh; }
+	AABB get_bounds() const { return m_bvh.get_bounds(); }
+	TransformHierarchy& get_transforms() { return m_transforms; }
+	const TransformHierarchy& get_transforms() const { return m_transforms; }
+
+private:
+	World m_world;
+	TransformHierarchy m_transforms;
+	Bvh m_bvh;
+
+	// spawned models, kept to map their pvs bits back to entities
+	struct ModelInstance {
+		std::shared_ptr<Model> model;
+		TransformHandle root;
+		// one entity per ModelNodes::meshes entry, the pvs bit order
+		std::vector<Entity> meshes;
+
+		const Pvs* pvs = nullptr;
+		const u64* row = nullptr;
+	};
+
+	std::vector<ModelInstance> m_models;
+	std::vector<u8> m_pvs_hidden;
+	u32 m_pvs_hidden_count = 0;
+};
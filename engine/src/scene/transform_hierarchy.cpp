@@ -0,0 +1,147 @@
+#include "transform_hierarchy.hpp"
+
+#include <cassert>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__SSE__)
+#include <xmmintrin.h>
+#define TRANSFORM_SIMD 1
+#endif
+
+// out = a * b, column by column. out must not alias a.
+static inline void mul_mat4(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+#if TRANSFORM_SIMD
+	const __m128 a0 = _mm_loadu_ps(&a[0][0]);
+	const __m128 a1 = _mm_loadu_ps(&a[1][0]);
+	const __m128 a2 = _mm_loadu_ps(&a[2][0]);
+	const __m128 a3 = _mm_loadu_ps(&a[3][0]);
+
+	for (u32 i = 0; i < 4; i++) {
+		__m128 column = _mm_mul_ps(a0, _mm_set1_ps(b[i][0]));
+		column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(b[i][1])));
+		column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(b[i][2])));
+		column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(b[i][3])));
+		_mm_storeu_ps(&out[i][0], column);
+	}
+#else
+	out = a * b;
+#endif
+}
+
+static const u8 DIRTY_MOVED = 1;
+static const u8 DIRTY_ADDED = 2;
+
+TransformHandle TransformHierarchy::add(const glm::mat4& local, TransformHandle parent)
+{
+	assert((parent == INVALID_TRANSFORM || parent < m_parent.size()) && "Parent must be added before its children!");
+
+	m_local.push_back(local);
+	m_world.push_back(local);
+	m_parent.push_back(parent);
+	m_dirty.push_back(DIRTY_ADDED);
+	m_moved_frame.push_back(0);
+	m_static_revision++;
+
+	return (TransformHandle)(m_parent.size() - 1);
+}
+
+void TransformHierarchy::set_local(TransformHandle handle, const glm::mat4& local)
+{
+	m_local[handle] = local;
+	m_dirty[handle] |= DIRTY_MOVED;
+}
+
+const glm::mat4& TransformHierarchy::get_local(TransformHandle handle) const
+{
+	return m_local[handle];
+}
+
+const glm::mat4& TransformHierarchy::get_world(TransformHandle handle) const
+{
+	return m_world[handle];
+}
+
+TransformHandle TransformHierarchy::get_parent(TransformHandle handle) const
+{
+	return m_parent[handle];
+}
+
+void TransformHierarchy::update()
+{
+	const u32 count = size();
+	m_updated_count = 0;
+	m_frame++;
+
+	// parents always precede children, so by the time a node is visited its parent
+	// world matrix (and dirty flag) is already final for this frame
+	for (u32 i = 0; i < count; i++) {
+		const auto parent = m_parent[i];
+
+		if (parent != INVALID_TRANSFORM)
+			m_dirty[i] |= m_dirty[parent];
+
+		if (!m_dirty[i])
+			continue;
+
+		if (parent == INVALID_TRANSFORM)
+			m_world[i] = m_local[i];
+		else
+			mul_mat4(m_world[parent], m_local[i], m_world[i]);
+
+		m_updated_count++;
+
+		if (m_dirty[i] & DIRTY_MOVED) {
+			if (is_static((TransformHandle)i)) {
+				m_moving.push_back((TransformHandle)i);
+				m_static_revision++;
+			}
+			m_moved_frame[i] = m_frame;
+		}
+	}
+
+	std::fill(m_dirty.begin(), m_dirty.end(), (u8)0);
+
+	// nodes at rest for long enough become static again
+	const auto settled = std::erase_if(m_moving, [&](TransformHandle handle) {
+		return is_static(handle);
+	});
+	if (settled > 0)
+		m_static_revision++;
+}
+
+void TransformHierarchy::clear()
+{
+	m_local.clear();
+	m_world.clear();
+	m_parent.clear();
+	m_dirty.clear();
+	m_moved_frame.clear();
+	m_moving.clear();
+	m_updated_count = 0;
+	m_static_revision++;
+}
+
+u32 TransformHierarchy::size() const
+{
+	return (u32)m_parent.size();
+}
+
+u32 TransformHierarchy::get_updated_count() const
+{
+	return m_updated_count;
+}
+
+bool TransformHierarchy::is_static(TransformHandle handle) const
+{
+	return m_frame - m_moved_frame[handle] >= STATIC_FRAMES;
+}
+
+bool TransformHierarchy::has_moved(TransformHandle handle) const
+{
+	return m_moved_frame[handle] == m_frame;
+}
+
+u64 TransformHierarchy::get_static_revision() const
+{
+	return m_static_revision;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm/glm.hpp>
+
+#include <defines.hpp>
+
+// index of a node inside the TransformHierarchy arrays
+typedef u32 TransformHandle;
+constexpr TransformHandle INVALID_TRANSFORM = ~0u;
+
+//
+// Flattened scene hierarchy stored as parallel arrays.
+// Nodes are always appended after their parent, so the arrays stay parent-sorted and
+// a single forward sweep in update() resolves every world matrix without recursion.
+// Render passes only read the cached world matrices.
+//
+class TransformHierarchy {
+public:
+	// nodes that did not move for this many updates count as static, their shadows are cached
+	static const u32 STATIC_FRAMES = 30;
+
+	TransformHandle add(const glm::mat4& local, TransformHandle parent = INVALID_TRANSFORM);
+
+	void set_local(TransformHandle handle, const glm::mat4& local);
+	const glm::mat4& get_local(TransformHandle handle) const;
+	const glm::mat4& get_world(TransformHandle handle) const;
+	TransformHandle get_parent(TransformHandle handle) const;
+
+	// recomputes the world matrix of every dirty node (and its descendants), call once per frame
+	void update();
+	void clear();
+
+	u32 size() const;
+	// nodes whose world matrix changed in the last update()
+	u32 get_updated_count() const;
+
+	// added nodes are static until set_local() moves them or a parent
+	bool is_static(TransformHandle handle) const;
+	// set_local() moved the node or a parent in the last update()
+	bool has_moved(TransformHandle handle) const;
+	// changes whenever a node is added, starts moving or settles
+	u64 get_static_revision() const;
+
+private:
+	std::vector<glm::mat4> m_local;
+	std::vector<glm::mat4> m_world;
+	std::vector<TransformHandle> m_parent;
+	// DIRTY_MOVED and DIRTY_ADDED bits
+	std::vector<u8> m_dirty;
+	// update() at which the world matrix last moved
+	std::vector<u64> m_moved_frame;
+	// nodes that moved in the last STATIC_FRAMES updates
+	std::vector<TransformHandle> m_moving;
+
+	u32 m_updated_count = 0;
+	// starts far enough ahead that nodes which never moved are static
+	u64 m_frame = STATIC_FRAMES;
+	u64 m_static_revision = 0;
+};
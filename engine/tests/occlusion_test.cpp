@@ -0,0 +1,137 @@
+#include <cstdio>
+#include <glm/glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <jobs.hpp>
+#include <renderer/occlusion.hpp>
+
+//
+// Headless checks of OcclusionCuller on known layouts. The camera sits at the origin
+// looking down -z, a 4 x 4 m wall 10 m away is the only occluder.
+//
+
+static u32 g_failures = 0;
+
+#define CHECK(expression)                                                          \
+	do {                                                                           \
+		if (!(expression)) {                                                       \
+			std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expression); \
+			g_failures++;                                                          \
+		}                                                                          \
+	} while (0)
+
+static AABB make_box(const glm::vec3& min, const glm::vec3& max)
+{
+	return { min, max };
+}
+
+// closed cube of 12 triangles, the same layout as Occluder::create_inner_box
+static Occluder make_cube(const AABB& box)
+{
+	Occluder cube;
+	for (u32 i = 0; i < 8; i++)
+		cube.positions.push_back(box.get_corner(i));
+	cube.indices = {
+		0, 2, 6, 0, 6, 4,  1, 5, 7, 1, 7, 3,
+		0, 4, 5, 0, 5, 1,  2, 3, 7, 2, 7, 6,
+		0, 1, 3, 0, 3, 2,  4, 6, 7, 4, 7, 5,
+	};
+	return cube;
+}
+
+static void test_occluder(OcclusionCuller& culler, const glm::mat4& view_projection)
+{
+	const auto wall_bounds = make_box(glm::vec3(-2.0f, -2.0f, -10.1f), glm::vec3(2.0f, 2.0f, -10.0f));
+	const auto wall = make_cube(wall_bounds);
+
+	culler.begin(view_projection);
+	culler.add_occluder(&wall, glm::mat4(1.0f), wall_bounds);
+	culler.rasterize();
+	CHECK(culler.get_stats().occluders == 1);
+
+	// fully behind the wall
+	CHECK(!culler.is_visible(make_box(glm::vec3(-0.5f, -0.5f, -21.0f), glm::vec3(0.5f, 0.5f, -20.0f))));
+	// behind it but reaching past its edge on screen
+	CHECK(culler.is_visible(make_box(glm::vec3(0.0f, -0.5f, -21.0f), glm::vec3(6.0f, 0.5f, -20.0f))));
+	// in front of it
+	CHECK(culler.is_visible(make_box(glm::vec3(-0.5f, -0.5f, -6.0f), glm::vec3(0.5f, 0.5f, -5.0f))));
+	// cutting through it, its nearest point is in front
+	CHECK(culler.is_visible(make_box(glm::vec3(-0.5f, -0.5f, -12.0f), glm::vec3(0.5f, 0.5f, -8.0f))));
+	// behind the camera, left to the frustum culling
+	CHECK(culler.is_visible(make_box(glm::vec3(-0.5f, -0.5f, 5.0f), glm::vec3(0.5f, 0.5f, 6.0f))));
+	// crossing the near plane
+	CHECK(culler.is_visible(make_box(glm::vec3(-0.5f, -0.5f, -1.0f), glm::vec3(0.5f, 0.5f, 1.0f))));
+	CHECK(culler.get_stats().occluded == 1);
+}
+
+static void test_empty(OcclusionCuller& culler, const glm::mat4& view_projection)
+{
+	culler.begin(view_projection);
+	culler.rasterize();
+	CHECK(culler.is_visible(make_box(glm::vec3(-0.5f, -0.5f, -21.0f), glm::vec3(0.5f, 0.5f, -20.0f))));
+}
+
+static void test_occluder_behind_camera(OcclusionCuller& culler, const glm::mat4& view_projection)
+{
+	// a wall behind the eye is dropped instead of being projected through it
+	const auto wall_bounds = make_box(glm::vec3(-2.0f, -2.0f, 10.0f), glm::vec3(2.0f, 2.0f, 10.1f));
+	const auto wall = make_cube(wall_bounds);
+
+	culler.begin(view_projection);
+	culler.add_occluder(&wall, glm::mat4(1.0f), wall_bounds);
+	culler.rasterize();
+	CHECK(culler.get_stats().occluders == 0);
+	CHECK(culler.is_visible(make_box(glm::vec3(-0.5f, -0.5f, -21.0f), glm::vec3(0.5f, 0.5f, -20.0f))));
+}
+
+static void test_inner_box()
+{
+	const auto box = make_box(glm::vec3(-1.0f, -2.0f, -3.0f), glm::vec3(1.0f, 2.0f, 3.0f));
+	const auto cube = make_cube(box);
+	const auto proxy = Occluder::create_inner_box(cube.positions, cube.indices);
+	CHECK(proxy != nullptr);
+	if (proxy) {
+		// strictly inside, so it never hides more than the mesh
+		for (const auto& position : proxy->positions) {
+			for (u32 axis = 0; axis < 3; axis++)
+				CHECK(glm::abs(position[axis]) < box.max[axis]);
+		}
+	}
+
+	// without its top the cube encloses nothing
+	auto open = cube;
+	open.indices.erase(open.indices.begin() + 18, open.indices.begin() + 24);
+	CHECK(Occluder::create_inner_box(open.positions, open.indices) == nullptr);
+
+	// a hollow shell, a small cube inside a large one
+	auto shell = make_cube(make_box(glm::vec3(-4.0f), glm::vec3(4.0f)));
+	const auto inner = make_cube(make_box(glm::vec3(-3.0f), glm::vec3(3.0f)));
+	for (const auto index : inner.indices)
+		shell.indices.push_back(index + 8);
+	shell.positions.insert(shell.positions.end(), inner.positions.begin(), inner.positions.end());
+	CHECK(Occluder::create_inner_box(shell.positions, shell.indices) == nullptr);
+}
+
+int main()
+{
+	JobSystem::init(2);
+
+	const auto projection = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 100.0f);
+	const auto view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	const auto view_projection = projection * view;
+
+	OcclusionCuller culler;
+	test_occluder(culler, view_projection);
+	test_empty(culler, view_projection);
+	test_occluder_behind_camera(culler, view_projection);
+	test_inner_box();
+
+	JobSystem::shutdown();
+
+	if (g_failures) {
+		std::printf("%u checks failed\n", g_failures);
+		return 1;
+	}
+	std::printf("all checks passed\n");
+	return 0;
+}
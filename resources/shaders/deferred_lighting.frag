@@ -13,25 +13,89 @@ layout(binding = 0) uniform sampler2D albedo_map;
 layout(binding = 1) uniform sampler2D normal_map;
 layout(binding = 2) uniform sampler2D mra_map;
 layout(binding = 3) uniform sampler2D emissive_map;
-layout(binding = 4) uniform sampler2D world_map;
+layout(binding = 4) uniform sampler2D depth_map;
 layout(binding = 5) uniform samplerCube irradiance_map;
 layout(binding = 6) uniform samplerCube prefilter_map;
 layout(binding = 7) uniform sampler2D brdf_lut;
 layout(binding = 8) uniform sampler2D shadow_map;
 
-uniform mat4 light_space_matrix;
+// sun shadow cascades in a 2 x 2 atlas, see ShadowMapPass
+const int SHADOW_CASCADES = 4;
+const int SHADOW_ATLAS_COLUMNS = 2;
+uniform mat4 cascade_matrices[SHADOW_CASCADES];
+// view depth at which each cascade ends
+uniform float cascade_splits[SHADOW_CASCADES];
+uniform mat4 inverse_view_projection;
+
+// prefiltered exponential variance moments, one layer per cascade
+layout(binding = 10) uniform sampler2DArray shadow_moments;
+uniform bool filtered_shadows;
+// visibility below this is cut off, hides the light bleeding of overlapping casters
+uniform float light_bleeding;
+// must match shadow_moments.frag
+const float POSITIVE_EXPONENT = 40.0f;
+const float NEGATIVE_EXPONENT = 5.0f;
+// moment texels a pixel footprint may cover, coarser mips only blur the shadow away
+const float MAX_FILTER_TEXELS = 4.0f;
+
+// virtual shadow map pages, see VirtualShadowMap
+const uint VIRTUAL_PAGES = 128u;
+const uint POOL_PAGES = 32u;
+const float PAGE_SIZE = 128.0f;
+uniform bool virtual_shadows;
+uniform mat4 virtual_matrix;
+// two texels in the depth units of virtual_matrix
+uniform float virtual_bias;
+layout(binding = 9) uniform sampler2D virtual_pool;
+
+// 0 for pages that are not resident, otherwise the pool page + 1
+layout (std430, binding = 9) readonly buffer PageTable {
+    uint page_table[];
+};
+
+// point and spot lights, layout of LightData in light_clusters.hpp
+struct Light {
+    vec4 position_range;
+    vec4 color_type;
+    vec4 direction_outer;
+    vec4 params;
+};
+
+const float LIGHT_SPOT = 1.0f;
+
+// shadows of point and spot lights, see LocalShadowAtlas. params.y of a light indexes local_shadows
+struct LocalShadow {
+    // one face for spot lights, +x -x +y -y +z -z for point lights
+    mat4 faces[6];
+    // atlas uv offset and scale of every face
+    vec4 rects[6];
+    // x world size of a texel one unit away from the light
+    vec4 params;
+};
 
-// lights
-uniform vec3 lightPositions[4] = {
-    vec3(7.7f, 2.0f, 10.5f), vec3(7.7f, 5.0f, 10.5f),
-    vec3(-5.3f, 3.5f, 10.5f), vec3(4.0f, -1.0f, -2.5f)
+layout (std430, binding = 10) readonly buffer LocalShadows {
+    LocalShadow local_shadows[];
 };
+layout(binding = 11) uniform sampler2D local_shadow_atlas;
 
-uniform vec3 lightColors[4] = {
-	vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, 0.0f),
-	vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, 0.0f)        
+layout (std430, binding = 5) readonly buffer Lights {
+    Light lights[];
 };
 
+// offset and count into light_indices per cluster
+layout (std430, binding = 6) readonly buffer ClusterGrid {
+    uvec2 clusters[];
+};
+
+layout (std430, binding = 7) readonly buffer LightIndices {
+    uint light_indices[];
+};
+
+// must match LightClusters, depth slice = log(view depth) * cluster_scale + cluster_bias
+const uvec3 CLUSTER_GRID = uvec3(16, 9, 24);
+uniform float cluster_scale;
+uniform float cluster_bias;
+
 vec3 sun_position = { 1.0f, 1.0f, 0.0f };
 vec3 sun_color = { 0.8f, 0.7f, 0.8f };
 float sun_intensity = 10.0f;
@@ -83,83 +147,185 @@ vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness)
     return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
 }   
 
-vec3 pbr(vec3 albedo, vec3 emissive, float metallic, float roughness, float ao, vec3 normal, vec3 view_dir, vec3 position) {
-    vec3 N = normal;
-    vec3 V = view_dir;
+// outgoing radiance toward V of a light from direction L
+vec3 brdf(vec3 N, vec3 V, vec3 L, vec3 radiance, vec3 albedo, float metallic, float roughness, vec3 F0) {
+    vec3 H = normalize(V + L);
 
-	// interpolate surface reflection between 0.04 (minimum) and the albedo value
-	// in relation to the metallic factor of the material
-	vec3 F0 = vec3(0.04); 
-	F0      = mix(F0, albedo, metallic);
+    vec3 F  = fresnelSchlick(max(dot(H, V), 0.0), F0);
 
-    vec3 Lo = vec3(0.0f);
-    for(int i = 0; i < 2; ++i) {
-        vec3 L = normalize(lightPositions[i] - position);
-        vec3 H = normalize(V + L);
+    float NDF = DistributionGGX(N, H, roughness);
+    float G   = GeometrySmith(N, V, L, roughness);
+
+    vec3 numerator    = NDF * G * F;
+    // add 0.0001 to the denominator to prevent divide by zero
+    float denominator = 4.0f * max(dot(N, V), 0.0f) * max(dot(N, L), 0.0f) + 0.0001f;
+    vec3 specular     = numerator / denominator;
 
-        float distance = length(lightPositions[i] - position);
-        float attenuation = 1.0f / (distance * distance);
-        vec3 radiance = lightColors[i] * attenuation;
+    vec3 kS = F;
+    vec3 kD = vec3(1.0f) - kS;
+
+    kD *= 1.0f - metallic;
 
-        vec3 F  = fresnelSchlick(max(dot(H, V), 0.0), F0);
+    float NdotL = max(dot(N, L), 0.0f);
+    return (kD * albedo / PI + specular) * radiance * NdotL;
+}
 
-		float NDF = DistributionGGX(N, H, roughness);
-        float G   = GeometrySmith(N, V, L, roughness);
+float chebyshev_upper_bound(vec2 moments, float depth, float min_variance) {
+    float variance = max(moments.y - moments.x * moments.x, min_variance);
+    float d = depth - moments.x;
+    float p = variance / (variance + d * d);
+    p = clamp((p - light_bleeding) / (1.0f - light_bleeding), 0.0f, 1.0f);
+    return depth <= moments.x ? 1.0f : p;
+}
 
-        vec3 numerator    = NDF * G * F;
-        // add 0.0001 to the denominator to prevent divide by zero
-        float denominator = 4.0f * max(dot(N, V), 0.0f) * max(dot(N, L), 0.0f) + 0.0001f;
-        vec3 specular     = numerator / denominator;
+// one trilinear fetch of the blurred moments, the filtering is already in them.
+// `texels` is the number of moment texels the pixel covers and picks the mip
+float evsm_visibility(vec2 uv, int cascade, float depth, float texels) {
+    float lod = log2(clamp(texels, 1.0f, MAX_FILTER_TEXELS));
+    vec4 moments = textureLod(shadow_moments, vec3(uv, float(cascade)), lod);
 
-        vec3 kS = F;
-        vec3 kD = vec3(1.0f) - kS;
+    depth = depth * 2.0f - 1.0f;
+    float positive = exp(POSITIVE_EXPONENT * depth);
+    float negative = -exp(-NEGATIVE_EXPONENT * depth);
 
-        kD *= 1.0f - metallic;
+    // the variance floor follows the slope of the warp at this depth
+    float positive_floor = 0.0001f * POSITIVE_EXPONENT * POSITIVE_EXPONENT * positive * positive;
+    float negative_floor = 0.0001f * NEGATIVE_EXPONENT * NEGATIVE_EXPONENT * negative * negative;
+    return min(chebyshev_upper_bound(moments.xy, positive, positive_floor), chebyshev_upper_bound(moments.zw, negative, negative_floor));
+}
 
-        float NdotL = max(dot(N, L), 0.0f);
-        Lo += (kD * albedo / PI + specular) * radiance * NdotL;
+float sun_shadow(vec3 position, vec3 normal) {
+    float depth = -(view * vec4(position, 1.0f)).z;
+    int cascade = 0;
+    while (cascade < SHADOW_CASCADES && depth > cascade_splits[cascade])
+        cascade++;
+
+    // staggered cascades keep the volume fitted to an older camera, a pixel that left it
+    // falls through to the next, larger cascade
+    vec3 proj_coords = vec3(0.0f);
+    for (; cascade < SHADOW_CASCADES; cascade++) {
+        vec4 pos_light_space = cascade_matrices[cascade] * vec4(position, 1.0f);
+        proj_coords = pos_light_space.xyz / pos_light_space.w * 0.5f + 0.5f;
+        if (all(greaterThanEqual(proj_coords, vec3(0.0f))) && all(lessThanEqual(proj_coords, vec3(1.0f))))
+            break;
+    }
+    // if pixel is outside every cascade volume, lets make it not shadow
+    if (cascade == SHADOW_CASCADES)
+        return 0.0f;
+
+    vec2 tile = vec2(cascade % SHADOW_ATLAS_COLUMNS, cascade / SHADOW_ATLAS_COLUMNS);
+    vec2 atlas_size = vec2(SHADOW_ATLAS_COLUMNS, (SHADOW_CASCADES + SHADOW_ATLAS_COLUMNS - 1) / SHADOW_ATLAS_COLUMNS);
+    vec2 uv = (proj_coords.xy + tile) / atlas_size;
+    if (filtered_shadows) {
+        // world size of a pixel at this depth and of a moment texel of the cascade, the receiver slope is ignored
+        float pixel_size = 2.0f * depth / (projection[1][1] * float(textureSize(depth_map, 0).y));
+        mat4 light = cascade_matrices[cascade];
+        float texel_size = 2.0f / (length(vec3(light[0][0], light[1][0], light[2][0])) * float(textureSize(shadow_moments, 0).x));
+        return 1.0f - evsm_visibility(proj_coords.xy, cascade, proj_coords.z, pixel_size / texel_size);
     }
 
-    //
-    // sun
-    //
-    {
-        vec3 L = normalize(sun_position - vec3(0.0f, 0.0f, 0.0f));
-        vec3 H = normalize(V + L);
+    float closest_depth = texture(shadow_map, uv).r;
+    float bias = max(0.005 * (1.0 - dot(normal, normalize(sun_position))), 0.005);
+    return proj_coords.z - bias > closest_depth ? 1.0 : 0.0;
+}
 
-        vec3 radiance = sun_color * sun_intensity;
+// -1 when the page is not resident yet
+float virtual_shadow(vec3 position, vec3 normal) {
+    vec3 coords = (virtual_matrix * vec4(position, 1.0f)).xyz * 0.5f + 0.5f;
+    if (any(lessThan(coords.xy, vec2(0.0f))) || any(greaterThanEqual(coords.xy, vec2(1.0f))))
+        return -1.0f;
+
+    vec2 virtual_coords = coords.xy * float(VIRTUAL_PAGES);
+    uvec2 page = uvec2(virtual_coords);
+    uint entry = page_table[page.x + page.y * VIRTUAL_PAGES];
+    if (entry == 0u)
+        return -1.0f;
+
+    // stay half a texel inside the page, its neighbours in the pool are unrelated
+    uint physical = entry - 1u;
+    vec2 in_page = clamp(fract(virtual_coords), 0.5f / PAGE_SIZE, 1.0f - 0.5f / PAGE_SIZE);
+    vec2 uv = (vec2(physical % POOL_PAGES, physical / POOL_PAGES) + in_page) / float(POOL_PAGES);
+    float closest_depth = texture(virtual_pool, uv).r;
+    float bias = virtual_bias * (1.0f + 4.0f * (1.0f - max(dot(normal, normalize(sun_position)), 0.0f)));
+    return coords.z - bias > closest_depth ? 1.0 : 0.0;
+}
 
-        vec3 F  = fresnelSchlick(max(dot(H, V), 0.0), F0);
+// 1 in shadow of the point or spot light, 0 lit
+float local_shadow(Light light, vec3 position, vec3 normal)
+{
+    int index = int(light.params.y);
+    vec3 from_light = position - light.position_range.xyz;
+
+    int face = 0;
+    if (light.color_type.w != LIGHT_SPOT) {
+        vec3 axis = abs(from_light);
+        if (axis.x >= axis.y && axis.x >= axis.z)
+            face = from_light.x > 0.0f ? 0 : 1;
+        else if (axis.y >= axis.z)
+            face = from_light.y > 0.0f ? 2 : 3;
+        else
+            face = from_light.z > 0.0f ? 4 : 5;
+    }
 
-		float NDF = DistributionGGX(N, H, roughness);
-        float G   = GeometrySmith(N, V, L, roughness);
+    // the texel size grows with the distance to the light, so does the normal offset
+    float texel = local_shadows[index].params.x * length(from_light);
+    vec4 clip = local_shadows[index].faces[face] * vec4(position + normal * texel * 1.5f, 1.0f);
+    vec3 coords = clip.xyz / clip.w * 0.5f + 0.5f;
+    if (coords.z > 1.0f)
+        return 0.0f;
+
+    // clamped half a texel inside the slot, the neighbouring slots belong to other lights
+    vec4 rect = local_shadows[index].rects[face];
+    vec2 half_texel = 0.5f / vec2(textureSize(local_shadow_atlas, 0));
+    vec2 uv = clamp(rect.xy + coords.xy * rect.zw, rect.xy + half_texel, rect.xy + rect.zw - half_texel);
+    float closest = texture(local_shadow_atlas, uv).r;
+    return coords.z - 0.0005f > closest ? 1.0f : 0.0f;
+}
 
-        vec3 numerator    = NDF * G * F;
-        // add 0.0001 to the denominator to prevent divide by zero
-        float denominator = 4.0f * max(dot(N, V), 0.0f) * max(dot(N, L), 0.0f) + 0.0001f;
-        vec3 specular     = numerator / denominator;
+uint cluster_index(vec3 position) {
+    float depth = -(view * vec4(position, 1.0f)).z;
+    uint slice = uint(clamp(floor(log(depth) * cluster_scale + cluster_bias), 0.0f, float(CLUSTER_GRID.z - 1)));
+    uvec2 tile = min(uvec2(tex_coords * vec2(CLUSTER_GRID.xy)), CLUSTER_GRID.xy - 1);
+    return tile.x + tile.y * CLUSTER_GRID.x + slice * CLUSTER_GRID.x * CLUSTER_GRID.y;
+}
 
-        vec3 kS = F;
-        vec3 kD = vec3(1.0f) - kS;
+vec3 pbr(vec3 albedo, vec3 emissive, float metallic, float roughness, float ao, vec3 normal, vec3 view_dir, vec3 position) {
+    vec3 N = normal;
+    vec3 V = view_dir;
 
-        kD *= 1.0f - metallic;
+	// interpolate surface reflection between 0.04 (minimum) and the albedo value
+	// in relation to the metallic factor of the material
+	vec3 F0 = vec3(0.04); 
+	F0      = mix(F0, albedo, metallic);
 
-        float NdotL = max(dot(N, L), 0.0f);
-        Lo += (kD * albedo / PI + specular) * radiance * NdotL;
+    // only the lights whose range reaches this cluster
+    vec3 Lo = vec3(0.0f);
+    uvec2 cluster = clusters[cluster_index(position)];
+    for (uint i = 0; i < cluster.y; ++i) {
+        Light light = lights[light_indices[cluster.x + i]];
+
+        vec3 to_light = light.position_range.xyz - position;
+        float distance = length(to_light);
+        vec3 L = to_light / distance;
+
+        // inverse square, windowed to reach zero at the range the clusters were built with
+        float falloff = clamp(1.0f - pow(distance / light.position_range.w, 4.0f), 0.0f, 1.0f);
+        float attenuation = falloff * falloff / (distance * distance + 0.0001f);
+        if (light.color_type.w == LIGHT_SPOT)
+            attenuation *= smoothstep(light.direction_outer.w, light.params.x, dot(-L, light.direction_outer.xyz));
+        if (light.params.y >= 0.0f && attenuation > 0.0f)
+            attenuation *= 1.0f - local_shadow(light, position, normal);
+
+        Lo += brdf(N, V, L, light.color_type.rgb * attenuation, albedo, metallic, roughness, F0);
     }
 
-    // shadow
-    vec4 pos_light_space = light_space_matrix * vec4(position, 1.0f);
-    vec3 proj_coords = pos_light_space.xyz / pos_light_space.w;
-    proj_coords = proj_coords * 0.5f + 0.5f;
-    float closest_depth = texture(shadow_map, proj_coords.xy).r;
-    float current_depth = proj_coords.z;
-    float bias = max(0.005 * (1.0 - dot(normal, normalize(sun_position))), 0.005);  
-    float shadow = current_depth - bias > closest_depth ? 1.0 : 0.0; 
-    // if pixel is further than the shadow map, lets make it not shadow
-    if (proj_coords.z > 1.0f)
-        shadow = 0.0f;
+    // sun
+    vec3 sun = brdf(N, V, normalize(sun_position), sun_color * sun_intensity, albedo, metallic, roughness, F0);
 
+    // the cascades cover what the virtual map has no page for yet
+    float shadow = virtual_shadows ? virtual_shadow(position, normal) : -1.0f;
+    if (shadow < 0.0f)
+        shadow = sun_shadow(position, normal);
 
     //vec3 kS = fresnelSchlick(max(dot(N, V), 0.0f), F0);
     vec3 F = fresnelSchlickRoughness(max(dot(N, V), 0.0), F0, roughness);
@@ -179,23 +345,41 @@ vec3 pbr(vec3 albedo, vec3 emissive, float metallic, float roughness, float ao,
     vec3 irradiance = texture(irradiance_map, N).rgb;
     vec3 diffuse = irradiance * albedo;
     vec3 ambient =(kD * diffuse + specular) * ao;
-    vec3 color = ambient +  (1.0f - shadow) *  (Lo + emissive);
+    vec3 color = ambient + (1.0f - shadow) * sun + Lo + emissive;
 
 
     return color;
 }
 
+vec3 decode_normal(vec2 encoded) {
+    vec2 f = encoded * 2.0f - 1.0f;
+    vec3 n = vec3(f.x, f.y, 1.0f - abs(f.x) - abs(f.y));
+    float t = clamp(-n.z, 0.0f, 1.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
 void main() {
-	vec3 position = texture(world_map, tex_coords).rgb;
+	// nothing was drawn here, the skybox fills it later
+	float depth = texture(depth_map, tex_coords).r;
+	if (depth >= 1.0f) {
+		out_color = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		return;
+	}
+
+	vec4 world = inverse_view_projection * vec4(vec3(tex_coords, depth) * 2.0f - 1.0f, 1.0f);
+	vec3 position = world.xyz / world.w;
 
-	vec3 normal = texture(normal_map, tex_coords).rgb;
+	vec3 normal = decode_normal(texture(normal_map, tex_coords).rg);
 	vec3 view_dir = normalize(eye_pos - position);
 
 	vec3 albedo = texture(albedo_map, tex_coords).rgb;
 	vec3 emissive = texture(emissive_map, tex_coords).rgb;
-	float metallic = texture(mra_map, tex_coords).b;
-	float roughness = texture(mra_map, tex_coords).g;
-	float ao = texture(mra_map, tex_coords).r;
+	vec3 mra = texture(mra_map, tex_coords).rgb;
+	float metallic = mra.b;
+	float roughness = mra.g;
+	float ao = mra.r;
 
     vec3 pbr_color = pbr(albedo, emissive, metallic, roughness, ao, normal, view_dir, position);
 
@@ -1,52 +1,71 @@
 #version 430 core
 
 layout (location = 0) out vec4 g_albedo;
-layout (location = 1) out vec4 g_normals;
+layout (location = 1) out vec2 g_normals;
 layout (location = 2) out vec4 g_mra;
-layout (location = 3) out vec4 g_emissive;
-layout (location = 4) out vec4 g_world;
+layout (location = 3) out vec3 g_emissive;
 
 in VS_OUT {
     vec3 normal;
     vec2 uvs;
-    vec3 frag_pos;
     mat3 tbn;
 } fs_in;
 
+flat in uint material_index;
+
 layout (std140, binding = 0) uniform Matrices {
 	mat4 view;
 	mat4 projection;
 	vec3 eye_pos;
 };
 
-layout(binding = 0) uniform sampler2D albedo_map;
-layout(binding = 1) uniform sampler2D normal_map;
-layout(binding = 2) uniform sampler2D mra_map;
-layout(binding = 3) uniform sampler2D emissive_map;
+// textures of the same size and format share an array, each material picks its layers
+layout(binding = 0) uniform sampler2DArray albedo_maps;
+layout(binding = 1) uniform sampler2DArray normal_maps;
+layout(binding = 2) uniform sampler2DArray mra_maps;
+layout(binding = 3) uniform sampler2DArray emissive_maps;
+
+struct Material {
+	float metallic_factor;
+	float roughness_factor;
+	float emissive_factor;
+	float ao_factor;
+	uvec4 layers; // albedo, normal, mra, emissive
+};
+
+layout (std430, binding = 4) readonly buffer Materials {
+	Material materials[];
+};
+
+// octahedral normal encoding, unit vector folded onto [0, 1]^2 for a rg16 target
+vec2 oct_wrap(vec2 v) {
+    return (1.0f - abs(v.yx)) * vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+}
 
-uniform float metallic_factor = 1.0f;
-uniform float roughness_factor = 1.0f;
-uniform float emissive_factor = 1.0f;
-uniform float ao_factor = 1.0f;
+vec2 encode_normal(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    n.xy = n.z >= 0.0f ? n.xy : oct_wrap(n.xy);
+    return n.xy * 0.5f + 0.5f;
+}
 
 void main() {
+    Material material = materials[material_index];
+
     // albedo
-    g_albedo = texture(albedo_map, fs_in.uvs);
+    g_albedo = texture(albedo_maps, vec3(fs_in.uvs, material.layers.x));
 
     //normals
-    vec3 n = texture(normal_map, fs_in.uvs).rgb;
+    vec3 n = texture(normal_maps, vec3(fs_in.uvs, material.layers.y)).rgb;
     n = n * 2.0f - 1.0f;
-    g_normals = vec4(normalize(fs_in.tbn * n), 0.0f);
+    g_normals = encode_normal(normalize(fs_in.tbn * n));
 
     // emissive
-    g_emissive = texture(emissive_map, fs_in.uvs) * emissive_factor;
+    g_emissive = texture(emissive_maps, vec3(fs_in.uvs, material.layers.w)).rgb * material.emissive_factor;
 
     // mra
-    float m = texture(mra_map, fs_in.uvs).b * metallic_factor;
-    float r = texture(mra_map, fs_in.uvs).g * roughness_factor;
-    float a = texture(mra_map, fs_in.uvs).r * ao_factor;
+    vec3 mra = texture(mra_maps, vec3(fs_in.uvs, material.layers.z)).rgb;
+    float m = mra.b * material.metallic_factor;
+    float r = mra.g * material.roughness_factor;
+    float a = mra.r * material.ao_factor;
     g_mra = vec4(a, r, m, 0.0f);
-
-    // world
-    g_world = vec4(fs_in.frag_pos, 1.0f);
 }
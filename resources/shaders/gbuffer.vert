@@ -5,8 +5,12 @@ layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texCoord;
 layout (location = 3) in vec3 tanget;
 layout (location = 4) in vec3 bitanget;
+layout (location = 5) in mat4 instance_model;
+layout (location = 9) in uint instance_material;
 
 uniform mat4 model = mat4(1.0f);
+uniform uint material = 0;
+uniform bool instanced = false;
 layout (std140, binding = 0) uniform Matrices {
     mat4 view;
     mat4 projection;
@@ -18,19 +22,22 @@ uniform mat4 lightSpaceMatrix;
 out VS_OUT {
     vec3 normal;
     vec2 uvs;
-    vec3 frag_pos;
     mat3 tbn;
 } vs_out;
 
+flat out uint material_index;
+
 void main() {
-    vs_out.normal = mat3(transpose(inverse(model))) * normal;
+    mat4 model_matrix = instanced ? instance_model : model;
+    material_index = instanced ? instance_material : material;
+
+    vs_out.normal = mat3(transpose(inverse(model_matrix))) * normal;
     vs_out.uvs = texCoord;
-    vs_out.frag_pos = vec3(model * vec4(position, 1.0));
 
-    vec3 T = normalize(vec3(model * vec4(tanget, 0.0)));
-    vec3 B = normalize(vec3(model * vec4(bitanget, 0.0)));
-    vec3 N = normalize(vec3(model * vec4(normal, 0.0)));
+    vec3 T = normalize(vec3(model_matrix * vec4(tanget, 0.0)));
+    vec3 B = normalize(vec3(model_matrix * vec4(bitanget, 0.0)));
+    vec3 N = normalize(vec3(model_matrix * vec4(normal, 0.0)));
     vs_out.tbn = mat3(T, B, N);
 
-    gl_Position = projection * view * model * vec4(position, 1.0f);
+    gl_Position = projection * view * model_matrix * vec4(position, 1.0f);
 }
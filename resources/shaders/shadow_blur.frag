@@ -0,0 +1,22 @@
+#version 430 core
+
+// one direction of the separable gaussian over the shadow moments of a cascade
+out vec4 moments;
+
+layout(binding = 0) uniform sampler2D image;
+
+// (1, 0) or (0, 1)
+uniform ivec2 direction;
+
+const float weight[5] = float[] (0.2270270270, 0.1945945946, 0.1216216216, 0.0540540541, 0.0162162162);
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec2 last = textureSize(image, 0) - 1;
+    vec4 result = texelFetch(image, texel, 0) * weight[0];
+    for (int i = 1; i < 5; ++i) {
+        result += texelFetch(image, clamp(texel + direction * i, ivec2(0), last), 0) * weight[i];
+        result += texelFetch(image, clamp(texel - direction * i, ivec2(0), last), 0) * weight[i];
+    }
+    moments = result;
+}
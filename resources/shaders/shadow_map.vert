@@ -1,10 +1,13 @@
 #version 450 core
 layout (location = 0) in vec3 pos;
+layout (location = 5) in mat4 instance_model;
 
 uniform mat4 light_space_matrix;
 uniform mat4 model;
+uniform bool instanced = false;
 
 void main()
 {
-    gl_Position = light_space_matrix * model * vec4(pos, 1.0);
+    mat4 model_matrix = instanced ? instance_model : model;
+    gl_Position = light_space_matrix * model_matrix * vec4(pos, 1.0);
 }  
@@ -0,0 +1,33 @@
+#version 430 core
+
+// exponential variance shadow map moments of a cascade tile, see ShadowMapPass.
+// drawn into the layer of the cascade, its depth tile is `downsample` times larger
+out vec4 moments;
+
+layout(binding = 0) uniform sampler2D shadow_map;
+
+uniform int downsample;
+// first texel of the cascade tile in the depth atlas
+uniform ivec2 tile_origin;
+
+// must match deferred_lighting.frag
+const float POSITIVE_EXPONENT = 40.0f;
+const float NEGATIVE_EXPONENT = 5.0f;
+
+vec4 warp(float depth) {
+    depth = depth * 2.0f - 1.0f;
+    float positive = exp(POSITIVE_EXPONENT * depth);
+    float negative = -exp(-NEGATIVE_EXPONENT * depth);
+    return vec4(positive, positive * positive, negative, negative * negative);
+}
+
+void main() {
+    // moments are linear, averaging them is the box filter of the downsample
+    ivec2 base = tile_origin + ivec2(gl_FragCoord.xy) * downsample;
+    vec4 sum = vec4(0.0f);
+    for (int y = 0; y < downsample; y++) {
+        for (int x = 0; x < downsample; x++)
+            sum += warp(texelFetch(shadow_map, base + ivec2(x, y), 0).r);
+    }
+    moments = sum / float(downsample * downsample);
+}